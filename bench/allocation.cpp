@@ -0,0 +1,89 @@
+// allocation.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+
+#include <malloc.h>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+using std::atomic;
+using std::bad_alloc;
+using std::free;
+using std::malloc;
+using std::size_t;
+
+// Number of bytes currently allocated, including allocator overhead.
+static atomic<size_t> allocated {0};
+
+// Number of allocations ever made.
+static atomic<size_t> allocations {0};
+
+size_t bench::allocated_bytes()
+{
+    return allocated.load();
+}
+
+size_t bench::allocation_count()
+{
+    return allocations.load();
+}
+
+void *operator new(const size_t size)
+{
+    auto &&p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    allocated += malloc_usable_size(p);
+    allocations += 1;
+    return p;
+}
+
+void *operator new[](const size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *const p) noexcept
+{
+    if (p != nullptr) {
+        allocated -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+void operator delete[](void *const p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void *const p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void *const p, size_t) noexcept
+{
+    operator delete(p);
+}
@@ -0,0 +1,133 @@
+// bench.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This header defines helpers for the benchmark programs.
+
+#ifndef BENCH_H
+#define BENCH_H 1
+
+#include <chrono>
+#include <cstddef>
+
+namespace bench
+{
+    using std::size_t;
+
+    /**
+     * Returns the number of bytes currently allocated by 'operator new'.
+     *
+     * This function is defined in 'allocation.cpp', which replaces the
+     * global allocation functions.
+     */
+    size_t allocated_bytes();
+
+    /**
+     * Returns the number of allocations ever made by 'operator new'.
+     */
+    size_t allocation_count();
+
+    /**
+     * Parses the options common to the benchmark programs.
+     *
+     * With '-m', results are printed in the machine-readable format, each
+     * on a line of tab-separated name, value and unit, and any other text is
+     * commented out with '#'.  With '-b FILE', results are compared with a
+     * baseline in that format, and those worse by more than the threshold
+     * percentage given by '-t' (10 by default) are reported as regressions.
+     *
+     * This function is defined in 'report.cpp'.
+     *
+     * @return the index of the first operand in 'argv'
+     */
+    int parse_options(int argc, char **argv);
+
+    /**
+     * Prints a line of text, which is commented out in the machine-readable
+     * format.
+     */
+    void comment(const char *format, ...)
+        __attribute__((format(printf, 1, 2)));
+
+    /**
+     * Prints an empty line, which is commented out in the machine-readable
+     * format.
+     */
+    void blank();
+
+    /**
+     * Reports a result, for which a lower value is better.
+     *
+     * Results of the same name are matched in order with the baseline.
+     *
+     * @param precision the number of decimal places in the text format
+     */
+    void report(const char *name, double value, const char *unit,
+        int precision = 2);
+
+    /**
+     * Returns the exit status of the program, which is 'EXIT_FAILURE' if
+     * any regression is reported.
+     */
+    int finish();
+
+    /**
+     * Prevents the compiler from optimizing away a value.
+     */
+    template<class T>
+    inline void keep(const T &value)
+    {
+        asm volatile ("" : : "g"(&value) : "memory");
+    }
+
+    /**
+     * Runs a function repeatedly and reports the mean time per operation.
+     *
+     * @param name name of the measurement
+     * @param iterations number of times to run the function
+     * @param operations number of operations in each run
+     * @return the mean time per operation in nanoseconds
+     */
+    template<class Function>
+    double measure(const char *const name, const size_t iterations,
+        const size_t operations, Function function)
+    {
+        // Warms up caches before timing.
+        function();
+
+        auto &&start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i != iterations; ++i) {
+            function();
+        }
+        auto &&elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start);
+
+        auto &&result = elapsed.count() / (double(iterations) * operations);
+        report(name, result, "ns/op");
+        return result;
+    }
+
+    /**
+     * Reports a size in bytes.
+     */
+    inline void report_size(const char *const name, const size_t size)
+    {
+        report(name, double(size), "bytes", 0);
+    }
+}
+
+#endif
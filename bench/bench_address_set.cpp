@@ -0,0 +1,124 @@
+// bench_address_set.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program compares 'std::set' and 'address_set' for the address sets
+// of interfaces in memory footprint and copy and iteration costs.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+#include "interface.h"
+
+#include <arpa/inet.h>
+#include <set>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using std::set;
+using std::size_t;
+using std::string;
+using std::vector;
+using xllmnrd::address_set;
+
+/*
+ * Address sets of an interface.
+ */
+template<class InSet, class In6Set>
+struct interface_addresses
+{
+    InSet in_addresses;
+    In6Set in6_addresses;
+};
+
+/*
+ * Runs the benchmark for a type of sets.
+ */
+template<class InSet, class In6Set>
+void run(const string &name, const size_t interface_count,
+    const size_t in_count, const size_t in6_count)
+{
+    using interface = interface_addresses<InSet, In6Set>;
+
+    auto &&base = bench::allocated_bytes();
+    auto &&interfaces = vector<interface>(interface_count);
+    for (size_t i = 0; i != interface_count; ++i) {
+        for (size_t j = 0; j != in_count; ++j) {
+            in_addr in {};
+            in.s_addr = htonl(0x0a000000 + (i << 8) + j);
+            interfaces[i].in_addresses.insert(in);
+        }
+        for (size_t j = 0; j != in6_count; ++j) {
+            in6_addr in6 {};
+            in6.s6_addr[0] = 0xfd;
+            in6.s6_addr[12] = i >> 8;
+            in6.s6_addr[13] = i;
+            in6.s6_addr[15] = j;
+            interfaces[i].in6_addresses.insert(in6);
+        }
+    }
+    bench::report_size((name + " footprint").c_str(),
+        bench::allocated_bytes() - base);
+
+    // Interfaces are copied on each change as snapshots are immutable.
+    bench::measure((name + " copy").c_str(), 20, interface_count,
+        [&]() {
+            for (auto &&i : interfaces) {
+                auto copy = i;
+                bench::keep(copy);
+            }
+        });
+
+    bench::measure((name + " iterate").c_str(), 100, interface_count,
+        [&]() {
+            unsigned int sum = 0;
+            for (auto &&i : interfaces) {
+                for (auto &&j : i.in_addresses) {
+                    sum += j.s_addr;
+                }
+                for (auto &&j : i.in6_addresses) {
+                    sum += j.s6_addr[15];
+                }
+            }
+            bench::keep(sum);
+        });
+}
+
+int main(const int argc, char **const argv)
+{
+    size_t interface_count = 4096;
+    auto &&first = bench::parse_options(argc, argv);
+    if (argc > first) {
+        interface_count = std::strtoul(argv[first], nullptr, 10);
+    }
+
+    bench::comment("%zu interfaces", interface_count);
+    for (auto &&counts : {std::make_pair(1, 2), std::make_pair(2, 4),
+        std::make_pair(4, 10)}) {
+        bench::blank();
+        bench::comment("%d IPv4 and %d IPv6 addresses per interface",
+            counts.first, counts.second);
+        run<set<in_addr>, set<in6_addr>>("std::set",
+            interface_count, counts.first, counts.second);
+        run<address_set<in_addr>, address_set<in6_addr>>("address_set",
+            interface_count, counts.first, counts.second);
+    }
+    return bench::finish();
+}
@@ -0,0 +1,359 @@
+// bench_hot_path.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program measures the functions on the packet hot path of the
+// responder: parsing a query, matching the name, building a response with
+// 1, 10 and 100 addresses, looking up the addresses of an interface and
+// dispatching RTNETLINK dumps.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+#include "responder.h"
+#include "llmnr_packet.h"
+#include "llmnr.h"
+
+#include <linux/rtnetlink.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+using std::array;
+using std::make_shared;
+using std::size_t;
+using std::string;
+using std::uint8_t;
+using std::vector;
+using xllmnrd::default_posix;
+using xllmnrd::rtnetlink_interface_manager;
+
+/*
+ * POSIX implementation whose UDP sockets do nothing.
+ */
+class null_posix: public default_posix
+{
+public:
+    int socket(int, int, int) override
+    {
+        return 1000;
+    }
+
+    int bind(int, const sockaddr *, socklen_t) override
+    {
+        return 0;
+    }
+
+    int setsockopt(int, int, int, const void *, socklen_t) override
+    {
+        return 0;
+    }
+
+    int close(int) override
+    {
+        return 0;
+    }
+
+    int sendmmsg(int, mmsghdr *, const unsigned int vlen, int) override
+    {
+        return vlen;
+    }
+};
+
+/*
+ * Interface manager with static interfaces.
+ */
+class static_interface_manager: public interface_manager
+{
+public:
+    void refresh(bool) override
+    {
+        set_ready();
+    }
+
+    /*
+     * Adds an interface with IPv6 addresses.
+     */
+    void add_interface(const unsigned int index, const size_t count)
+    {
+        enable_interface(index);
+        for (size_t i = 0; i != count; ++i) {
+            in6_addr in6 {};
+            in6.s6_addr[0] = 0xfd;
+            in6.s6_addr[13] = index;
+            in6.s6_addr[14] = i >> 8;
+            in6.s6_addr[15] = i;
+            add_interface_address(index, AF_INET6, &in6);
+        }
+    }
+};
+
+/*
+ * Responder that exposes its hot path.
+ */
+class hot_path_responder: public responder
+{
+public:
+    using responder::responder;
+
+    using responder::matching_host_name;
+    using responder::respond_for_name;
+};
+
+/*
+ * Interface manager that exposes its message dispatcher.
+ */
+class replay_interface_manager: public rtnetlink_interface_manager
+{
+public:
+    using rtnetlink_interface_manager::rtnetlink_interface_manager;
+
+    using rtnetlink_interface_manager::dispatch_messages;
+};
+
+/*
+ * Returns a query for a name.
+ */
+static vector<uint8_t> make_query(const string &label, const uint16_t qtype)
+{
+    auto &&query = vector<uint8_t>(LLMNR_HEADER_SIZE);
+    query[5] = 1; // qdcount
+    query.push_back(label.size());
+    query.insert(query.end(), label.begin(), label.end());
+    query.push_back(0);
+    query.push_back(qtype >> 8);
+    query.push_back(qtype & 0xff);
+    query.push_back(0);
+    query.push_back(LLMNR_QCLASS_IN);
+    return query;
+}
+
+/*
+ * Returns an attribute with a payload.
+ */
+static vector<uint8_t> attribute(const uint16_t type, const void *data,
+    const size_t size)
+{
+    auto &&result = vector<uint8_t>(RTA_SPACE(size));
+    auto &&rta = reinterpret_cast<rtattr *>(result.data());
+    rta->rta_len = RTA_LENGTH(size);
+    rta->rta_type = type;
+    std::memcpy(RTA_DATA(rta), data, size);
+    return result;
+}
+
+/*
+ * Appends a NETLINK message to a dump, starting a new datagram if it does
+ * not fit in the last one.
+ */
+template<class T>
+static void append_message(vector<vector<uint8_t>> &dump,
+    const uint16_t type, const T &body, const vector<uint8_t> &attributes)
+{
+    // The kernel fills each datagram of a dump up to a page.
+    const size_t datagram_size = 4096;
+
+    auto &&length = NLMSG_LENGTH(NLMSG_ALIGN(sizeof body))
+        + attributes.size();
+    if (dump.empty()
+        || dump.back().size() + NLMSG_ALIGN(length) > datagram_size) {
+        dump.emplace_back();
+    }
+
+    auto &&datagram = dump.back();
+    auto &&offset = datagram.size();
+    datagram.resize(offset + NLMSG_ALIGN(length));
+
+    auto &&nlmsg = reinterpret_cast<nlmsghdr *>(&datagram[offset]);
+    nlmsg->nlmsg_len = length;
+    nlmsg->nlmsg_type = type;
+    nlmsg->nlmsg_flags = NLM_F_MULTI;
+    auto &&data = static_cast<uint8_t *>(NLMSG_DATA(nlmsg));
+    std::memcpy(data, &body, sizeof body);
+    std::copy(attributes.begin(), attributes.end(),
+        data + NLMSG_ALIGN(sizeof body));
+}
+
+/*
+ * Returns a dump of links, each with a link-local and a unique local IPv6
+ * address, in the datagrams the kernel would send.
+ */
+static vector<vector<uint8_t>> make_dump(const unsigned int link_count)
+{
+    auto &&dump = vector<vector<uint8_t>>();
+    for (unsigned int i = 1; i <= link_count; ++i) {
+        ifinfomsg ifi {};
+        ifi.ifi_family = AF_UNSPEC;
+        ifi.ifi_index = i;
+        ifi.ifi_flags = IFF_UP | IFF_MULTICAST;
+
+        auto &&name = "veth" + std::to_string(i);
+        auto &&attributes = attribute(IFLA_IFNAME, name.c_str(),
+            name.size() + 1);
+        const uint32_t mtu = 1500;
+        auto &&mtu_attribute = attribute(IFLA_MTU, &mtu, sizeof mtu);
+        attributes.insert(attributes.end(), mtu_attribute.begin(),
+            mtu_attribute.end());
+        append_message(dump, RTM_NEWLINK, ifi, attributes);
+    }
+    for (unsigned int i = 1; i <= link_count; ++i) {
+        for (auto &&prefix : {0xfe80, 0xfd00}) {
+            ifaddrmsg ifa {};
+            ifa.ifa_family = AF_INET6;
+            ifa.ifa_prefixlen = 64;
+            ifa.ifa_scope =
+                prefix == 0xfe80 ? RT_SCOPE_LINK : RT_SCOPE_UNIVERSE;
+            ifa.ifa_index = i;
+
+            in6_addr in6 {};
+            in6.s6_addr[0] = prefix >> 8;
+            in6.s6_addr[1] = prefix & 0xff;
+            in6.s6_addr[14] = i >> 8;
+            in6.s6_addr[15] = i;
+            append_message(dump, RTM_NEWADDR, ifa,
+                attribute(IFA_ADDRESS, &in6, sizeof in6));
+        }
+    }
+    return dump;
+}
+
+/*
+ * Measures parsing a query.
+ */
+static void run_parse(const size_t iterations)
+{
+    auto &&query = make_query("host", LLMNR_QTYPE_AAAA);
+    auto &&header = reinterpret_cast<const llmnr_header *>(query.data());
+    bench::measure("llmnr_is_valid_query", iterations, 1000, [&]() {
+        for (int i = 0; i != 1000; ++i) {
+            bench::keep(header);
+            bench::keep(llmnr_is_valid_query(header));
+        }
+    });
+    bench::measure("llmnr_skip_name", iterations, 1000, [&]() {
+        for (int i = 0; i != 1000; ++i) {
+            size_t remains = query.size() - LLMNR_HEADER_SIZE;
+            bench::keep(header);
+            bench::keep(llmnr_skip_name(llmnr_data(header), &remains));
+        }
+    });
+}
+
+/*
+ * Measures the responder functions.
+ */
+static void run_responder(const size_t iterations)
+{
+    const array<size_t, 3> counts {1, 10, 100};
+
+    auto &&manager = make_shared<static_interface_manager>();
+    manager->set_debug_level(-1);
+    for (unsigned int i = 0; i != counts.size(); ++i) {
+        manager->add_interface(i + 1, counts[i]);
+    }
+
+    auto &&r = hot_path_responder(htons(LLMNR_PORT), manager,
+        {scoped_name {}}, make_shared<null_posix>());
+    r.start();
+
+    array<char, LLMNR_LABEL_MAX + 1> host_name {};
+    gethostname(host_name.data(), host_name.size() - 1);
+    auto &&label = string(host_name.data(), strcspn(host_name.data(), "."));
+
+    auto &&hit = make_query(label, LLMNR_QTYPE_AAAA);
+    auto &&miss = make_query(label + "-other", LLMNR_QTYPE_AAAA);
+    bench::measure("matching_host_name hit", iterations, 1000, [&]() {
+        for (int i = 0; i != 1000; ++i) {
+            bench::keep(r.matching_host_name(&hit[LLMNR_HEADER_SIZE]));
+        }
+    });
+    bench::measure("matching_host_name miss", iterations, 1000, [&]() {
+        for (int i = 0; i != 1000; ++i) {
+            bench::keep(r.matching_host_name(&miss[LLMNR_HEADER_SIZE]));
+        }
+    });
+
+    auto &&header = reinterpret_cast<const llmnr_header *>(hit.data());
+    auto &&qname_end = hit.data() + hit.size() - 4;
+    auto &&name = vector<uint8_t>(&hit[LLMNR_HEADER_SIZE], qname_end);
+    auto &&sender = sockaddr_in6 {};
+    sender.sin6_family = AF_INET6;
+    sender.sin6_port = htons(49152);
+    for (unsigned int i = 0; i != counts.size(); ++i) {
+        auto &&measurement = "respond_for_name AAAA x"
+            + std::to_string(counts[i]);
+        bench::measure(measurement.c_str(), iterations, 1000, [&]() {
+            for (int j = 0; j != 1000; ++j) {
+                r.respond_for_name(header, qname_end, name, sender, i + 1);
+            }
+        });
+    }
+    for (unsigned int i = 0; i != counts.size(); ++i) {
+        auto &&measurement = "in6_addresses x"
+            + std::to_string(counts[i]);
+        bench::measure(measurement.c_str(), iterations, 1000, [&]() {
+            for (int j = 0; j != 1000; ++j) {
+                bench::keep(manager->in6_addresses(i + 1));
+            }
+        });
+    }
+}
+
+/*
+ * Measures dispatching RTNETLINK dumps as notifications.
+ */
+static void run_dispatch(const size_t iterations, const unsigned int links)
+{
+    auto &&dump = make_dump(links);
+    auto &&manager = replay_interface_manager(make_shared<default_posix>());
+    manager.set_debug_level(-1);
+    manager.set_coalescing_window(std::chrono::milliseconds(0));
+
+    bench::comment("%u links in %zu datagrams", links, dump.size());
+    bench::measure("dispatch_messages", iterations, 3 * links, [&]() {
+        for (auto &&i : dump) {
+            manager.dispatch_messages(i.data(), i.size());
+        }
+    });
+}
+
+int main(const int argc, char **const argv)
+{
+    size_t iterations = 100;
+    auto &&first = bench::parse_options(argc, argv);
+    if (argc > first) {
+        iterations = std::strtoul(argv[first], nullptr, 10);
+    }
+
+    // Changes are logged at the debug level.
+    setlogmask(LOG_UPTO(LOG_INFO));
+
+    run_parse(iterations);
+    run_responder(iterations);
+    run_dispatch(iterations, 1000);
+    return bench::finish();
+}
@@ -0,0 +1,213 @@
+// bench_ifindex_map.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program compares 'std::unordered_map' and 'ifindex_map' for the
+// interface table in lookup latency, memory footprint and copy cost.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+#include "interface.h"
+
+#include <unordered_map>
+#include <memory>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using std::make_shared;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using xllmnrd::ifindex_map;
+using xllmnrd::interface_manager;
+
+using interface_ptr = shared_ptr<const interface_manager::interface>;
+
+/*
+ * Adapter for 'std::unordered_map'.
+ */
+struct hash_table
+{
+    unordered_map<unsigned int, interface_ptr> map;
+
+    void insert(unsigned int index, interface_ptr value)
+    {
+        map[index] = std::move(value);
+    }
+
+    const interface_ptr *find(unsigned int index) const
+    {
+        auto &&found = map.find(index);
+        return found != map.end() ? &found->second : nullptr;
+    }
+
+    void erase(unsigned int index)
+    {
+        map.erase(index);
+    }
+};
+
+/*
+ * Adapter for 'ifindex_map'.
+ */
+struct dense_table
+{
+    ifindex_map<interface_ptr> map;
+
+    void insert(unsigned int index, interface_ptr value)
+    {
+        map.insert_or_assign(index, std::move(value));
+    }
+
+    const interface_ptr *find(unsigned int index) const
+    {
+        return map.find(index);
+    }
+
+    void erase(unsigned int index)
+    {
+        map.erase(index);
+    }
+};
+
+/*
+ * Runs the benchmark for a type of tables.
+ */
+template<class Table>
+void run(const string &name, const vector<unsigned int> &indices,
+    const vector<unsigned int> &queries)
+{
+    auto &&interface = make_shared<const interface_manager::interface>();
+
+    auto &&base = bench::allocated_bytes();
+    auto &&table = Table();
+    for (auto &&i : indices) {
+        table.insert(i, interface);
+    }
+    bench::report_size((name + " footprint").c_str(),
+        bench::allocated_bytes() - base);
+
+    bench::measure((name + " lookup").c_str(), 100, queries.size(),
+        [&]() {
+            size_t found = 0;
+            for (auto &&i : queries) {
+                if (table.find(i) != nullptr) {
+                    found += 1;
+                }
+            }
+            bench::keep(found);
+        });
+
+    // The table is copied on each change to publish a snapshot.
+    bench::measure((name + " copy").c_str(), 20, 1,
+        [&]() {
+            auto copy = table;
+            bench::keep(copy);
+        });
+}
+
+/*
+ * Runs the benchmark for a type of tables with interfaces created and
+ * deleted over time, whose indices keep growing as allocated cyclically.
+ */
+template<class Table>
+void run_churn(const string &name, const size_t live_count,
+    const size_t churn_count)
+{
+    auto &&interface = make_shared<const interface_manager::interface>();
+
+    auto &&base = bench::allocated_bytes();
+    auto &&table = Table();
+    unsigned int next = 1;
+    for (; next != live_count + 1; ++next) {
+        table.insert(next, interface);
+    }
+
+    bench::measure((name + " churn").c_str(), 1, churn_count,
+        [&]() {
+            for (size_t i = 0; i != churn_count; ++i) {
+                table.erase(next - live_count);
+                table.insert(next, interface);
+                next += 1;
+            }
+        });
+    bench::report_size((name + " churn footprint").c_str(),
+        bench::allocated_bytes() - base);
+
+    bench::measure((name + " churn copy").c_str(), 1000, 1,
+        [&]() {
+            auto copy = table;
+            bench::keep(copy);
+        });
+}
+
+int main(const int argc, char **const argv)
+{
+    size_t interface_count = 10000;
+    auto &&first = bench::parse_options(argc, argv);
+    if (argc > first) {
+        interface_count = std::strtoul(argv[first], nullptr, 10);
+    }
+
+    auto &&random = std::mt19937(1);
+    for (auto &&sparse : {false, true}) {
+        // Interfaces are created and deleted over time, so indices have
+        // gaps.  The sparse case also has indices beyond the dense limit.
+        auto &&indices = vector<unsigned int>();
+        for (unsigned int i = 1; indices.size() != interface_count; ++i) {
+            if (random() % 4 != 0) {
+                indices.push_back(i);
+            }
+        }
+        if (sparse) {
+            for (size_t i = 0; i != indices.size(); i += 10) {
+                indices[i] += ifindex_map<interface_ptr>::DENSE_LIMIT;
+            }
+        }
+
+        auto &&queries = vector<unsigned int>(100000);
+        for (auto &&i : queries) {
+            i = indices[random() % indices.size()];
+        }
+
+        if (sparse) {
+            bench::blank();
+        }
+        bench::comment("%zu interfaces", interface_count);
+        if (sparse) {
+            bench::comment("10%% of indices beyond the dense limit");
+        }
+        run<hash_table>("unordered_map", indices, queries);
+        run<dense_table>("ifindex_map", indices, queries);
+    }
+
+    // Only a few interfaces are alive at a time on a host running
+    // short-lived containers, but their indices keep growing.
+    bench::blank();
+    bench::comment("%zu interfaces created and deleted, 10 alive",
+        interface_count);
+    run_churn<hash_table>("unordered_map", 10, interface_count);
+    run_churn<dense_table>("ifindex_map", 10, interface_count);
+    return bench::finish();
+}
@@ -0,0 +1,94 @@
+// bench_interface_batch.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program measures the cost of applying a full dump of interfaces to
+// an interface manager with and without a batch.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+#include "interface.h"
+
+#include <arpa/inet.h>
+#include <string>
+#include <cstdlib>
+
+using std::size_t;
+using std::string;
+using xllmnrd::interface_manager;
+
+/*
+ * Interface manager that applies synthetic dumps.
+ */
+class dump_interface_manager: public interface_manager
+{
+public:
+    void refresh(bool) override
+    {
+    }
+
+    void apply_dump(const size_t interface_count, const bool batched)
+    {
+        if (batched) {
+            begin_batch();
+        }
+        remove_interfaces();
+        for (unsigned int i = 1; i <= interface_count; ++i) {
+            enable_interface(i);
+
+            in_addr in {};
+            in.s_addr = htonl(0x0a000000 + i);
+            add_interface_address(i, AF_INET, &in);
+
+            in6_addr in6 {};
+            in6.s6_addr[0] = 0xfe;
+            in6.s6_addr[1] = 0x80;
+            in6.s6_addr[14] = i >> 8;
+            in6.s6_addr[15] = i;
+            add_interface_address(i, AF_INET6, &in6);
+        }
+        if (batched) {
+            commit_batch();
+        }
+    }
+};
+
+int main(const int argc, char **const argv)
+{
+    size_t interface_count = 10000;
+    auto &&first = bench::parse_options(argc, argv);
+    if (argc > first) {
+        interface_count = std::strtoul(argv[first], nullptr, 10);
+    }
+
+    bench::comment("%zu interfaces, 3 changes each", interface_count);
+
+    auto &&manager = dump_interface_manager();
+    // Disables logging so that only the table updates are measured.
+    manager.set_debug_level(-1);
+    for (auto &&batched : {false, true}) {
+        auto &&name = string(batched ? "batched" : "unbatched") + " dump";
+        bench::measure(name.c_str(), batched ? 20 : 1, 3 * interface_count,
+            [&]() {
+                manager.apply_dump(interface_count, batched);
+            });
+    }
+    return bench::finish();
+}
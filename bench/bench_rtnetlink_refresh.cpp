@@ -0,0 +1,93 @@
+// bench_rtnetlink_refresh.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+
+// This program measures the time and the system calls needed to refresh
+// an RTNETLINK interface manager on this host.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+#include "rtnetlink.h"
+
+#include <syslog.h>
+#include <atomic>
+#include <memory>
+#include <cstdlib>
+
+using std::atomic;
+using std::make_shared;
+using std::size_t;
+using xllmnrd::default_posix;
+using xllmnrd::rtnetlink_interface_manager;
+
+/*
+ * POSIX implementation that counts the receive calls.
+ */
+class counting_posix: public default_posix
+{
+public:
+    atomic<size_t> recv_count {0};
+
+    atomic<size_t> recv_bytes {0};
+
+    ssize_t recv(int socket, void *buffer, size_t length, int flags) override
+    {
+        auto &&received = default_posix::recv(socket, buffer, length, flags);
+        recv_count += 1;
+        if (received > 0) {
+            recv_bytes += received;
+        }
+        return received;
+    }
+};
+
+int main(const int argc, char **const argv)
+{
+    size_t iterations = 100;
+    auto &&first = bench::parse_options(argc, argv);
+    if (argc > first) {
+        iterations = std::strtoul(argv[first], nullptr, 10);
+    }
+
+    // Refreshes are logged at the debug level.
+    setlogmask(LOG_UPTO(LOG_INFO));
+
+    auto &&os = make_shared<counting_posix>();
+    auto &&manager = rtnetlink_interface_manager(os);
+    manager.set_debug_level(-1);
+    manager.set_coalescing_window(std::chrono::milliseconds(0));
+    manager.refresh();
+
+    auto &&recv_count = os->recv_count.load();
+    auto &&recv_bytes = os->recv_bytes.load();
+    auto &&allocations = bench::allocation_count();
+    bench::measure("refresh", iterations, 1, [&]() {
+        manager.refresh();
+    });
+    bench::report("recv",
+        double(os->recv_count - recv_count) / (iterations + 1), "calls/op");
+    bench::report("received",
+        double(os->recv_bytes - recv_bytes) / (iterations + 1), "bytes/op");
+    bench::report("operator new",
+        double(bench::allocation_count() - allocations) / (iterations + 1),
+        "calls/op");
+    return bench::finish();
+}
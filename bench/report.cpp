@@ -0,0 +1,163 @@
+// report.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bench.h"
+
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+using std::ifstream;
+using std::istringstream;
+using std::map;
+using std::string;
+using std::vector;
+
+// True if results are printed in the machine-readable format.
+static bool machine_readable = false;
+
+// Baseline values of each name in order.
+static map<string, vector<double>> baseline;
+
+// Number of results reported for each name.
+static map<string, size_t> occurrences;
+
+// Percentage above which a result is a regression.
+static double threshold = 10.0;
+
+static size_t regressions = 0;
+
+/*
+ * Loads a baseline in the machine-readable format.
+ */
+static void load_baseline(const char *const file_name)
+{
+    auto &&input = ifstream(file_name);
+    if (!input) {
+        std::fprintf(stderr, "could not open the baseline '%s'\n", file_name);
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto &&line = string();
+    while (getline(input, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        auto &&fields = istringstream(line);
+        auto &&name = string();
+        double value = 0;
+        if (getline(fields, name, '\t') && fields >> value) {
+            baseline[name].push_back(value);
+        }
+    }
+}
+
+int bench::parse_options(const int argc, char **const argv)
+{
+    int option;
+    while ((option = getopt(argc, argv, "+mb:t:")) != -1) {
+        switch (option) {
+        case 'm':
+            machine_readable = true;
+            break;
+        case 'b':
+            load_baseline(optarg);
+            break;
+        case 't':
+            threshold = std::strtod(optarg, nullptr);
+            break;
+        default:
+            std::fprintf(stderr, "usage: %s [-m] [-b FILE] [-t PERCENT]"
+                " [OPERAND]...\n", argv[0]);
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    return optind;
+}
+
+void bench::comment(const char *const format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    if (machine_readable) {
+        std::fputs("# ", stdout);
+    }
+    std::vprintf(format, args);
+    std::putchar('\n');
+    va_end(args);
+}
+
+void bench::blank()
+{
+    std::puts(machine_readable ? "#" : "");
+}
+
+void bench::report(const char *const name, const double value,
+    const char *const unit, const int precision)
+{
+    if (machine_readable) {
+        std::printf("%s\t%.*f\t%s\n", name, precision, value, unit);
+    }
+    else {
+        std::printf("%-40s %12.*f %s", name, precision, value, unit);
+    }
+
+    auto &&index = occurrences[name]++;
+    auto &&base = baseline.find(name);
+    if (base != baseline.end() && index < base->second.size()
+        && base->second[index] > 0) {
+        auto &&change = 100.0 * (value / base->second[index] - 1.0);
+        auto &&regression = change > threshold;
+        if (regression) {
+            regressions += 1;
+        }
+        if (machine_readable) {
+            if (regression) {
+                std::fprintf(stderr, "%s: %+.1f%% (regression)\n",
+                    name, change);
+            }
+        }
+        else {
+            std::printf(" (%+.1f%%)%s", change,
+                regression ? " REGRESSION" : "");
+        }
+    }
+    if (!machine_readable) {
+        std::putchar('\n');
+    }
+}
+
+int bench::finish()
+{
+    if (regressions != 0) {
+        std::fprintf(stderr, "%zu regressions over %.1f%%\n", regressions,
+            threshold);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+// address_set.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef ADDRESS_SET_H
+#define ADDRESS_SET_H 1
+
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /**
+     * Sorted set of addresses stored in a flat array.
+     *
+     * Up to 'N' addresses are stored inline in the object so that typical
+     * interfaces need no allocation.  This class provides a subset of the
+     * interface of 'std::set'.
+     */
+    template<class T, size_t N = 4, class Compare = std::less<T>>
+    class address_set
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "T must be trivially copyable");
+
+    public:
+
+        using value_type = T;
+        using key_type = T;
+        using size_type = size_t;
+        using const_iterator = const T *;
+        using iterator = const_iterator;
+
+    private:
+
+        T _inline[N];
+
+        T *_data = _inline;
+
+        size_t _size = 0;
+
+        size_t _capacity = N;
+
+    public:
+
+        address_set() noexcept
+        {
+            // The inline storage is left uninitialized.
+        }
+
+        address_set(const address_set &other)
+        {
+            assign(other);
+        }
+
+        address_set(address_set &&other) noexcept
+        {
+            take(other);
+        }
+
+        ~address_set()
+        {
+            release();
+        }
+
+
+        address_set &operator =(const address_set &other)
+        {
+            if (&other != this) {
+                _size = 0;
+                assign(other);
+            }
+            return *this;
+        }
+
+        address_set &operator =(address_set &&other) noexcept
+        {
+            if (&other != this) {
+                release();
+                take(other);
+            }
+            return *this;
+        }
+
+
+        const_iterator begin() const
+        {
+            return _data;
+        }
+
+        const_iterator end() const
+        {
+            return _data + _size;
+        }
+
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        /// Returns true if the addresses are stored inline.
+        bool is_inline() const
+        {
+            return _data == _inline;
+        }
+
+        const_iterator find(const T &value) const
+        {
+            auto &&i = lower_bound(value);
+            if (i != end() && !Compare()(value, *i)) {
+                return i;
+            }
+            return end();
+        }
+
+        size_t count(const T &value) const
+        {
+            return find(value) != end() ? 1 : 0;
+        }
+
+        std::pair<iterator, bool> insert(const T &value)
+        {
+            auto &&i = lower_bound(value);
+            if (i != end() && !Compare()(value, *i)) {
+                return {i, false};
+            }
+
+            auto &&offset = size_t(i - _data);
+            if (_size == _capacity) {
+                reserve(2 * _capacity);
+            }
+            std::memmove(_data + offset + 1, _data + offset,
+                (_size - offset) * sizeof (T));
+            std::memcpy(_data + offset, &value, sizeof (T));
+            _size += 1;
+            return {_data + offset, true};
+        }
+
+        size_t erase(const T &value)
+        {
+            auto &&i = find(value);
+            if (i == end()) {
+                return 0;
+            }
+
+            auto &&offset = size_t(i - _data);
+            std::memmove(_data + offset, _data + offset + 1,
+                (_size - offset - 1) * sizeof (T));
+            _size -= 1;
+            return 1;
+        }
+
+        void clear()
+        {
+            _size = 0;
+        }
+
+        void reserve(size_t capacity)
+        {
+            if (capacity > _capacity) {
+                auto &&data = new T[capacity];
+                std::memcpy(data, _data, _size * sizeof (T));
+                release();
+                _data = data;
+                _capacity = capacity;
+            }
+        }
+
+    protected:
+
+        const_iterator lower_bound(const T &value) const
+        {
+            return std::lower_bound(begin(), end(), value, Compare());
+        }
+
+        /// Copies the addresses of another object to this empty object.
+        void assign(const address_set &other)
+        {
+            reserve(other._size);
+            std::memcpy(_data, other._data, other._size * sizeof (T));
+            _size = other._size;
+        }
+
+        /// Takes the addresses of another object to this released object.
+        void take(address_set &other) noexcept
+        {
+            if (other.is_inline()) {
+                std::memcpy(_inline, other._inline, other._size * sizeof (T));
+                _data = _inline;
+                _capacity = N;
+            }
+            else {
+                _data = other._data;
+                _capacity = other._capacity;
+                other._data = other._inline;
+                other._capacity = N;
+            }
+            _size = other._size;
+            other._size = 0;
+        }
+
+        /// Releases any allocated storage.
+        void release() noexcept
+        {
+            if (!is_inline()) {
+                delete[] _data;
+            }
+            _data = _inline;
+            _capacity = N;
+        }
+    };
+
+    template<class T, size_t N, class Compare>
+    inline bool operator ==(const address_set<T, N, Compare> &x,
+        const address_set<T, N, Compare> &y)
+    {
+        return x.size() == y.size()
+            && std::equal(x.begin(), x.end(), y.begin(),
+                [](const T &a, const T &b) {
+                    return !Compare()(a, b) && !Compare()(b, a);
+                });
+    }
+
+    template<class T, size_t N, class Compare>
+    inline bool operator !=(const address_set<T, N, Compare> &x,
+        const address_set<T, N, Compare> &y)
+    {
+        return !(x == y);
+    }
+}
+
+#endif
@@ -0,0 +1,389 @@
+// hosts.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "hosts.h"
+
+#include "wire_name.h"
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <algorithm>
+#include <system_error>
+#include <array>
+#include <cstring>
+#include <cerrno>
+
+using std::array;
+using std::copy;
+using std::equal;
+using std::find_if;
+using std::generic_category;
+using std::make_shared;
+using std::memchr;
+using std::memcmp;
+using std::none_of;
+using std::shared_ptr;
+using std::string;
+using std::strcspn;
+using std::strerror;
+using std::system_error;
+using std::thread;
+using std::uint8_t;
+using std::uint32_t;
+using std::vector;
+using namespace xllmnrd;
+
+/*
+ * Returns true if a character is a white space in the hosts file format.
+ */
+inline bool is_space(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+// Implementation of class 'hosts_table'
+
+hosts_table::hosts_table(const char *const text, const size_t size)
+{
+    // Addresses are collected with their entry indices and then grouped by
+    // the entries so that each entry has a contiguous range.
+    auto &&in_pending = vector<std::pair<uint32_t, in_addr>>();
+    auto &&in6_pending = vector<std::pair<uint32_t, in6_addr>>();
+
+    auto &&name = vector<uint8_t>();
+    auto &&text_end = text + size;
+    auto line = text;
+    while (line != text_end) {
+        auto &&line_end = static_cast<const char *>(
+            memchr(line, '\n', text_end - line));
+        if (line_end == nullptr) {
+            line_end = text_end;
+        }
+        auto &&comment = std::find(line, line_end, '#');
+
+        auto i = line;
+        auto next_token = [&]() {
+            i = find_if(i, comment, [](char c) {return !is_space(c);});
+            auto token = i;
+            i = find_if(i, comment, is_space);
+            return token;
+        };
+
+        auto &&address = next_token();
+        auto &&address_length = size_t(i - address);
+
+        auto &&buffer = array<char, INET6_ADDRSTRLEN> {};
+        if (address_length != 0 && address_length < buffer.size()) {
+            copy(address, i, buffer.begin());
+            // Ignores any zone index.
+            buffer[strcspn(buffer.data(), "%")] = '\0';
+
+            in_addr in {};
+            in6_addr in6 {};
+            int family = AF_UNSPEC;
+            if (inet_pton(AF_INET, buffer.data(), &in) == 1) {
+                family = AF_INET;
+            }
+            else if (inet_pton(AF_INET6, buffer.data(), &in6) == 1) {
+                family = AF_INET6;
+            }
+
+            while (family != AF_UNSPEC) {
+                auto &&token = next_token();
+                if (token == i) {
+                    break;
+                }
+                if (!to_wire_name(token, i, name)) {
+                    continue;
+                }
+
+                auto &&index = insert_name(name.data());
+                if (family == AF_INET) {
+                    in_pending.emplace_back(index, in);
+                }
+                else {
+                    in6_pending.emplace_back(index, in6);
+                }
+            }
+        }
+
+        line = line_end;
+        if (line != text_end) {
+            ++line;
+        }
+    }
+
+    group_addresses(in_pending, _in_addresses, &entry::in_first,
+        &entry::in_last,
+        [](const in_addr &x, const in_addr &y) {
+            return x.s_addr == y.s_addr;
+        });
+    group_addresses(in6_pending, _in6_addresses, &entry::in6_first,
+        &entry::in6_last,
+        [](const in6_addr &x, const in6_addr &y) {
+            return memcmp(&x, &y, sizeof x) == 0;
+        });
+}
+
+uint32_t hosts_table::insert_name(const uint8_t *const name)
+{
+    if (2 * (_entries.size() + 1) > _buckets.size()) {
+        rehash(_buckets.empty() ? 64 : 2 * _buckets.size());
+    }
+
+    size_t length = 0;
+    auto &&hash = hash_wire_name(name, length);
+
+    auto &&mask = _buckets.size() - 1;
+    auto &&i = hash & mask;
+    while (_buckets[i] != 0) {
+        auto &&e = _entries[_buckets[i] - 1];
+        if (e.hash == hash
+            && equal(name, name + length, &_names[e.name_offset])) {
+            return _buckets[i] - 1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    auto &&e = entry {};
+    e.hash = hash;
+    e.name_offset = static_cast<uint32_t>(_names.size());
+    _names.insert(_names.end(), name, name + length);
+    _entries.push_back(e);
+
+    _buckets[i] = static_cast<uint32_t>(_entries.size());
+    return _buckets[i] - 1;
+}
+
+void hosts_table::rehash(const size_t bucket_count)
+{
+    _buckets.assign(bucket_count, 0);
+
+    auto &&mask = bucket_count - 1;
+    for (size_t i = 0; i != _entries.size(); ++i) {
+        auto &&j = _entries[i].hash & mask;
+        while (_buckets[j] != 0) {
+            j = (j + 1) & mask;
+        }
+        _buckets[j] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+template<class T, class Equal>
+void hosts_table::group_addresses(
+    const vector<std::pair<uint32_t, T>> &pending, vector<T> &addresses,
+    uint32_t entry::*first, uint32_t entry::*last, Equal equal)
+{
+    // Counts the addresses for each entry.
+    auto &&offsets = vector<uint32_t>(_entries.size() + 1);
+    for (auto &&i : pending) {
+        offsets[i.first + 1] += 1;
+    }
+    for (size_t i = 0; i != _entries.size(); ++i) {
+        offsets[i + 1] += offsets[i];
+        _entries[i].*first = offsets[i];
+        _entries[i].*last = offsets[i];
+    }
+
+    addresses.resize(pending.size());
+    for (auto &&i : pending) {
+        auto &&e = _entries[i.first];
+        auto &&begin = addresses.begin() + (e.*first);
+        auto &&end = addresses.begin() + (e.*last);
+        if (none_of(begin, end,
+            [&](const T &x) {return equal(x, i.second);})) {
+            *end = i.second;
+            e.*last += 1;
+        }
+    }
+}
+
+shared_ptr<const hosts_table> hosts_table::load(const char *const file_name)
+{
+    int fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw system_error(errno, generic_category(),
+            string("could not open ") + file_name);
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) == -1) {
+        auto &&error = errno;
+        close(fd);
+        throw system_error(error, generic_category(),
+            string("could not stat ") + file_name);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return make_shared<hosts_table>();
+    }
+
+    auto &&size = size_t(st.st_size);
+    auto &&text = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    auto &&error = errno;
+    close(fd);
+    if (text == MAP_FAILED) {
+        throw system_error(error, generic_category(),
+            string("could not map ") + file_name);
+    }
+
+    madvise(text, size, MADV_SEQUENTIAL);
+    try {
+        auto &&table = make_shared<hosts_table>(
+            static_cast<const char *>(text), size);
+        munmap(text, size);
+        return table;
+    }
+    catch (...) {
+        munmap(text, size);
+        throw;
+    }
+}
+
+auto hosts_table::find(const uint8_t *const qname) const -> const entry *
+{
+    if (_buckets.empty()) {
+        return nullptr;
+    }
+
+    size_t length = 0;
+    auto &&hash = hash_wire_name(qname, length);
+    if (length == 0) {
+        return nullptr;
+    }
+
+    auto &&mask = _buckets.size() - 1;
+    auto &&i = hash & mask;
+    while (_buckets[i] != 0) {
+        auto &&e = _entries[_buckets[i] - 1];
+        if (e.hash == hash
+            && equal(qname, qname + length, &_names[e.name_offset],
+                [](uint8_t x, uint8_t y) {return ascii_tolower(x) == y;})) {
+            return &e;
+        }
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+
+// Implementation of class 'hosts_file'
+
+hosts_file::hosts_file(const char *const file_name)
+:
+    _file_name {file_name},
+    _table {hosts_table::load(file_name)}
+{
+    syslog(LOG_INFO, "loaded %zu names from %s", _table.load()->size(),
+        _file_name.c_str());
+
+    _inotify = inotify_init1(IN_CLOEXEC);
+    if (_inotify == -1) {
+        syslog(LOG_WARNING, "could not watch %s: %s", _file_name.c_str(),
+            strerror(errno));
+        return;
+    }
+
+    // Watches the directory as editors may replace the file.
+    auto &&slash = _file_name.rfind('/');
+    auto &&directory = string(".");
+    if (slash != string::npos) {
+        directory = _file_name.substr(0, slash == 0 ? 1 : slash);
+    }
+    _watch = inotify_add_watch(_inotify, directory.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (_watch == -1) {
+        syslog(LOG_WARNING, "could not watch %s: %s", _file_name.c_str(),
+            strerror(errno));
+        return;
+    }
+
+    _running = true;
+    _worker_thread = thread(&hosts_file::run, this);
+}
+
+hosts_file::~hosts_file()
+{
+    _running = false;
+    if (_watch != -1) {
+        // This makes an 'IN_IGNORED' event to wake the worker thread.
+        inotify_rm_watch(_inotify, _watch);
+    }
+    if (_worker_thread.joinable()) {
+        _worker_thread.join();
+    }
+    if (_inotify != -1) {
+        close(_inotify);
+    }
+}
+
+void hosts_file::reload()
+{
+    try {
+        auto &&table = hosts_table::load(_file_name.c_str());
+        _table.store(table);
+
+        syslog(LOG_INFO, "reloaded %zu names from %s", table->size(),
+            _file_name.c_str());
+    }
+    catch (const system_error &error) {
+        syslog(LOG_ERR, "%s", error.what());
+    }
+}
+
+void hosts_file::run()
+{
+    auto &&slash = _file_name.rfind('/');
+    auto &&base_name = _file_name.substr(slash == string::npos ? 0 : slash + 1);
+
+    alignas(inotify_event) array<char, 4096> buffer;
+    while (_running) {
+        auto &&size = read(_inotify, buffer.data(), buffer.size());
+        if (size == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_ERR, "could not read inotify events: %s",
+                strerror(errno));
+            break;
+        }
+
+        bool changed = false;
+        auto &&i = buffer.data();
+        while (i < buffer.data() + size) {
+            auto &&event = reinterpret_cast<const inotify_event *>(i);
+            if (event->len != 0 && base_name == event->name) {
+                changed = true;
+            }
+            i += sizeof (inotify_event) + event->len;
+        }
+
+        if (changed && _running) {
+            reload();
+        }
+    }
+}
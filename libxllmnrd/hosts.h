@@ -0,0 +1,225 @@
+// hosts.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef HOSTS_H
+#define HOSTS_H 1
+
+#include "shared_snapshot.h"
+#include <netinet/in.h>
+#include <utility>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /**
+     * Compiled read-only table of host names and addresses.
+     *
+     * Names are kept in the wire format in lowercase and indexed by an
+     * open-addressing hash table.
+     */
+    class hosts_table
+    {
+    public:
+
+        /// Range of addresses in a table.
+        template<class T>
+        struct range
+        {
+            const T *first = nullptr;
+            const T *last = nullptr;
+
+            const T *begin() const
+            {
+                return first;
+            }
+
+            const T *end() const
+            {
+                return last;
+            }
+
+            bool empty() const
+            {
+                return first == last;
+            }
+        };
+
+        /// Entry for a name.
+        struct entry
+        {
+            std::uint32_t hash;
+            std::uint32_t name_offset;
+            std::uint32_t in_first;
+            std::uint32_t in_last;
+            std::uint32_t in6_first;
+            std::uint32_t in6_last;
+        };
+
+    private:
+
+        /// Concatenated names in the wire format.
+        std::vector<std::uint8_t> _names;
+
+        std::vector<in_addr> _in_addresses;
+
+        std::vector<in6_addr> _in6_addresses;
+
+        std::vector<entry> _entries;
+
+        /// Hash buckets holding entry indices plus one, or zero if empty.
+        std::vector<std::uint32_t> _buckets;
+
+    protected:
+
+        /**
+         * Inserts a name if not found.
+         *
+         * @return the index of the entry for the name
+         */
+        std::uint32_t insert_name(const std::uint8_t *name);
+
+        /// Rebuilds the hash buckets.
+        void rehash(size_t bucket_count);
+
+        /// Groups pending addresses by the entries.
+        template<class T, class Equal>
+        void group_addresses(
+            const std::vector<std::pair<std::uint32_t, T>> &pending,
+            std::vector<T> &addresses, std::uint32_t entry::*first,
+            std::uint32_t entry::*last, Equal equal);
+
+    public:
+
+        hosts_table() = default;
+
+        /**
+         * Compiles a table from text in the hosts file format.
+         *
+         * @param text text of a hosts file
+         * @param size size of the text
+         */
+        hosts_table(const char *text, size_t size);
+
+        /**
+         * Loads a table from a file in the hosts file format.
+         *
+         * The file is mapped into memory while it is compiled.
+         *
+         * @param file_name name of a hosts file
+         */
+        [[nodiscard]]
+        static std::shared_ptr<const hosts_table> load(const char *file_name);
+
+        /// Returns the number of names in the table.
+        size_t size() const
+        {
+            return _entries.size();
+        }
+
+        /**
+         * Finds an entry for a name.
+         *
+         * @param qname a name in the wire format, which must already be
+         * validated
+         * @return a pointer to the entry, or null if not found
+         */
+        const entry *find(const std::uint8_t *qname) const;
+
+        range<in_addr> in_addresses(const entry &e) const
+        {
+            return {_in_addresses.data() + e.in_first,
+                _in_addresses.data() + e.in_last};
+        }
+
+        range<in6_addr> in6_addresses(const entry &e) const
+        {
+            return {_in6_addresses.data() + e.in6_first,
+                _in6_addresses.data() + e.in6_last};
+        }
+    };
+
+    /**
+     * Hosts file source that reloads the table on changes.
+     *
+     * The table is replaced atomically so that readers always see a
+     * consistent table without locking.
+     */
+    class hosts_file
+    {
+    private:
+
+        std::string _file_name;
+
+        shared_snapshot<hosts_table> _table;
+
+        /// File descriptor for inotify.
+        int _inotify {-1};
+
+        /// Watch descriptor for the directory of the file.
+        int _watch {-1};
+
+        std::atomic<bool> _running {false};
+
+        std::thread _worker_thread;
+
+    public:
+
+        explicit hosts_file(const char *file_name);
+
+        // This class is not copy-constructible.
+        hosts_file(const hosts_file &) = delete;
+
+        ~hosts_file();
+
+
+        // This class is not copy-assignable.
+        void operator =(const hosts_file &) = delete;
+
+
+        /**
+         * Returns the current table.
+         *
+         * This function is thread-safe.
+         */
+        std::shared_ptr<const hosts_table> table() const
+        {
+            return _table.load();
+        }
+
+        /**
+         * Reloads the table from the file.
+         *
+         * If the file cannot be loaded, the current table is kept.
+         */
+        void reload();
+
+    protected:
+
+        void run();
+    };
+}
+
+#endif
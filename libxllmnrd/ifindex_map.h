@@ -0,0 +1,262 @@
+// ifindex_map.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef IFINDEX_MAP_H
+#define IFINDEX_MAP_H 1
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /**
+     * Map from interface indices to values.
+     *
+     * Interface indices are small and dense on Linux, so values are stored
+     * in a vector indexed by them.  Indices are allocated cyclically since
+     * Linux 6.6, however, so they may keep growing while interfaces are
+     * created and deleted.  An index is therefore stored in the vector only
+     * if it is below 'DENSE_LIMIT' and the vector would still be at least
+     * about a quarter full, and in a hash table otherwise.  Erased values
+     * release their slots, so the size of the map is bounded by the number
+     * of values rather than by the largest index ever inserted.
+     */
+    template<class T>
+    class ifindex_map
+    {
+    public:
+
+        /// Limit of interface indices stored in the vector.
+        static constexpr unsigned int DENSE_LIMIT = 1U << 16;
+
+        /// Number of indices that may be stored in the vector regardless of
+        /// the number of values.
+        static constexpr unsigned int DENSE_MINIMUM = 64;
+
+    private:
+
+        struct slot
+        {
+            T value {};
+            bool present = false;
+        };
+
+        /// Values for indices below its size.
+        std::vector<slot> _dense;
+
+        /// Values for indices at or above the size of '_dense'.
+        std::unordered_map<unsigned int, T> _sparse;
+
+        size_t _size = 0;
+
+    protected:
+
+        /**
+         * Returns the limit of indices that may be stored in the vector for
+         * the current number of values in it.
+         */
+        size_t dense_bound() const
+        {
+            auto &&bound = 4 * (_size - _sparse.size() + 1);
+            if (bound < DENSE_MINIMUM) {
+                bound = DENSE_MINIMUM;
+            }
+            return bound < DENSE_LIMIT ? bound : DENSE_LIMIT;
+        }
+
+        /**
+         * Resizes the vector, moving values between it and the hash table
+         * so that each index stays on its side.
+         */
+        void resize_dense(const size_t size)
+        {
+            if (size > _dense.size()) {
+                _dense.resize(size);
+                for (auto i = _sparse.begin(); i != _sparse.end(); ) {
+                    if (i->first < size) {
+                        _dense[i->first] = {std::move(i->second), true};
+                        i = _sparse.erase(i);
+                    }
+                    else {
+                        ++i;
+                    }
+                }
+            }
+            else {
+                for (size_t i = size; i != _dense.size(); ++i) {
+                    if (_dense[i].present) {
+                        _sparse.emplace(static_cast<unsigned int>(i),
+                            std::move(_dense[i].value));
+                    }
+                }
+                _dense.resize(size);
+            }
+        }
+
+        /**
+         * Trims unused slots at the end of the vector, and moves values to
+         * the hash table if the vector has become too sparse.
+         */
+        void trim_dense()
+        {
+            auto &&bound = dense_bound();
+            if (_dense.size() > 2 * bound) {
+                resize_dense(bound);
+            }
+            while (!_dense.empty() && !_dense.back().present) {
+                _dense.pop_back();
+            }
+            if (_dense.capacity() > DENSE_MINIMUM
+                && _dense.capacity() > 4 * _dense.size()) {
+                _dense.shrink_to_fit();
+            }
+        }
+
+    public:
+
+        /// Returns the number of values.
+        size_t size() const
+        {
+            return _size;
+        }
+
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        /**
+         * Returns the number of slots used to store values, which is
+         * bounded by a multiple of the number of values.
+         */
+        size_t slot_count() const
+        {
+            return _dense.size() + _sparse.size();
+        }
+
+        /**
+         * Finds the value for an index.
+         *
+         * @return a pointer to the value, or null if not found
+         */
+        const T *find(const unsigned int index) const
+        {
+            if (index < _dense.size()) {
+                auto &&s = _dense[index];
+                return s.present ? &s.value : nullptr;
+            }
+            if (_sparse.empty()) {
+                return nullptr;
+            }
+
+            auto &&found = _sparse.find(index);
+            return found != _sparse.end() ? &found->second : nullptr;
+        }
+
+        T *find(const unsigned int index)
+        {
+            return const_cast<T *>(
+                static_cast<const ifindex_map *>(this)->find(index));
+        }
+
+        /**
+         * Inserts or replaces the value for an index.
+         *
+         * @return true if the value is inserted, false if replaced
+         */
+        bool insert_or_assign(const unsigned int index, T value)
+        {
+            if (index >= _dense.size() && index < dense_bound()) {
+                auto &&size = 2 * _dense.size();
+                if (size > dense_bound()) {
+                    size = dense_bound();
+                }
+                resize_dense(size > index ? size : index + 1);
+            }
+
+            if (index < _dense.size()) {
+                auto &&s = _dense[index];
+                auto &&inserted = !s.present;
+                s = {std::move(value), true};
+                _size += inserted;
+                return inserted;
+            }
+
+            auto &&inserted =
+                _sparse.insert_or_assign(index, std::move(value)).second;
+            _size += inserted;
+            return inserted;
+        }
+
+        /**
+         * Removes the value for an index.
+         *
+         * @return true if the value is removed, false if not found
+         */
+        bool erase(const unsigned int index)
+        {
+            if (index < _dense.size()) {
+                auto &&s = _dense[index];
+                if (!s.present) {
+                    return false;
+                }
+                s = slot();
+            }
+            else if (_sparse.erase(index) == 0) {
+                return false;
+            }
+
+            _size -= 1;
+            trim_dense();
+            return true;
+        }
+
+        /**
+         * Removes all the values.
+         */
+        void clear()
+        {
+            _dense.clear();
+            _dense.shrink_to_fit();
+            _sparse.clear();
+            _size = 0;
+        }
+
+        /**
+         * Calls a function for each index and value in no particular order.
+         */
+        template<class Function>
+        void for_each(Function function) const
+        {
+            for (size_t i = 0; i != _dense.size(); ++i) {
+                if (_dense[i].present) {
+                    function(static_cast<unsigned int>(i), _dense[i].value);
+                }
+            }
+            for (auto &&i : _sparse) {
+                function(i.first, i.second);
+            }
+        }
+    };
+}
+
+#endif
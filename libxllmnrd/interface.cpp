@@ -23,20 +23,35 @@
 #include "interface.h"
 
 #include <arpa/inet.h>
-#include <net/if.h>
 #include <syslog.h>
+#include <vector>
+#include <string>
+#include <array>
 #include <algorithm>
 #include <cstring>
 #include <cassert>
 
 using std::array;
+using std::atomic_load;
+using std::atomic_store;
+using std::find;
 using std::for_each;
 using std::get;
 using std::lock_guard;
+using std::make_shared;
 using std::memcmp;
-using std::set;
+using std::remove;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::unique_lock;
+using std::this_thread::get_id;
 using namespace xllmnrd;
 
+/// Last generation given to an interface.
+static std::atomic<std::uint32_t> last_generation {0};
+
 /*
  * Methods of the 'std::less' specializations.
  */
@@ -57,161 +72,563 @@ interface_manager::~interface_manager()
     remove_interfaces();
 }
 
+/*
+ * Lock of the mutex for changes.
+ *
+ * Changes made under the lock outside batches are published when the
+ * outermost lock is released, and events queued under it are dispatched
+ * after that.
+ */
+class interface_manager::update_lock
+{
+private:
+
+    interface_manager *_manager;
+
+public:
+
+    explicit update_lock(interface_manager *const manager)
+    :
+        _manager {manager}
+    {
+        _manager->_interfaces_mutex.lock();
+        _manager->_update_depth += 1;
+    }
+
+    // This class is not copy-constructible.
+    update_lock(const update_lock &) = delete;
+
+    ~update_lock()
+    {
+        _manager->_update_depth -= 1;
+        auto &&outermost = _manager->_update_depth == 0;
+        if (outermost) {
+            _manager->publish_changes();
+        }
+        _manager->_interfaces_mutex.unlock();
+
+        if (outermost) {
+            _manager->dispatch_events();
+        }
+    }
+
+
+    // This class is not copy-assignable.
+    void operator =(const update_lock &) = delete;
+};
+
+
 void interface_manager::add_interface_listener(interface_listener *listener)
 {
-    interface_listener *expected = nullptr;
-    _interface_listener.compare_exchange_weak(expected, listener);
+    lock_guard<decltype(_listeners_mutex)> lock {_listeners_mutex};
+
+    auto &&listeners = *_listeners;
+    if (find(listeners.begin(), listeners.end(), listener) == listeners.end()) {
+        auto &&added = make_shared<vector<interface_listener *>>(listeners);
+        added->push_back(listener);
+        atomic_store(&_listeners,
+            shared_ptr<const vector<interface_listener *>>(added));
+    }
 }
 
 void interface_manager::remove_interface_listener(interface_listener *listener)
 {
-    interface_listener *expected = listener;
-    _interface_listener.compare_exchange_weak(expected, nullptr);
+    {
+        lock_guard<decltype(_listeners_mutex)> lock {_listeners_mutex};
+
+        auto &&removed = make_shared<vector<interface_listener *>>(*_listeners);
+        removed->erase(remove(removed->begin(), removed->end(), listener),
+            removed->end());
+        atomic_store(&_listeners,
+            shared_ptr<const vector<interface_listener *>>(removed));
+    }
+
+    // The dispatcher may still hold the previous listeners.
+    if (_dispatcher.load() != get_id()) {
+        unique_lock<decltype(_dispatch_mutex)> lock {_dispatch_mutex};
+
+        _dispatch_completion.wait(lock,
+            [this]() {
+                return !_dispatching;
+            });
+    }
+}
+
+void interface_manager::dispatch_events()
+{
+    while (!_events.empty()) {
+        bool expected = false;
+        if (!_dispatching.compare_exchange_strong(expected, true)) {
+            // The other thread will dispatch the events.
+            return;
+        }
+        _dispatcher = get_id();
+
+        state_event event {};
+        bool dispatched = false;
+        while (_events.try_pop(event)) {
+            if (event.enabled) {
+                fire_interface_enabled({this, event.interface_index});
+            }
+            else {
+                fire_interface_disabled({this, event.interface_index});
+            }
+            dispatched = true;
+        }
+        if (dispatched) {
+            fire_interface_events_dispatched();
+        }
+
+        {
+            lock_guard<decltype(_dispatch_mutex)> lock {_dispatch_mutex};
+
+            _dispatcher = std::thread::id();
+            _dispatching = false;
+        }
+        _dispatch_completion.notify_all();
+    }
 }
 
 void interface_manager::fire_interface_enabled(const interface_event &event) const
 {
-    auto &&listener = _interface_listener.load();
-    if (listener != nullptr) {
-        listener->interface_enabled(event);
+    auto &&listeners = atomic_load(&_listeners);
+    for (auto &&i : *listeners) {
+        i->interface_enabled(event);
     }
 }
 
 void interface_manager::fire_interface_disabled(const interface_event &event) const
 {
-    auto &&listener = _interface_listener.load();
-    if (listener != nullptr) {
-        listener->interface_disabled(event);
+    auto &&listeners = atomic_load(&_listeners);
+    for (auto &&i : *listeners) {
+        i->interface_disabled(event);
+    }
+}
+
+void interface_manager::fire_interface_events_dispatched()
+{
+    auto &&listeners = atomic_load(&_listeners);
+    for (auto &&i : *listeners) {
+        i->interface_events_dispatched(this);
     }
 }
 
-set<in_addr> interface_manager::in_addresses(
-    const unsigned int index) const
+template<class Function>
+bool interface_manager::modify_interface(const unsigned int interface_index,
+    Function modify)
 {
-    lock_guard<decltype(_interfaces_mutex)> lock(_interfaces_mutex);
+    auto &&table = _staging ? _staged_interfaces : _interfaces;
+    auto &&found = table.find(interface_index);
+
+    if (_staging && found != nullptr) {
+        // Staged interfaces are never shared and made non-const, so they
+        // are modified in place to avoid copying addresses for each one.
+        modify(const_cast<interface &>(**found));
+        return false;
+    }
+
+    auto &&modified = interface();
+    if (found != nullptr) {
+        modified = **found;
+    }
+    else if (!_staging) {
+        modified.generation = ++last_generation;
+    }
 
-    auto &&found = _interfaces.find(index);
-    if (found != _interfaces.end()) {
-        return found->second.in_addresses;
+    auto &&changed = modify(modified);
+    if (_staging) {
+        // Every interface in a dump is recorded even if not changed.
+        table.insert_or_assign(interface_index,
+            make_shared<interface>(std::move(modified)));
+        return false;
+    }
+    if (!changed) {
+        return false;
     }
 
-    return set<in_addr>();
+    table.insert_or_assign(interface_index,
+        make_shared<const interface>(std::move(modified)));
+    interfaces_modified();
+    return true;
 }
 
-set<in6_addr> interface_manager::in6_addresses(
-    const unsigned int index) const
+void interface_manager::interfaces_modified()
 {
-    lock_guard<decltype(_interfaces_mutex)> lock(_interfaces_mutex);
+    _batch_changes += 1;
+}
 
-    auto &&found = _interfaces.find(index);
-    if (found != _interfaces.end()) {
-        return found->second.in6_addresses;
+void interface_manager::publish_changes()
+{
+    if (_batch_depth == 0 && _batch_changes != 0) {
+        publish_interfaces();
+        _batch_changes = 0;
     }
+}
+
+void interface_manager::interface_state_changed(
+    const unsigned int interface_index, const bool enabled)
+{
+    if (_batch_depth != 0) {
+        // Only the first change in a batch has the original state.
+        if (_batch_enabled.find(interface_index) == nullptr) {
+            _batch_enabled.insert_or_assign(interface_index, !enabled);
+        }
+    }
+    else {
+        _events.push({interface_index, enabled});
+    }
+}
+
+string interface_manager::interface_name(
+    const unsigned int interface_index) const
+{
+    auto &&found = _interfaces.find(interface_index);
+    if (found != nullptr && !(*found)->name.empty()) {
+        return (*found)->name;
+    }
+    return "#" + to_string(interface_index);
+}
+
+bool interface_manager::should_log_change() const
+{
+    // Changes in batches are summarized unless more verbose.
+    return debug_level() >= (_batch_depth != 0 ? 1 : 0);
+}
+
+void interface_manager::publish_interfaces()
+{
+    _snapshot.store(make_shared<const interface_table>(_interfaces));
+}
+
+auto interface_manager::find_interface(const unsigned int index) const
+    -> shared_ptr<const interface>
+{
+    auto &&snapshot = _snapshot.load();
+
+    auto &&found = snapshot->find(index);
+    if (found != nullptr) {
+        return *found;
+    }
+    return nullptr;
+}
+
+auto interface_manager::in_addresses(
+    const unsigned int index) const -> in_address_set
+{
+    auto &&interface = find_interface(index);
+    if (interface != nullptr) {
+        return interface->in_addresses;
+    }
+
+    return in_address_set();
+}
+
+auto interface_manager::in6_addresses(
+    const unsigned int index) const -> in6_address_set
+{
+    auto &&interface = find_interface(index);
+    if (interface != nullptr) {
+        return interface->in6_addresses;
+    }
+
+    return in6_address_set();
+}
+
+void interface_manager::begin_batch()
+{
+    update_lock lock {this};
 
-    return set<in6_addr>();
+    _batch_depth += 1;
+}
+
+void interface_manager::commit_batch()
+{
+    update_lock lock {this};
+
+    assert(_batch_depth != 0);
+    _batch_depth -= 1;
+    if (_batch_depth != 0) {
+        return;
+    }
+
+    // The changes are published when the update lock is released.
+    if (_batch_changes != 0 && debug_level() >= 0) {
+        syslog(LOG_DEBUG, "applied %zu interface changes", _batch_changes);
+    }
+
+    // Fires events only for interfaces whose states are actually changed.
+    auto &&changed = vector<std::pair<unsigned int, bool>>();
+    _batch_enabled.for_each(
+        [this, &changed](unsigned int index, bool enabled) {
+            auto &&found = _interfaces.find(index);
+            auto &&current = found != nullptr && (*found)->enabled;
+            if (current != enabled) {
+                changed.emplace_back(index, current);
+            }
+        });
+    _batch_enabled.clear();
+
+    for_each(changed.begin(), changed.end(),
+        [this](const std::pair<unsigned int, bool> &i) {
+            interface_state_changed(i.first, i.second);
+        });
+}
+
+void interface_manager::begin_staging()
+{
+    update_lock lock {this};
+
+    _staged_interfaces.clear();
+    _staging = true;
+}
+
+void interface_manager::commit_staging()
+{
+    update_lock lock {this};
+
+    if (!_staging) {
+        return;
+    }
+    _staging = false;
+
+    auto &&staged = interface_table();
+    std::swap(staged, _staged_interfaces);
+
+    batch changes {this};
+
+    auto &&removed = vector<unsigned int>();
+    _interfaces.for_each(
+        [&removed, &staged](unsigned int index,
+            const shared_ptr<const interface> &)
+        {
+            if (staged.find(index) == nullptr) {
+                removed.push_back(index);
+            }
+        });
+    for_each(removed.begin(), removed.end(),
+        [this](unsigned int index)
+        {
+            remove_interface(index);
+        });
+
+    staged.for_each(
+        [this](unsigned int index, const shared_ptr<const interface> &i)
+        {
+            apply_interface(index, *i);
+        });
+}
+
+void interface_manager::abort_staging()
+{
+    update_lock lock {this};
+
+    _staging = false;
+    _staged_interfaces.clear();
+}
+
+void interface_manager::apply_interface(const unsigned int interface_index,
+    const interface &target)
+{
+    auto &&found = _interfaces.find(interface_index);
+
+    // This keeps the current snapshot alive while it is replaced.
+    auto &&current = shared_ptr<const interface>();
+    if (found != nullptr) {
+        current = *found;
+    }
+    else {
+        current = make_shared<const interface>();
+    }
+
+    set_interface_metadata(interface_index, target.name, target.mtu,
+        target.kind);
+
+    for (auto &&i : current->in_addresses) {
+        if (target.in_addresses.count(i) == 0) {
+            remove_interface_address(interface_index, AF_INET, &i);
+        }
+    }
+    for (auto &&i : current->in6_addresses) {
+        if (target.in6_addresses.count(i) == 0) {
+            remove_interface_address(interface_index, AF_INET6, &i);
+        }
+    }
+    for (auto &&i : target.in_addresses) {
+        if (current->in_addresses.count(i) == 0) {
+            add_interface_address(interface_index, AF_INET, &i);
+        }
+    }
+    for (auto &&i : target.in6_addresses) {
+        if (current->in6_addresses.count(i) == 0) {
+            add_interface_address(interface_index, AF_INET6, &i);
+        }
+    }
+
+    if (target.enabled && !current->enabled) {
+        enable_interface(interface_index);
+    }
+    else if (!target.enabled && current->enabled) {
+        disable_interface(interface_index);
+    }
 }
 
 void interface_manager::remove_interfaces()
 {
-    lock_guard<decltype(_interfaces_mutex)> lock {_interfaces_mutex};
+    update_lock lock {this};
+
+    // Any staged state is discarded.
+    _staging = false;
+    _staged_interfaces.clear();
 
-    for_each(_interfaces.begin(), _interfaces.end(),
-        [this](const auto &i)
+    auto &&disabled = vector<unsigned int>();
+    _interfaces.for_each(
+        [&disabled](unsigned int index, const shared_ptr<const interface> &i)
         {
-            if (get<1>(i).enabled) {
-                fire_interface_disabled({this, i.first});
+            if (i->enabled) {
+                disabled.push_back(index);
             }
         });
 
-    _interfaces.clear();
+    if (!_interfaces.empty()) {
+        _interfaces.clear();
+        interfaces_modified();
+    }
+
+    for_each(disabled.begin(), disabled.end(),
+        [this](unsigned int index)
+        {
+            interface_state_changed(index, false);
+        });
 }
 
-void interface_manager::enable_interface(const unsigned int interface_index)
+void interface_manager::remove_interface(const unsigned int interface_index)
 {
-    lock_guard<decltype(_interfaces_mutex)> lock {_interfaces_mutex};
+    update_lock lock {this};
 
-    auto &interface = _interfaces[interface_index];
-    if (!interface.enabled) {
-        interface.enabled = true;
+    if (_staging) {
+        _staged_interfaces.erase(interface_index);
+        return;
+    }
+
+    disable_interface(interface_index);
+    if (_interfaces.erase(interface_index)) {
+        interfaces_modified();
+    }
+}
+
+void interface_manager::enable_interface(const unsigned int interface_index)
+{
+    update_lock lock {this};
 
-        if (debug_level() >= 0) {
-            auto interface_name = array<char, IF_NAMESIZE> {'?'};
-            if_indextoname(interface_index, interface_name.data());
-            syslog(LOG_DEBUG, "device enabled: %s", interface_name.data());
+    auto &&changed = modify_interface(interface_index,
+        [](interface &i) {
+            if (i.enabled) {
+                return false;
+            }
+            i.enabled = true;
+            return true;
+        });
+    if (changed) {
+        if (should_log_change()) {
+            syslog(LOG_DEBUG, "device enabled: %s",
+                interface_name(interface_index).c_str());
         }
 
-        fire_interface_enabled({this, interface_index});
+        interface_state_changed(interface_index, true);
     }
 }
 
 void interface_manager::disable_interface(const unsigned int interface_index)
 {
-    lock_guard<decltype(_interfaces_mutex)> lock {_interfaces_mutex};
-
-    auto &interface = _interfaces[interface_index];
-    if (interface.enabled) {
-        interface.enabled = false;
+    update_lock lock {this};
 
-        if (debug_level() >= 0) {
-            auto interface_name = array<char, IF_NAMESIZE> {'?'};
-            if_indextoname(interface_index, interface_name.data());
-            syslog(LOG_DEBUG, "device disabled: %s", interface_name.data());
+    auto &&changed = modify_interface(interface_index,
+        [](interface &i) {
+            if (!i.enabled) {
+                return false;
+            }
+            i.enabled = false;
+            return true;
+        });
+    if (changed) {
+        if (should_log_change()) {
+            syslog(LOG_DEBUG, "device disabled: %s",
+                interface_name(interface_index).c_str());
         }
 
-        fire_interface_disabled({this, interface_index});
+        interface_state_changed(interface_index, false);
     }
 }
 
+void interface_manager::set_interface_metadata(
+    const unsigned int interface_index, const string &name,
+    const unsigned int mtu, const string &kind)
+{
+    update_lock lock {this};
+
+    modify_interface(interface_index,
+        [&](interface &i) {
+            if (i.name == name && i.mtu == mtu && i.kind == kind) {
+                return false;
+            }
+            i.name = name;
+            i.mtu = mtu;
+            i.kind = kind;
+            return true;
+        });
+}
+
 void interface_manager::add_interface_address(unsigned int index,
     int family, const void *address, size_t address_size)
 {
-    auto interface_name = array<char, IF_NAMESIZE> {'?'};
-    if_indextoname(index, interface_name.data());
-
-    lock_guard<decltype(_interfaces_mutex)> lock {_interfaces_mutex};
+    update_lock lock {this};
 
     switch (family) {
     case AF_INET:
         if (address_size >= sizeof (in_addr)) {
-            auto &addresses = _interfaces[index].in_addresses;
-            auto &&inserted = addresses.insert(
-                *static_cast<const in_addr *>(address));
+            auto &&inserted = modify_interface(index,
+                [address](interface &i) {
+                    return get<1>(i.in_addresses.insert(
+                        *static_cast<const in_addr *>(address)));
+                });
 
-            if (get<1>(inserted) && debug_level() >= 0) {
+            if (inserted && should_log_change()) {
                 auto addrstr = array<char, INET_ADDRSTRLEN> {};
                 inet_ntop(AF_INET, address, addrstr.data(), addrstr.size());
                 syslog(LOG_DEBUG, "IPv4 address added: %s on %s",
-                    addrstr.data(), interface_name.data());
+                    addrstr.data(), interface_name(index).c_str());
             }
         }
         else {
             syslog(LOG_INFO, "short IPv4 address (size = %zu) on %s",
-                address_size, interface_name.data());
+                address_size, interface_name(index).c_str());
         }
         break;
 
     case AF_INET6:
         if (address_size >= sizeof (in6_addr)) {
-            auto &addresses = _interfaces[index].in6_addresses;
-            auto &&inserted = addresses.insert(
-                *static_cast<const in6_addr *>(address));
+            auto &&inserted = modify_interface(index,
+                [address](interface &i) {
+                    return get<1>(i.in6_addresses.insert(
+                        *static_cast<const in6_addr *>(address)));
+                });
 
-            if (get<1>(inserted) && debug_level() >= 0) {
+            if (inserted && should_log_change()) {
                 auto addrstr = array<char, INET6_ADDRSTRLEN> {};
                 inet_ntop(AF_INET6, address, addrstr.data(), addrstr.size());
                 syslog(LOG_DEBUG, "IPv6 address added: %s on %s",
-                    addrstr.data(), interface_name.data());
+                    addrstr.data(), interface_name(index).c_str());
             }
         }
         else {
             syslog(LOG_INFO, "short IPv6 address (size = %zu) on %s",
-                address_size, interface_name.data());
+                address_size, interface_name(index).c_str());
         }
         break;
 
     default:
         syslog(LOG_INFO, "address of unknown family %d on %s",
-            family, interface_name.data());
+            family, interface_name(index).c_str());
         break;
     }
 }
@@ -219,53 +636,54 @@ void interface_manager::add_interface_address(unsigned int index,
 void interface_manager::remove_interface_address(unsigned int index,
     int family, const void *address, size_t address_size)
 {
-    auto interface_name = array<char, IF_NAMESIZE> {'?'};
-    if_indextoname(index, interface_name.data());
-
-    lock_guard<decltype(_interfaces_mutex)> lock {_interfaces_mutex};
+    update_lock lock {this};
 
     switch (family) {
     case AF_INET:
         if (address_size >= sizeof (in_addr)) {
-            auto &addresses = _interfaces[index].in_addresses;
-            auto &&erased = addresses.erase(
-                *static_cast<const in_addr *>(address));
+            auto &&erased = modify_interface(index,
+                [address](interface &i) {
+                    return i.in_addresses.erase(
+                        *static_cast<const in_addr *>(address)) != 0;
+                });
 
-            if (erased != 0 && debug_level() >= 0) {
+            if (erased && should_log_change()) {
                 auto addrstr = array<char, INET_ADDRSTRLEN> {};
                 inet_ntop(AF_INET, address, addrstr.data(), addrstr.size());
                 syslog(LOG_DEBUG, "IPv4 address removed: %s on %s",
-                    addrstr.data(), interface_name.data());
+                    addrstr.data(), interface_name(index).c_str());
             }
         }
         else {
             syslog(LOG_INFO, "short IPv4 address (size = %zu) on %s",
-                address_size, interface_name.data());
+                address_size, interface_name(index).c_str());
         }
         break;
 
     case AF_INET6:
         if (address_size >= sizeof (in6_addr)) {
-            auto &addresses = _interfaces[index].in6_addresses;
-            auto &&erased = addresses.erase(
-                *static_cast<const in6_addr *>(address));
+            auto &&erased = modify_interface(index,
+                [address](interface &i) {
+                    return i.in6_addresses.erase(
+                        *static_cast<const in6_addr *>(address)) != 0;
+                });
 
-            if (erased != 0 && debug_level() >= 0) {
+            if (erased && should_log_change()) {
                 auto addrstr = array<char, INET6_ADDRSTRLEN> {};
                 inet_ntop(AF_INET6, address, addrstr.data(), addrstr.size());
                 syslog(LOG_DEBUG, "IPv6 address removed: %s on %s",
-                    addrstr.data(), interface_name.data());
+                    addrstr.data(), interface_name(index).c_str());
             }
         }
         else {
             syslog(LOG_INFO, "short IPv6 address (size = %zu) on %s",
-                address_size, interface_name.data());
+                address_size, interface_name(index).c_str());
         }
         break;
 
     default:
         syslog(LOG_INFO, "address of unknown family %d on %s",
-            family, interface_name.data());
+            family, interface_name(index).c_str());
         break;
     }
 }
@@ -19,13 +19,21 @@
 #ifndef INTERFACE_H
 #define INTERFACE_H 1
 
+#include "address_set.h"
+#include "ifindex_map.h"
+#include "mpsc_queue.h"
+#include "shared_snapshot.h"
 #include "posix.h"
 #include <netinet/in.h>
 #include <unistd.h>
+#include <condition_variable>
+#include <thread>
 #include <mutex>
-#include <unordered_map>
-#include <set>
+#include <vector>
+#include <string>
 #include <atomic>
+#include <memory>
+#include <cstdint>
 
 // Specializations of 'std::less' for address types.
 
@@ -80,22 +88,62 @@ namespace xllmnrd
         virtual void interface_enabled(const interface_event &event) = 0;
 
         virtual void interface_disabled(const interface_event &event) = 0;
+
+        /**
+         * Called after a run of events from a source has been dispatched.
+         *
+         * Listeners may defer the work common to the events to this
+         * function.
+         */
+        virtual void interface_events_dispatched(interface_manager *)
+        {
+            // Nothing to do.
+        }
     };
 
     /**
      * Abstract class of interface managers.
      *
      * This class keeps a table of interface addresses for IPv4 and IPv6.
+     *
+     * Readers get immutable snapshots of the table, which are published
+     * once for each batch or update by 'shared_snapshot', so that they
+     * never wait for updates.
+     *
+     * Events are queued while the table is changed and dispatched to the
+     * listeners after the mutex is released, so that listeners may take
+     * time or call back into the manager without blocking others.
      */
     class interface_manager
     {
-    protected:
+    public:
+
+        /// Set of IPv4 addresses of an interface.
+        using in_address_set = address_set<in_addr>;
+
+        /// Set of IPv6 addresses of an interface.
+        using in6_address_set = address_set<in6_addr>;
 
+        /// Immutable snapshot of an interface.
         struct interface
         {
+            /// Generation of the interface, which is drawn from a counter
+            /// shared by all the managers, so that it changes when the index
+            /// is reused for another interface.
+            std::uint32_t generation = 0;
             bool enabled = false;
-            std::set<in_addr> in_addresses;
-            std::set<in6_addr> in6_addresses;
+
+            /// Name of the interface, or empty if unknown.
+            std::string name;
+
+            /// MTU of the interface, or zero if unknown.
+            unsigned int mtu = 0;
+
+            /// Kind of the link such as "veth", or empty if not specified.
+            std::string kind;
+
+            in_address_set in_addresses;
+            in6_address_set in6_addresses;
 
             /// Returns true if no address is stored, false otherwise.
             bool empty() const
@@ -104,17 +152,73 @@ namespace xllmnrd
             }
         };
 
+        /// Map from interface indices to interface snapshots.
+        using interface_table = ifindex_map<std::shared_ptr<const interface>>;
+
     private:
 
+        /// Event about an interface state, which is queued for dispatch.
+        struct state_event
+        {
+            unsigned int interface_index;
+            bool enabled;
+        };
+
+        class update_lock;
+
         int _debug_level = 0;
 
-        std::atomic<interface_listener *> _interface_listener {nullptr};
+        /// Registered listeners, which are replaced on each change.
+        std::shared_ptr<const std::vector<interface_listener *>> _listeners {
+            std::make_shared<const std::vector<interface_listener *>>()};
+
+        std::mutex _listeners_mutex;
+
+        /// Events waiting for dispatch.
+        mpsc_queue<state_event> _events;
+
+        /// Indicates if a thread is dispatching events.
+        std::atomic<bool> _dispatching {false};
+
+        /// Thread dispatching events.
+        std::atomic<std::thread::id> _dispatcher {};
 
-        /// Map from interface indices to interfaces.
-        std::unordered_map<unsigned int, interface> _interfaces;
+        /// Mutex for the end of a dispatch.
+        std::mutex _dispatch_mutex;
+
+        /// Condition variable notified when a dispatch ends.
+        std::condition_variable _dispatch_completion;
+
+        /// Nesting depth of update locks, which is guarded by the mutex.
+        unsigned int _update_depth = 0;
+
+        /// Working table of interfaces, which is guarded by the mutex.
+        interface_table _interfaces;
+
+        /// Last published snapshot of the table.
+        shared_snapshot<interface_table> _snapshot;
+
+        /// Indicates if the first refresh has completed.
+        std::atomic<bool> _ready {false};
 
         mutable std::recursive_mutex _interfaces_mutex;
 
+        /// Nesting depth of batches.
+        unsigned int _batch_depth = 0;
+
+        /// Number of changes to be published at the end of the outermost
+        /// batch or update.
+        std::size_t _batch_changes = 0;
+
+        /// Enabled states of interfaces before the changes in the batch.
+        ifindex_map<bool> _batch_enabled;
+
+        /// Indicates if changes are staged instead of being applied.
+        bool _staging = false;
+
+        /// Table of interfaces being staged.
+        interface_table _staged_interfaces;
+
     protected:
 
         /**
@@ -150,24 +254,112 @@ namespace xllmnrd
 
         /**
          * Adds a listener for interface events.
+         *
+         * This function is thread-safe.
          */
         void add_interface_listener(interface_listener *listener);
 
         /**
          * Removes a listener for interface events.
+         *
+         * This function is thread-safe.  Unless called from a listener, it
+         * waits for any event being dispatched so that the listener may be
+         * destroyed on return.
          */
         void remove_interface_listener(interface_listener *listener);
 
     private:
 
+        /**
+         * Dispatches the queued events to the listeners unless another
+         * thread is dispatching them.
+         *
+         * This function must be called with the mutex unlocked.
+         */
+        void dispatch_events();
+
         // Fires an event for an added interface.
         void fire_interface_enabled(const interface_event &event) const;
 
         // Fires an event for a removed interface.
         void fire_interface_disabled(const interface_event &event) const;
 
+        // Notifies the listeners of the end of a run of events.
+        void fire_interface_events_dispatched();
+
+        /**
+         * Modifies a copy of an interface and replaces the interface with
+         * it.
+         *
+         * This function must be called with the mutex locked.
+         *
+         * @param modify a function that modifies an interface and returns
+         * true if it is changed
+         */
+        template<class Function>
+        bool modify_interface(unsigned int interface_index, Function modify);
+
+        /**
+         * Publishes a snapshot of the working table.
+         *
+         * This function must be called with the mutex locked.
+         */
+        void publish_interfaces();
+
+        /**
+         * Counts a change of the working table, which is published when
+         * the outermost batch or update ends.
+         *
+         * This function must be called with the mutex locked.
+         */
+        void interfaces_modified();
+
+        /**
+         * Publishes the working table if changed and not in a batch.
+         *
+         * This function must be called with the mutex locked.
+         */
+        void publish_changes();
+
+        /**
+         * Queues an event for a changed interface unless in a batch.
+         *
+         * This function must be called with the mutex locked.
+         */
+        void interface_state_changed(unsigned int interface_index,
+            bool enabled);
+
+        /**
+         * Returns the name of an interface for logging.
+         *
+         * This function must be called with the mutex locked.
+         */
+        std::string interface_name(unsigned int interface_index) const;
+
+        /// Returns true if each change shall be logged.
+        bool should_log_change() const;
+
+        /**
+         * Applies changes to make an interface equal to a target.
+         *
+         * This function must be called with the mutex locked.
+         */
+        void apply_interface(unsigned int interface_index,
+            const interface &target);
+
     public:
 
+        /**
+         * Returns a snapshot of an interface.
+         *
+         * This function is thread-safe and does not block.
+         *
+         * @param {unsigned int} index an interface index
+         * @return a snapshot of the interface, or null if not found
+         */
+        std::shared_ptr<const interface> find_interface(
+            unsigned int interface_index) const;
+
         /**
          * Returns a copy of the IPv4 addresses of an interface.
          *
@@ -176,7 +368,7 @@ namespace xllmnrd
          * @param {unsigned int} index an interface index
          * @return a copy of the IPv4 addresses of the interface
          */
-        std::set<in_addr> in_addresses(unsigned int interface_index) const;
+        in_address_set in_addresses(unsigned int interface_index) const;
 
         /**
          * Returns a copy of the IPv6 addresses of an interface.
@@ -186,18 +378,113 @@ namespace xllmnrd
          * @param {unsigned int} index an interface index
          * @return a copy of the IPv6 addresses of the interface
          */
-        std::set<in6_addr> in6_addresses(unsigned int interface_index) const;
+        in6_address_set in6_addresses(unsigned int interface_index) const;
 
         // Refreshes the interface addresses.
         //
         // This function is thread safe.
         virtual void refresh(bool maybe_asynchronous = false) = 0;
 
+        /**
+         * Returns true if the first refresh has completed, after which the
+         * table has every interface.
+         *
+         * This function is thread-safe and does not block.
+         */
+        bool ready() const
+        {
+            return _ready;
+        }
+
     protected:
 
+        /// Marks the first refresh completed.
+        void set_ready()
+        {
+            _ready = true;
+        }
+
+        /**
+         * Scope of a batch of changes.
+         *
+         * Changes in a batch are published at once at the end of the
+         * outermost batch, and events are fired only for the interfaces
+         * whose states differ from those at the beginning.
+         */
+        class batch
+        {
+        private:
+
+            interface_manager *_manager;
+
+        public:
+
+            explicit batch(interface_manager *const manager)
+            :
+                _manager {manager}
+            {
+                _manager->begin_batch();
+            }
+
+            // This class is not copy-constructible.
+            batch(const batch &) = delete;
+
+            ~batch()
+            {
+                _manager->commit_batch();
+            }
+
+
+            // This class is not copy-assignable.
+            void operator =(const batch &) = delete;
+        };
+
+        /**
+         * Begins a batch of changes.
+         *
+         * Each call must be paired with a call to 'commit_batch'.
+         */
+        void begin_batch();
+
+        /**
+         * Ends a batch of changes.
+         *
+         * If this ends the outermost batch, the changes are published and
+         * events are fired.
+         */
+        void commit_batch();
+
+        /**
+         * Begins staging the state of all the interfaces.
+         *
+         * Until 'commit_staging' is called, changes are made to a staged
+         * table instead of the current one.
+         */
+        void begin_staging();
+
+        /**
+         * Replaces the current interface table with the staged one.
+         *
+         * Only the differences are applied as a batch, so that no events
+         * are fired for unchanged interfaces.
+         */
+        void commit_staging();
+
+        /**
+         * Discards the staged table without applying it.
+         */
+        void abort_staging();
+
         /// Removes all the interfaces.
         void remove_interfaces();
 
+        /**
+         * Removes an interface.
+         *
+         * The interface is disabled first if enabled.
+         */
+        void remove_interface(unsigned int interface_index);
+
         /**
          * Enables an interface.
          */
@@ -208,6 +495,17 @@ namespace xllmnrd
          */
         void disable_interface(unsigned int interface_index);
 
+        /**
+         * Sets the metadata of an interface.
+         *
+         * @param name the name of the interface
+         * @param mtu the MTU of the interface, or zero if unknown
+         * @param kind the kind of the link, or empty if not specified
+         */
+        void set_interface_metadata(unsigned int interface_index,
+            const std::string &name, unsigned int mtu,
+            const std::string &kind);
+
         /**
          * Adds an interface address.
          */
@@ -0,0 +1,58 @@
+// interface_policy.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "interface_policy.h"
+
+#include <fnmatch.h>
+#include <algorithm>
+#include <cstring>
+
+using std::any_of;
+using std::string;
+using std::strncmp;
+using std::vector;
+using namespace xllmnrd;
+
+// Prefix of rules for link kinds.
+static const char KIND_PREFIX[] = "kind:";
+
+bool interface_policy::matches_any(const vector<string> &rules,
+    const char *const name, const char *const kind)
+{
+    return any_of(rules.begin(), rules.end(),
+        [name, kind](const string &rule) {
+            auto &&prefix_length = sizeof KIND_PREFIX - 1;
+            if (strncmp(rule.c_str(), KIND_PREFIX, prefix_length) == 0) {
+                return fnmatch(rule.c_str() + prefix_length, kind, 0) == 0;
+            }
+            return fnmatch(rule.c_str(), name, 0) == 0;
+        });
+}
+
+bool interface_policy::allows(const char *const name,
+    const char *const kind) const
+{
+    if (!_includes.empty() && !matches_any(_includes, name, kind)) {
+        return false;
+    }
+    return !matches_any(_excludes, name, kind);
+}
@@ -0,0 +1,80 @@
+// interface_policy.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef INTERFACE_POLICY_H
+#define INTERFACE_POLICY_H 1
+
+#include <vector>
+#include <string>
+
+namespace xllmnrd
+{
+    /**
+     * Policy that selects interfaces by include and exclude rules.
+     *
+     * A rule is either a 'fnmatch' pattern for interface names or
+     * 'kind:' followed by a pattern for link kinds such as 'veth' and
+     * 'bridge'.  An interface is allowed if it matches any include rule, or
+     * if there is no include rule, and it matches no exclude rule.
+     */
+    class interface_policy
+    {
+    private:
+
+        std::vector<std::string> _includes;
+
+        std::vector<std::string> _excludes;
+
+    protected:
+
+        /// Returns true if an interface matches any of the rules.
+        static bool matches_any(const std::vector<std::string> &rules,
+            const char *name, const char *kind);
+
+    public:
+
+        /// Adds an include rule.
+        void include(const std::string &rule)
+        {
+            _includes.push_back(rule);
+        }
+
+        /// Adds an exclude rule.
+        void exclude(const std::string &rule)
+        {
+            _excludes.push_back(rule);
+        }
+
+        /// Returns true if there is no rule.
+        bool empty() const
+        {
+            return _includes.empty() && _excludes.empty();
+        }
+
+        /**
+         * Returns true if an interface is allowed by the rules.
+         *
+         * @param name the name of the interface
+         * @param kind the kind of the link, or an empty string if not
+         * specified
+         */
+        bool allows(const char *name, const char *kind) const;
+    };
+}
+
+#endif
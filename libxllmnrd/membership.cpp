@@ -0,0 +1,188 @@
+// membership.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "membership.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <system_error>
+#include <cerrno>
+
+using std::generic_category;
+using std::lock_guard;
+using std::make_shared;
+using std::shared_ptr;
+using std::system_error;
+using std::vector;
+using namespace xllmnrd;
+
+membership_pool::membership_pool(const in6_addr &group,
+    const size_t socket_limit)
+:
+    membership_pool(make_shared<default_posix>(), group, socket_limit)
+{
+    // Nothing to do.
+}
+
+membership_pool::membership_pool(const shared_ptr<posix> &os,
+    const in6_addr &group, const size_t socket_limit)
+:
+    _os {os},
+    _group {group},
+    _socket_limit {socket_limit != 0 ? socket_limit : 1}
+{
+    // Nothing to do.
+}
+
+membership_pool::~membership_pool()
+{
+    for (auto &&i : _sockets) {
+        _os->close(i.fd);
+    }
+}
+
+bool membership_pool::join(const unsigned int interface_index)
+{
+    lock_guard<decltype(_mutex)> lock {_mutex};
+
+    if (_memberships.find(interface_index) != nullptr) {
+        return true;
+    }
+
+    auto &&error = add_membership(interface_index);
+    if (error != 0) {
+        _join_failures += 1;
+        _pending.insert_or_assign(interface_index, true);
+        errno = error;
+        return false;
+    }
+
+    _pending.erase(interface_index);
+    return true;
+}
+
+bool membership_pool::leave(const unsigned int interface_index)
+{
+    lock_guard<decltype(_mutex)> lock {_mutex};
+
+    _pending.erase(interface_index);
+
+    auto &&position = _memberships.find(interface_index);
+    if (position == nullptr) {
+        return false;
+    }
+
+    auto &&s = _sockets[*position];
+    _memberships.erase(interface_index);
+    s.count -= 1;
+
+    const ipv6_mreq mr {
+        _group,          // .ipv6mr_multiaddr
+        interface_index, // .ipv6mr_interface
+    };
+    return _os->setsockopt(s.fd, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &mr) == 0;
+}
+
+size_t membership_pool::retry()
+{
+    lock_guard<decltype(_mutex)> lock {_mutex};
+
+    auto &&indices = vector<unsigned int>();
+    _pending.for_each([&indices](unsigned int index, bool) {
+        indices.push_back(index);
+    });
+
+    size_t joined = 0;
+    for (auto &&i : indices) {
+        _retries += 1;
+        if (add_membership(i) == 0) {
+            _pending.erase(i);
+            joined += 1;
+        }
+        else {
+            _join_failures += 1;
+        }
+    }
+    return joined;
+}
+
+auto membership_pool::get_statistics() const -> statistics
+{
+    lock_guard<decltype(_mutex)> lock {_mutex};
+
+    auto &&result = statistics {};
+    result.joined = _memberships.size();
+    result.pending = _pending.size();
+    result.sockets = _sockets.size();
+    result.join_failures = _join_failures;
+    result.retries = _retries;
+    return result;
+}
+
+int membership_pool::add_membership(const unsigned int interface_index)
+{
+    const ipv6_mreq mr {
+        _group,          // .ipv6mr_multiaddr
+        interface_index, // .ipv6mr_interface
+    };
+
+    size_t i = 0;
+    while (true) {
+        while (i != _sockets.size() && _sockets[i].count >= _sockets[i].limit) {
+            ++i;
+        }
+        if (i == _sockets.size()) {
+            try {
+                open_socket();
+            }
+            catch (const system_error &error) {
+                return error.code().value();
+            }
+        }
+
+        auto &&s = _sockets[i];
+        if (_os->setsockopt(s.fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mr) == 0) {
+            s.count += 1;
+            _memberships.insert_or_assign(interface_index, i);
+            return 0;
+        }
+
+        // The socket option memory of this socket is exhausted, so the next
+        // socket is tried unless this one is empty.
+        auto &&error = errno;
+        if ((error != ENOBUFS && error != ENOMEM) || s.count == 0) {
+            return error;
+        }
+        s.limit = s.count;
+    }
+}
+
+void membership_pool::open_socket()
+{
+    int fd = _os->socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == -1) {
+        throw system_error(errno, generic_category(),
+            "could not open a socket for multicast memberships");
+    }
+
+    _sockets.push_back({fd, 0, _socket_limit});
+}
@@ -0,0 +1,184 @@
+// membership.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef MEMBERSHIP_H
+#define MEMBERSHIP_H 1
+
+#include "ifindex_map.h"
+#include "posix.h"
+#include <netinet/in.h>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /**
+     * Pool of sockets that hold the memberships of an IPv6 multicast group.
+     *
+     * The kernel limits the memberships of each socket by the socket option
+     * memory, so memberships are spread across as many sockets as needed.
+     * These sockets are never bound and receive nothing; the packets sent to
+     * the group are delivered to any socket bound to the port as long as it
+     * has no membership of the group and the socket option
+     * 'IPV6_MULTICAST_ALL' is set.
+     *
+     * Joins that failed are kept pending and retried by 'retry'.
+     */
+    class membership_pool
+    {
+    public:
+
+        /// Default number of memberships per socket.
+        static constexpr size_t DEFAULT_SOCKET_LIMIT = 128;
+
+        /// Counts of memberships.
+        struct statistics
+        {
+            /// Number of interfaces on which the group is joined.
+            size_t joined = 0;
+
+            /// Number of interfaces waiting for a retry.
+            size_t pending = 0;
+
+            /// Number of sockets open.
+            size_t sockets = 0;
+
+            /// Number of failed attempts to join.
+            std::uint64_t join_failures = 0;
+
+            /// Number of attempts to join retried.
+            std::uint64_t retries = 0;
+        };
+
+    private:
+
+        struct member_socket
+        {
+            int fd;
+
+            /// Number of memberships held.
+            size_t count;
+
+            /// Maximum number of memberships.
+            size_t limit;
+        };
+
+        /// Operating system interface to open sockets.
+        std::shared_ptr<posix> _os;
+
+        in6_addr _group;
+
+        size_t _socket_limit;
+
+        std::vector<member_socket> _sockets;
+
+        /// Table from interface indices to socket positions.
+        ifindex_map<size_t> _memberships;
+
+        /// Interfaces for which joins failed.
+        ifindex_map<bool> _pending;
+
+        std::uint64_t _join_failures = 0;
+
+        std::uint64_t _retries = 0;
+
+        mutable std::mutex _mutex;
+
+    public:
+
+        /**
+         * Constructs a pool for a multicast group.
+         *
+         * @param group a multicast group address
+         * @param socket_limit the maximum number of memberships per socket
+         */
+        explicit membership_pool(const in6_addr &group,
+            size_t socket_limit = DEFAULT_SOCKET_LIMIT);
+
+        /**
+         * Constructs a pool whose sockets are opened by an operating system
+         * interface, which may place them in another network namespace.
+         *
+         * @param os an operating system interface
+         * @param group a multicast group address
+         * @param socket_limit the maximum number of memberships per socket
+         */
+        membership_pool(const std::shared_ptr<posix> &os,
+            const in6_addr &group, size_t socket_limit = DEFAULT_SOCKET_LIMIT);
+
+        // This class is not copy-constructible.
+        membership_pool(const membership_pool &) = delete;
+
+        ~membership_pool();
+
+
+        // This class is not copy-assignable.
+        void operator =(const membership_pool &) = delete;
+
+
+        /**
+         * Joins the group on an interface.
+         *
+         * If the join fails, it is kept pending for a retry.
+         *
+         * @param interface_index an interface index
+         * @return true if joined, or false if failed
+         */
+        bool join(unsigned int interface_index);
+
+        /**
+         * Leaves the group on an interface.
+         *
+         * Any pending join for the interface is cancelled.
+         *
+         * @param interface_index an interface index
+         * @return true if left, or false if the group was not joined
+         */
+        bool leave(unsigned int interface_index);
+
+        /**
+         * Retries the pending joins.
+         *
+         * @return the number of joins that succeeded
+         */
+        size_t retry();
+
+        /// Returns the counts of memberships.
+        statistics get_statistics() const;
+
+    protected:
+
+        /**
+         * Adds a membership to any socket that has room for it, opening a new
+         * socket if there is none.
+         *
+         * @return 0 if joined, or an error number
+         */
+        int add_membership(unsigned int interface_index);
+
+        /// Opens a new socket for memberships.
+        void open_socket();
+    };
+}
+
+#endif
@@ -0,0 +1,126 @@
+// mpsc_queue.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H 1
+
+#include <atomic>
+#include <utility>
+
+namespace xllmnrd
+{
+    /**
+     * Lock-free queue for multiple producers and a single consumer.
+     *
+     * Producers link nodes to the head with an atomic exchange, and the
+     * consumer unlinks them from the tail, which is always a dummy node.
+     * A value being pushed may be invisible to the consumer for a moment
+     * even if 'empty' returns false.
+     */
+    template<class T>
+    class mpsc_queue
+    {
+    private:
+
+        struct node
+        {
+            std::atomic<node *> next {nullptr};
+            T value {};
+        };
+
+        /// Last node pushed.
+        std::atomic<node *> _head;
+
+        /// Dummy node before the first value.
+        std::atomic<node *> _tail;
+
+    public:
+
+        mpsc_queue()
+        {
+            auto &&stub = new node();
+            _head.store(stub, std::memory_order_relaxed);
+            _tail.store(stub, std::memory_order_relaxed);
+        }
+
+        // This class is not copy-constructible.
+        mpsc_queue(const mpsc_queue &) = delete;
+
+        ~mpsc_queue()
+        {
+            auto i = _tail.load(std::memory_order_relaxed);
+            while (i != nullptr) {
+                auto &&next = i->next.load(std::memory_order_relaxed);
+                delete i;
+                i = next;
+            }
+        }
+
+
+        // This class is not copy-assignable.
+        void operator =(const mpsc_queue &) = delete;
+
+
+        /**
+         * Returns true if no value is pushed or being pushed.
+         *
+         * This function is thread-safe.
+         */
+        bool empty() const
+        {
+            return _head.load() == _tail.load();
+        }
+
+        /**
+         * Pushes a value.
+         *
+         * This function is thread-safe and does not block.
+         */
+        void push(T value)
+        {
+            auto &&n = new node();
+            n->value = std::move(value);
+
+            auto &&previous = _head.exchange(n);
+            previous->next.store(n, std::memory_order_release);
+        }
+
+        /**
+         * Pops the first value.
+         *
+         * This function must be called only by a single consumer at a time.
+         *
+         * @return true if a value is popped, or false if none is visible
+         */
+        bool try_pop(T &value)
+        {
+            auto &&tail = _tail.load(std::memory_order_relaxed);
+            auto &&next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+
+            value = std::move(next->value);
+            _tail.store(next);
+            delete tail;
+            return true;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,102 @@
+// netns_posix.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "netns_posix.h"
+
+#if XLLMNRD_NETNS
+
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+
+using std::generic_category;
+using std::string;
+using std::strchr;
+using std::system_error;
+using namespace xllmnrd;
+
+// Directory where 'ip netns' keeps named network namespaces.
+static const char NETNS_RUN_DIR[] = "/var/run/netns/";
+
+// Namespace file of the calling thread.
+static const char THREAD_NETNS_PATH[] = "/proc/thread-self/ns/net";
+
+string netns_posix::netns_path(const char *const name)
+{
+    if (strchr(name, '/') != nullptr) {
+        return name;
+    }
+    return NETNS_RUN_DIR + string(name);
+}
+
+netns_posix::netns_posix(const char *const name)
+{
+    auto &&path = netns_path(name);
+    _netns = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_netns == -1) {
+        throw system_error(errno, generic_category(),
+            "could not open the network namespace '" + path + "'");
+    }
+}
+
+netns_posix::~netns_posix()
+{
+    ::close(_netns);
+}
+
+int netns_posix::socket(const int domain, const int type, const int protocol)
+{
+    // Each thread has its own namespace.
+    int current = open(THREAD_NETNS_PATH, O_RDONLY | O_CLOEXEC);
+    if (current == -1) {
+        return -1;
+    }
+    if (setns(_netns, CLONE_NEWNET) == -1) {
+        auto &&error = errno;
+        ::close(current);
+        errno = error;
+        return -1;
+    }
+
+    int fd = default_posix::socket(domain, type, protocol);
+    auto &&error = errno;
+
+    if (setns(current, CLONE_NEWNET) == -1) {
+        // The thread must not stay in the other namespace.
+        error = errno;
+        if (fd != -1) {
+            ::close(fd);
+        }
+        ::close(current);
+        throw system_error(error, generic_category(),
+            "could not return to the original network namespace");
+    }
+    ::close(current);
+
+    errno = error;
+    return fd;
+}
+
+#endif /* XLLMNRD_NETNS */
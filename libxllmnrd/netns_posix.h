@@ -0,0 +1,71 @@
+// netns_posix.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETNS_POSIX_H
+#define NETNS_POSIX_H 1
+
+#include "posix.h"
+
+#if HAVE_SETNS
+
+// Defined to non-zero if libxllmnrd has network namespace support.
+#define XLLMNRD_NETNS 1
+
+#include <string>
+
+namespace xllmnrd
+{
+    /**
+     * POSIX implementation that creates sockets in a network namespace.
+     *
+     * A socket stays in the namespace where it was created, so the calling
+     * thread enters the namespace only to create a socket and leaves it at
+     * once.  Other functions work on any socket as usual.
+     */
+    class netns_posix final: public default_posix
+    {
+    private:
+
+        /// File descriptor for the network namespace.
+        int _netns = -1;
+
+    public:
+
+        /**
+         * Constructs an object for a network namespace.
+         *
+         * @param name the name of a namespace made by 'ip netns', or the
+         * path of a namespace file if it contains a slash
+         */
+        explicit netns_posix(const char *name);
+
+        ~netns_posix() override;
+
+
+        /**
+         * Returns the path of the namespace file for a name.
+         */
+        static std::string netns_path(const char *name);
+
+        int socket(int domain, int type, int protocol) override;
+    };
+}
+
+#endif /* HAVE_SETNS */
+
+#endif
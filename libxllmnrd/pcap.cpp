@@ -0,0 +1,347 @@
+// pcap.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "pcap.h"
+
+#include <arpa/inet.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <array>
+#include <stdexcept>
+#include <cstring>
+
+using std::array;
+using std::invalid_argument;
+using std::memcpy;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::chrono::nanoseconds;
+using namespace xllmnrd;
+
+// Magic numbers of pcap files with microsecond and nanosecond timestamps.
+static const uint32_t MAGIC = 0xa1b2c3d4;
+static const uint32_t MAGIC_NANOSECOND = 0xa1b23c4d;
+
+// Link types.
+static const uint32_t LINKTYPE_NULL = 0;
+static const uint32_t LINKTYPE_ETHERNET = 1;
+static const uint32_t LINKTYPE_LOOP = 108;
+static const uint32_t LINKTYPE_LINUX_SLL = 113;
+static const uint32_t LINKTYPE_IPV6 = 229;
+static const uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+// Sizes of the file header and the record header.
+static const size_t FILE_HEADER_SIZE = 24;
+static const size_t RECORD_HEADER_SIZE = 16;
+
+// Maximum size of a packet to read.
+static const uint32_t MAX_PACKET_SIZE = 262144;
+
+// Ethernet types.
+static const uint16_t ETHERTYPE_IPV6 = 0x86dd;
+static const uint16_t ETHERTYPE_VLAN = 0x8100;
+static const uint16_t ETHERTYPE_QINQ = 0x88a8;
+
+/*
+ * Returns a 16-bit value in network byte order.
+ */
+inline uint16_t get_uint16(const uint8_t *const data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+/*
+ * Puts a 16-bit value in network byte order.
+ */
+inline void put_uint16(uint8_t *const data, const uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value;
+}
+
+/*
+ * Returns a 32-bit value in the host byte order.
+ */
+inline uint32_t host_uint32(const uint8_t *const data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof value);
+    return value;
+}
+
+/*
+ * Adds data to a one's complement sum.
+ */
+static uint32_t add_checksum(uint32_t sum, const uint8_t *data, size_t size)
+{
+    while (size >= 2) {
+        sum += get_uint16(data);
+        data += 2;
+        size -= 2;
+    }
+    if (size != 0) {
+        sum += data[0] << 8;
+    }
+    return sum;
+}
+
+// Member functions of 'pcap_reader'.
+
+pcap_reader::pcap_reader(std::istream &input)
+:
+    _input {input}
+{
+    array<uint8_t, FILE_HEADER_SIZE> header;
+    if (!_input.read(reinterpret_cast<char *>(header.data()), header.size())) {
+        throw invalid_argument("truncated pcap header");
+    }
+
+    auto &&magic = host_uint32(&header[0]);
+    if (magic == MAGIC || magic == MAGIC_NANOSECOND) {
+        _nanosecond = magic == MAGIC_NANOSECOND;
+    }
+    else if (magic == __builtin_bswap32(MAGIC)
+        || magic == __builtin_bswap32(MAGIC_NANOSECOND)) {
+        _swapped = true;
+        _nanosecond = magic == __builtin_bswap32(MAGIC_NANOSECOND);
+    }
+    else {
+        throw invalid_argument("not a pcap file");
+    }
+
+    // Only the lower 16 bits are the link type.
+    _link_type = file_uint32(&header[20]) & 0xffff;
+    switch (_link_type) {
+    case LINKTYPE_NULL:
+    case LINKTYPE_ETHERNET:
+    case LINKTYPE_LOOP:
+    case LINKTYPE_LINUX_SLL:
+    case LINKTYPE_LINUX_SLL2:
+    case PCAP_LINKTYPE_RAW:
+    case LINKTYPE_IPV6:
+        break;
+    default:
+        throw invalid_argument("unsupported link type "
+            + std::to_string(_link_type));
+    }
+}
+
+bool pcap_reader::read(captured_datagram &datagram)
+{
+    while (true) {
+        array<uint8_t, RECORD_HEADER_SIZE> header;
+        _input.read(reinterpret_cast<char *>(header.data()), header.size());
+        if (_input.gcount() == 0) {
+            return false;
+        }
+        if (size_t(_input.gcount()) != header.size()) {
+            throw invalid_argument("truncated pcap record");
+        }
+
+        auto &&seconds = file_uint32(&header[0]);
+        auto &&fraction = file_uint32(&header[4]);
+        auto &&captured = file_uint32(&header[8]);
+        auto &&length = file_uint32(&header[12]);
+        if (captured > MAX_PACKET_SIZE) {
+            throw invalid_argument("too large pcap record");
+        }
+
+        _packet.resize(captured);
+        if (!_input.read(reinterpret_cast<char *>(_packet.data()),
+            captured)) {
+            throw invalid_argument("truncated pcap record");
+        }
+
+        auto &&offset = ipv6_offset();
+        if (captured == length && offset >= 0
+            && decode_ipv6(offset, datagram)) {
+            datagram.time = std::chrono::seconds(seconds)
+                + nanoseconds(_nanosecond ? fraction : fraction * 1000ULL);
+            return true;
+        }
+        _skipped += 1;
+    }
+}
+
+uint32_t pcap_reader::file_uint32(const uint8_t *const data) const
+{
+    auto &&value = host_uint32(data);
+    return _swapped ? __builtin_bswap32(value) : value;
+}
+
+long pcap_reader::ipv6_offset() const
+{
+    size_t offset = 0;
+    switch (_link_type) {
+    case LINKTYPE_ETHERNET:
+        offset = 12;
+        while (offset + 2 <= _packet.size()) {
+            auto &&type = get_uint16(&_packet[offset]);
+            if (type != ETHERTYPE_VLAN && type != ETHERTYPE_QINQ) {
+                if (type != ETHERTYPE_IPV6) {
+                    return -1;
+                }
+                return offset + 2;
+            }
+            offset += 4;
+        }
+        return -1;
+    case LINKTYPE_LINUX_SLL:
+        if (_packet.size() < 16
+            || get_uint16(&_packet[14]) != ETHERTYPE_IPV6) {
+            return -1;
+        }
+        return 16;
+    case LINKTYPE_LINUX_SLL2:
+        if (_packet.size() < 20
+            || get_uint16(&_packet[0]) != ETHERTYPE_IPV6) {
+            return -1;
+        }
+        return 20;
+    case LINKTYPE_NULL:
+    case LINKTYPE_LOOP:
+        // The address family differs among systems, so the IP version is
+        // checked instead.
+        offset = 4;
+        break;
+    default:
+        break;
+    }
+
+    if (_packet.size() <= offset || (_packet[offset] >> 4) != 6) {
+        return -1;
+    }
+    return offset;
+}
+
+bool pcap_reader::decode_ipv6(size_t offset, captured_datagram &datagram)
+    const
+{
+    if (_packet.size() < offset + sizeof (ip6_hdr)) {
+        return false;
+    }
+
+    ip6_hdr ip6;
+    memcpy(&ip6, &_packet[offset], sizeof ip6);
+    auto &&end = offset + sizeof ip6 + ntohs(ip6.ip6_plen);
+    if ((ip6.ip6_vfc >> 4) != 6 || end > _packet.size()) {
+        return false;
+    }
+    offset += sizeof ip6;
+
+    // Extension headers are skipped, but fragments are not reassembled.
+    auto &&next = ip6.ip6_nxt;
+    while (next == IPPROTO_HOPOPTS || next == IPPROTO_ROUTING
+        || next == IPPROTO_DSTOPTS) {
+        if (offset + 8 > end) {
+            return false;
+        }
+        next = _packet[offset];
+        offset += (_packet[offset + 1] + 1) * 8;
+    }
+    if (next != IPPROTO_UDP || offset + sizeof (udphdr) > end) {
+        return false;
+    }
+
+    udphdr udp;
+    memcpy(&udp, &_packet[offset], sizeof udp);
+    auto &&udp_length = size_t(ntohs(udp.uh_ulen));
+    if (udp_length < sizeof udp || offset + udp_length > end) {
+        return false;
+    }
+
+    datagram.source = sockaddr_in6 {};
+    datagram.source.sin6_family = AF_INET6;
+    datagram.source.sin6_port = udp.uh_sport;
+    datagram.source.sin6_addr = ip6.ip6_src;
+    datagram.destination = sockaddr_in6 {};
+    datagram.destination.sin6_family = AF_INET6;
+    datagram.destination.sin6_port = udp.uh_dport;
+    datagram.destination.sin6_addr = ip6.ip6_dst;
+    datagram.payload.assign(_packet.data() + offset + sizeof udp,
+        _packet.data() + offset + udp_length);
+    return true;
+}
+
+// Member functions of 'pcap_writer'.
+
+pcap_writer::pcap_writer(std::ostream &output)
+:
+    _output {output}
+{
+    // The header is written in the host byte order.
+    struct
+    {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t thiszone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t network;
+    } header {MAGIC_NANOSECOND, 2, 4, 0, 0, MAX_PACKET_SIZE,
+        PCAP_LINKTYPE_RAW};
+    static_assert(sizeof header == FILE_HEADER_SIZE);
+    _output.write(reinterpret_cast<const char *>(&header), sizeof header);
+}
+
+void pcap_writer::write(const captured_datagram &datagram)
+{
+    auto &&udp_length = sizeof (udphdr) + datagram.payload.size();
+    _packet.assign(sizeof (ip6_hdr) + udp_length, 0);
+
+    auto &&ip6 = &_packet[0];
+    ip6[0] = 6 << 4;
+    put_uint16(&ip6[4], udp_length);
+    ip6[6] = IPPROTO_UDP;
+    ip6[7] = 1;
+    memcpy(&ip6[8], &datagram.source.sin6_addr, sizeof (in6_addr));
+    memcpy(&ip6[24], &datagram.destination.sin6_addr, sizeof (in6_addr));
+
+    auto &&udp = &_packet[sizeof (ip6_hdr)];
+    memcpy(&udp[0], &datagram.source.sin6_port, 2);
+    memcpy(&udp[2], &datagram.destination.sin6_port, 2);
+    put_uint16(&udp[4], udp_length);
+    std::copy(datagram.payload.begin(), datagram.payload.end(), &udp[8]);
+
+    // The checksum covers the pseudo-header and the datagram.
+    auto &&sum = add_checksum(0, &ip6[8], 2 * sizeof (in6_addr));
+    sum += udp_length + IPPROTO_UDP;
+    sum = add_checksum(sum, udp, udp_length);
+    while (sum > 0xffff) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    auto &&checksum = uint16_t(~sum);
+    put_uint16(&udp[6], checksum != 0 ? checksum : 0xffff);
+
+    auto &&time = datagram.time.count();
+    const uint32_t record[] {
+        uint32_t(time / 1000000000),
+        uint32_t(time % 1000000000),
+        uint32_t(_packet.size()),
+        uint32_t(_packet.size()),
+    };
+    _output.write(reinterpret_cast<const char *>(record), sizeof record);
+    _output.write(reinterpret_cast<const char *>(_packet.data()),
+        _packet.size());
+}
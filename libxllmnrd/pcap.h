@@ -0,0 +1,168 @@
+// pcap.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef PCAP_H
+#define PCAP_H 1
+
+#include <netinet/in.h>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /// Link type of raw IP packets in pcap files.
+    constexpr std::uint32_t PCAP_LINKTYPE_RAW = 101;
+
+    /**
+     * UDP datagram over IPv6 in a capture.
+     */
+    struct captured_datagram
+    {
+        /// Time of the capture since the epoch.
+        std::chrono::nanoseconds time;
+
+        /// Source address and port.
+        sockaddr_in6 source;
+
+        /// Destination address and port.
+        sockaddr_in6 destination;
+
+        std::vector<std::uint8_t> payload;
+    };
+
+    /**
+     * Reader of UDP datagrams over IPv6 in classic pcap files.
+     *
+     * Ethernet with any VLAN tags, Linux cooked captures, BSD loopback and
+     * raw IP are supported as link types.  Any other packets, such as IPv4
+     * ones, fragments and truncated ones, are skipped.
+     */
+    class pcap_reader
+    {
+    private:
+
+        std::istream &_input;
+
+        /// True if the file is in the opposite byte order.
+        bool _swapped = false;
+
+        /// True if the timestamps are in nanoseconds.
+        bool _nanosecond = false;
+
+        std::uint32_t _link_type = 0;
+
+        size_t _skipped = 0;
+
+        std::vector<std::uint8_t> _packet;
+
+    public:
+
+        /**
+         * Constructs a reader and reads the file header.
+         *
+         * The input stream must outlive the object.
+         *
+         * @exception std::invalid_argument if the header is invalid or the
+         * link type is not supported
+         */
+        explicit pcap_reader(std::istream &input);
+
+        // This class is not copy-constructible.
+        pcap_reader(const pcap_reader &) = delete;
+
+
+        // This class is not copy-assignable.
+        void operator =(const pcap_reader &) = delete;
+
+
+        /// Returns the link type of the file.
+        std::uint32_t link_type() const
+        {
+            return _link_type;
+        }
+
+        /// Returns the number of packets skipped so far.
+        size_t skipped() const
+        {
+            return _skipped;
+        }
+
+        /**
+         * Reads the next UDP datagram over IPv6.
+         *
+         * @return true if read, or false at the end of the file
+         * @exception std::invalid_argument if a record is truncated
+         */
+        bool read(captured_datagram &datagram);
+
+    protected:
+
+        std::uint32_t file_uint32(const std::uint8_t *data) const;
+
+        /**
+         * Returns the offset of the IPv6 header in a packet, or -1 if it
+         * is not an IPv6 packet.
+         */
+        long ipv6_offset() const;
+
+        /// Decodes a UDP datagram in an IPv6 packet.
+        bool decode_ipv6(size_t offset, captured_datagram &datagram) const;
+    };
+
+    /**
+     * Writer of UDP datagrams over IPv6 into pcap files of raw IP packets.
+     */
+    class pcap_writer
+    {
+    private:
+
+        std::ostream &_output;
+
+        std::vector<std::uint8_t> _packet;
+
+    public:
+
+        /**
+         * Constructs a writer and writes the file header.
+         *
+         * The output stream must outlive the object.
+         */
+        explicit pcap_writer(std::ostream &output);
+
+        // This class is not copy-constructible.
+        pcap_writer(const pcap_writer &) = delete;
+
+
+        // This class is not copy-assignable.
+        void operator =(const pcap_writer &) = delete;
+
+
+        /**
+         * Writes a datagram as an IPv6 packet with a hop limit of 1.
+         */
+        void write(const captured_datagram &datagram);
+    };
+}
+
+#endif
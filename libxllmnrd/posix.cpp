@@ -40,6 +40,14 @@ int default_posix::bind(const int socket, const sockaddr *const address,
     return ::bind(socket, address, address_len);
 }
 
+int default_posix::setsockopt(const int socket, const int level,
+    const int option_name, const void *const option_value,
+    const socklen_t option_len)
+{
+    return ::setsockopt(socket, level, option_name, option_value,
+        option_len);
+}
+
 int default_posix::close(const int fildes)
 {
     return ::close(fildes);
@@ -56,3 +64,73 @@ ssize_t default_posix::send(const int socket, const void *const buffer,
 {
     return ::send(socket, buffer, length, flags);
 }
+
+ssize_t default_posix::recvmsg(const int socket, msghdr *const message,
+    const int flags)
+{
+    return ::recvmsg(socket, message, flags);
+}
+
+ssize_t default_posix::sendmsg(const int socket, const msghdr *const message,
+    const int flags)
+{
+    return ::sendmsg(socket, message, flags);
+}
+
+int default_posix::recvmmsg(const int socket, mmsghdr *const messages,
+    const unsigned int vlen, const int flags, timespec *const timeout)
+{
+#if HAVE_RECVMMSG
+    return ::recvmmsg(socket, messages, vlen, flags, timeout);
+#else
+    // The timeout is ignored as it is rarely useful.
+    static_cast<void>(timeout);
+
+    auto &&message_flags = flags & ~MSG_WAITFORONE;
+    unsigned int i = 0;
+    while (i != vlen) {
+        auto &&received = recvmsg(socket, &messages[i].msg_hdr,
+            message_flags);
+        if (received == -1) {
+            // Any error after the first message is left for the next call.
+            return i != 0 ? int(i) : -1;
+        }
+        messages[i].msg_len = received;
+        ++i;
+        if ((flags & MSG_WAITFORONE) != 0) {
+            message_flags |= MSG_DONTWAIT;
+        }
+    }
+    return int(i);
+#endif
+}
+
+int default_posix::sendmmsg(const int socket, mmsghdr *const messages,
+    const unsigned int vlen, const int flags)
+{
+#if HAVE_SENDMMSG
+    return ::sendmmsg(socket, messages, vlen, flags);
+#else
+    unsigned int i = 0;
+    while (i != vlen) {
+        auto &&sent = sendmsg(socket, &messages[i].msg_hdr, flags);
+        if (sent == -1) {
+            return i != 0 ? int(i) : -1;
+        }
+        messages[i].msg_len = sent;
+        ++i;
+    }
+    return int(i);
+#endif
+}
+
+int default_posix::poll(pollfd *const fds, const nfds_t nfds,
+    const int timeout)
+{
+    return ::poll(fds, nfds, timeout);
+}
+
+int default_posix::clock_gettime(const clockid_t clock_id, timespec *const tp)
+{
+    return ::clock_gettime(clock_id, tp);
+}
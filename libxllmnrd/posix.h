@@ -20,6 +20,10 @@
 #define POSIX_H 1
 
 #include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <chrono>
 
 namespace xllmnrd
 {
@@ -59,6 +63,19 @@ namespace xllmnrd
                 sizeof *address);
         }
 
+        /// Sets a socket option.
+        ///
+        /// This implementation calls '::setsockopt'.
+        virtual int setsockopt(int socket, int level, int option_name,
+            const void *option_value, socklen_t option_len) = 0;
+
+        template<class T>
+        int setsockopt(int socket, int level, int option_name,
+            const T *option_value) {
+            return setsockopt(socket, level, option_name, option_value,
+                sizeof *option_value);
+        }
+
         /**
          * Closes a file descriptor.
          *
@@ -77,6 +94,55 @@ namespace xllmnrd
         /// This implementation calls '::send'.
         virtual ::ssize_t send(int socket, const void *buffer, ::size_t length,
             int flags) = 0;
+
+        /// Receives a message with its sender and ancillary data.
+        ///
+        /// This implementation calls '::recvmsg'.
+        virtual ::ssize_t recvmsg(int socket, msghdr *message, int flags) = 0;
+
+        /// Sends a message to an address.
+        ///
+        /// This implementation calls '::sendmsg'.
+        virtual ::ssize_t sendmsg(int socket, const msghdr *message,
+            int flags) = 0;
+
+        /// Receives multiple messages.
+        ///
+        /// This implementation calls '::recvmmsg' if available, or
+        /// 'recvmsg' for each message.
+        virtual int recvmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags, timespec *timeout) = 0;
+
+        /// Sends multiple messages.
+        ///
+        /// This implementation calls '::sendmmsg' if available, or 'sendmsg'
+        /// for each message.
+        virtual int sendmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags) = 0;
+
+        /// Waits for events on file descriptors.
+        ///
+        /// This implementation calls '::poll'.
+        virtual int poll(pollfd *fds, nfds_t nfds, int timeout) = 0;
+
+        /// Gets the time of a clock.
+        ///
+        /// This implementation calls '::clock_gettime'.
+        virtual int clock_gettime(clockid_t clock_id, timespec *tp) = 0;
+
+        /// Returns the time of 'CLOCK_MONOTONIC' as a time point of
+        /// 'std::chrono::steady_clock', which uses the same clock.
+        std::chrono::steady_clock::time_point steady_time()
+        {
+            using std::chrono::steady_clock;
+
+            timespec tp {};
+            clock_gettime(CLOCK_MONOTONIC, &tp);
+            return steady_clock::time_point(
+                std::chrono::duration_cast<steady_clock::duration>(
+                    std::chrono::seconds(tp.tv_sec)
+                    + std::chrono::nanoseconds(tp.tv_nsec)));
+        }
     };
 
 
@@ -87,11 +153,18 @@ namespace xllmnrd
     {
     public:
 
+        // The typed overloads would be hidden by the overrides.
+        using posix::bind;
+        using posix::setsockopt;
+
         int socket(int domain, int type, int protocol) override;
 
         int bind(int socket, const sockaddr *address,
             socklen_t address_len) override;
 
+        int setsockopt(int socket, int level, int option_name,
+            const void *option_value, socklen_t option_len) override;
+
         int close(int fildes) override;
 
         ::ssize_t recv(int socket, void *buffer, ::size_t length,
@@ -99,6 +172,122 @@ namespace xllmnrd
 
         ::ssize_t send(int socket, const void *buffer, ::size_t length,
             int flags) override;
+
+        ::ssize_t recvmsg(int socket, msghdr *message, int flags) override;
+
+        ::ssize_t sendmsg(int socket, const msghdr *message,
+            int flags) override;
+
+        int recvmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags, timespec *timeout) override;
+
+        int sendmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags) override;
+
+        int poll(pollfd *fds, nfds_t nfds, int timeout) override;
+
+        int clock_gettime(clockid_t clock_id, timespec *tp) override;
+    };
+
+
+    /**
+     * Default POSIX implementation that cannot be extended.
+     *
+     * As this class is final, calls through it need no virtual dispatch, and
+     * its functions are defined here so that they can be inlined to the
+     * system calls.
+     */
+    class native_posix final: public default_posix
+    {
+    public:
+
+        // The typed overloads would be hidden by the overrides.
+        using posix::bind;
+        using posix::setsockopt;
+
+        int socket(int domain, int type, int protocol) override
+        {
+            return ::socket(domain, type, protocol);
+        }
+
+        int bind(int socket, const sockaddr *address,
+            socklen_t address_len) override
+        {
+            return ::bind(socket, address, address_len);
+        }
+
+        int setsockopt(int socket, int level, int option_name,
+            const void *option_value, socklen_t option_len) override
+        {
+            return ::setsockopt(socket, level, option_name, option_value,
+                option_len);
+        }
+
+        int close(int fildes) override
+        {
+            return ::close(fildes);
+        }
+
+        ::ssize_t recv(int socket, void *buffer, ::size_t length,
+            int flags) override
+        {
+            return ::recv(socket, buffer, length, flags);
+        }
+
+        ::ssize_t send(int socket, const void *buffer, ::size_t length,
+            int flags) override
+        {
+            return ::send(socket, buffer, length, flags);
+        }
+
+        ::ssize_t recvmsg(int socket, msghdr *message, int flags) override
+        {
+            return ::recvmsg(socket, message, flags);
+        }
+
+        ::ssize_t sendmsg(int socket, const msghdr *message,
+            int flags) override
+        {
+            return ::sendmsg(socket, message, flags);
+        }
+
+        int recvmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags, timespec *timeout) override
+        {
+#if HAVE_RECVMMSG
+            return ::recvmmsg(socket, messages, vlen, flags, timeout);
+#else
+            return default_posix::recvmmsg(socket, messages, vlen, flags,
+                timeout);
+#endif
+        }
+
+        int sendmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+            int flags) override
+        {
+#if HAVE_SENDMMSG
+            return ::sendmmsg(socket, messages, vlen, flags);
+#else
+            return default_posix::sendmmsg(socket, messages, vlen, flags);
+#endif
+        }
+
+        int poll(pollfd *fds, nfds_t nfds, int timeout) override
+        {
+            return ::poll(fds, nfds, timeout);
+        }
+
+        int clock_gettime(clockid_t clock_id, timespec *tp) override
+        {
+            return ::clock_gettime(clock_id, tp);
+        }
+
+        /// Hides 'posix::steady_time', which calls 'clock_gettime' by
+        /// virtual dispatch.
+        std::chrono::steady_clock::time_point steady_time()
+        {
+            return std::chrono::steady_clock::now();
+        }
     };
 }
 
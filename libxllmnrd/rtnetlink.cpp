@@ -25,28 +25,42 @@
 #if XLLMNRD_RTNETLINK
 
 #include <linux/rtnetlink.h>
-#include <net/if.h> /* if_indextoname */
+#include <net/if.h>
 #include <syslog.h>
+#include <unistd.h>
 #include <vector>
+#include <string>
+#include <new>
 #include <cstring>
 #include <cerrno>
+#include <cinttypes>
 #include <cassert>
 
+using std::chrono::ceil;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::aligned_alloc;
+using std::bad_alloc;
 using std::generic_category;
 using std::lock_guard;
 using std::make_shared;
-using std::make_unique;
 using std::shared_ptr;
 using std::size_t;
+using std::string;
 using std::system_error;
 using std::thread;
 using std::uint8_t;
+using std::uint32_t;
 using std::unique_lock;
-using std::this_thread::yield;
+using std::this_thread::sleep_for;
 using namespace xllmnrd;
 
+/// Multicast groups of the RTNETLINK socket for notifications.
+static const uint32_t NOTIFICATION_GROUPS =
+    RTMGRP_NOTIFY | RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
 int rtnetlink_interface_manager::open_rtnetlink(
-    const shared_ptr<posix> &os)
+    const shared_ptr<posix> &os, const uint32_t groups)
 {
     int &&rtnetlink = os->socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
     if (rtnetlink < 0) {
@@ -58,12 +72,23 @@ int rtnetlink_interface_manager::open_rtnetlink(
             AF_NETLINK, // .nl_family
             0,          // .nl_pad
             0,          // .nl_pid
-            RTMGRP_NOTIFY | RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR,
-                        // .nl_groups
+            groups,     // .nl_groups
         };
         if (os->bind(rtnetlink, &address) == -1) {
             throw system_error(errno, generic_category(), "could not bind the RTNETLINK socket");
         }
+
+        // Notifications are lost if the socket overflows, so the receive
+        // buffer is made large, beyond the system limit if permitted.
+        // Dumps are paced by the reader and need no such buffer.
+        const int size = RECEIVE_BUFFER_SIZE;
+        if (groups != 0
+            && os->setsockopt(rtnetlink, SOL_SOCKET, SO_RCVBUFFORCE, &size) == -1
+            && os->setsockopt(rtnetlink, SOL_SOCKET, SO_RCVBUF, &size) == -1) {
+            syslog(LOG_WARNING,
+                "could not set the receive buffer size of the RTNETLINK socket: %s",
+                strerror(errno));
+        }
     }
     catch (...) {
         os->close(rtnetlink);
@@ -73,6 +98,18 @@ int rtnetlink_interface_manager::open_rtnetlink(
     return rtnetlink;
 }
 
+bool rtnetlink_interface_manager::enable_strict_check(
+    const shared_ptr<posix> &os, const int rtnetlink)
+{
+#ifdef NETLINK_GET_STRICT_CHK
+    static const int ON = 1;
+    return os->setsockopt(rtnetlink, SOL_NETLINK, NETLINK_GET_STRICT_CHK,
+        &ON) == 0;
+#else
+    return false;
+#endif
+}
+
 rtnetlink_interface_manager::rtnetlink_interface_manager()
 :
     rtnetlink_interface_manager(make_shared<default_posix>())
@@ -82,48 +119,101 @@ rtnetlink_interface_manager::rtnetlink_interface_manager()
 rtnetlink_interface_manager::rtnetlink_interface_manager(
     const shared_ptr<posix> &os)
 :
-    _os {os}, _rtnetlink {open_rtnetlink(_os)}
+    _os {os},
+    _rtnetlink {open_rtnetlink(_os, NOTIFICATION_GROUPS)}
 {
+    try {
+        _dump_rtnetlink = open_rtnetlink(_os, 0);
+    }
+    catch (...) {
+        _os->close(_rtnetlink);
+        throw;
+    }
+
+    // Older kernels ignore the filters in dump requests.
+    if (!enable_strict_check(_os, _rtnetlink)) {
+        syslog(LOG_INFO, "RTNETLINK strict checking not supported");
+    }
+    _dump_filtered = enable_strict_check(_os, _dump_rtnetlink);
+
+    reserve_buffer(MESSAGE_BUFFER_SIZE);
 }
 
 rtnetlink_interface_manager::~rtnetlink_interface_manager()
 {
     stop_worker();
 
-    auto result = _os->close(_rtnetlink);
-    if (result < 0) {
-        syslog(LOG_ERR, "Failed to close the RTNETLINK socket: %s",
-            strerror(errno));
+    for (auto &&i : {_dump_rtnetlink, _rtnetlink}) {
+        auto result = _os->close(i);
+        if (result < 0) {
+            syslog(LOG_ERR, "Failed to close the RTNETLINK socket: %s",
+                strerror(errno));
+        }
     }
 }
 
 void rtnetlink_interface_manager::run()
 {
-    _running = true;
+    {
+        lock_guard<decltype(_worker_mutex)> lock(_worker_mutex);
+
+        _running = true;
+    }
+    _worker_started.notify_all();
+
     while (_running) {
-        process_messages();
+        try {
+            begin_requested_refresh();
+            process_ready(wait_messages());
+        }
+        catch (const system_error &error) {
+            syslog(LOG_ERR, "%s", error.what());
+            // This avoids busy looping on persistent errors.
+            sleep_for(seconds(1));
+        }
+    }
+
+    clear_pending_links();
+    if (_refresh_batch) {
+        _refresh_batch = false;
+        commit_batch();
     }
+
+    {
+        lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+    }
+    // Waiters for a refresh shall not wait for the worker any longer.
+    _refresh_completion.notify_all();
 }
 
 void rtnetlink_interface_manager::request_ifinfos() const
 {
-    uint8_t request[NLMSG_LENGTH(sizeof (ifinfomsg))] = {};
+    alignas(nlmsghdr) uint8_t request[NLMSG_LENGTH(sizeof (ifinfomsg))
+        + RTA_SPACE(sizeof (uint32_t))] = {};
 
     auto nlmsg = reinterpret_cast<nlmsghdr *>(&request[0]);
-    nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof (ifinfomsg));
+    nlmsg->nlmsg_len = sizeof request;
     nlmsg->nlmsg_type = RTM_GETLINK;
     nlmsg->nlmsg_flags = NLM_F_REQUEST | NLM_F_ROOT;
 
     auto ifi = static_cast<ifinfomsg *>(NLMSG_DATA(nlmsg));
     ifi->ifi_family = AF_UNSPEC;
 
+    // Statistics are not used and make most of each message.
+    auto rta = reinterpret_cast<rtattr *>(
+        &request[NLMSG_ALIGN(NLMSG_LENGTH(sizeof (ifinfomsg)))]);
+    rta->rta_type = IFLA_EXT_MASK;
+    rta->rta_len = RTA_LENGTH(sizeof (uint32_t));
+    *static_cast<uint32_t *>(RTA_DATA(rta)) = RTEXT_FILTER_SKIP_STATS;
+
     ssize_t sent = _os->send(_rtnetlink, nlmsg, nlmsg->nlmsg_len, 0);
     if (sent == -1) {
         throw system_error(errno, generic_category(), "could not send a RTNETLINK request");
     }
 }
 
-void rtnetlink_interface_manager::request_ifaddrs() const
+void rtnetlink_interface_manager::request_ifaddrs(const int rtnetlink,
+    const unsigned int interface_index) const
 {
     uint8_t request[NLMSG_LENGTH(sizeof (ifaddrmsg))] = {};
 
@@ -134,102 +224,487 @@ void rtnetlink_interface_manager::request_ifaddrs() const
 
     auto ifa = static_cast<ifaddrmsg *>(NLMSG_DATA(nlmsg));
     ifa->ifa_family = AF_UNSPEC;
+    ifa->ifa_index = interface_index;
 
-    ssize_t sent = _os->send(_rtnetlink, nlmsg, nlmsg->nlmsg_len, 0);
+    ssize_t sent = _os->send(rtnetlink, nlmsg, nlmsg->nlmsg_len, 0);
     if (sent == -1) {
         throw system_error(errno, generic_category(), "could not send a RTNETLINK request");
     }
 }
 
+unsigned int rtnetlink_interface_manager::wait_messages()
+{
+    // The socket for address dumps is polled only while a dump is in
+    // progress.
+    auto &&dumping = _dumping_addresses || _link_address_dump != 0;
+    if (_link_deadlines.empty() && !dumping) {
+        return NOTIFICATION_READY;
+    }
+
+    pollfd fds[MAX_POLL_DESCRIPTORS];
+    int timeout = -1;
+    auto &&count = get_poll_descriptors(fds, timeout);
+    if (timeout == 0) {
+        apply_pending_links();
+        return 0;
+    }
+
+    auto &&ready = _os->poll(fds, count, timeout);
+    if (ready == -1) {
+        if (errno != EINTR) {
+            throw system_error(errno, generic_category(),
+                "could not poll the RTNETLINK sockets");
+        }
+        return 0;
+    }
+    return check_poll(fds, count);
+}
+
+size_t rtnetlink_interface_manager::get_poll_descriptors(pollfd *const fds,
+    int &timeout) const
+{
+    size_t count = 0;
+    fds[count++] = {_rtnetlink, POLLIN, 0};
+    if (_dumping_addresses || _link_address_dump != 0) {
+        fds[count++] = {_dump_rtnetlink, POLLIN, 0};
+    }
+
+    timeout = -1;
+    if (!_link_deadlines.empty()) {
+        // Rounding up avoids spinning for the last fraction of a millisecond.
+        auto &&remains = ceil<milliseconds>(
+            _link_deadlines.front().second - _os->steady_time());
+        timeout = remains.count() > 0 ? static_cast<int>(remains.count()) : 0;
+    }
+    return count;
+}
+
+unsigned int rtnetlink_interface_manager::check_poll(const pollfd *const fds,
+    const size_t count)
+{
+    unsigned int result = 0;
+    for (size_t i = 0; i != count; ++i) {
+        if (fds[i].revents != 0) {
+            result |= fds[i].fd == _rtnetlink ? NOTIFICATION_READY : DUMP_READY;
+        }
+    }
+    if (!_link_deadlines.empty()
+        && _os->steady_time() >= _link_deadlines.front().second) {
+        apply_pending_links();
+    }
+    return result;
+}
+
+void rtnetlink_interface_manager::process_ready(const unsigned int ready)
+{
+    if ((ready & DUMP_READY) != 0) {
+        process_dump_messages();
+    }
+    if ((ready & NOTIFICATION_READY) != 0) {
+        process_messages();
+    }
+}
+
+void rtnetlink_interface_manager::process_poll(const pollfd *const fds,
+    const size_t count)
+{
+    try {
+        process_ready(check_poll(fds, count));
+    }
+    catch (const system_error &error) {
+        syslog(LOG_ERR, "%s", error.what());
+    }
+}
+
+void rtnetlink_interface_manager::set_link_state(
+    const unsigned int interface_index, const bool enabled)
+{
+    if (_coalescing_window.count() <= 0) {
+        if (enabled) {
+            enable_interface(interface_index);
+        }
+        else {
+            disable_interface(interface_index);
+        }
+        return;
+    }
+
+    // Each notification restarts the window of the link.
+    auto &&deadline = _os->steady_time() + _coalescing_window;
+    _pending_links.insert_or_assign(interface_index, {enabled, deadline});
+    _link_deadlines.emplace_back(interface_index, deadline);
+}
+
+void rtnetlink_interface_manager::apply_pending_links()
+{
+    auto &&now = _os->steady_time();
+
+    batch links_batch {this};
+
+    while (!_link_deadlines.empty() && _link_deadlines.front().second <= now) {
+        auto &&front = _link_deadlines.front();
+        auto &&pending = _pending_links.find(front.first);
+        // Superseded deadlines are skipped.
+        if (pending != nullptr && pending->deadline == front.second) {
+            auto &&enabled = pending->enabled;
+            if (enabled) {
+                enable_interface(front.first);
+            }
+            else {
+                disable_interface(front.first);
+            }
+            _pending_links.erase(front.first);
+        }
+        _link_deadlines.pop_front();
+    }
+}
+
+void rtnetlink_interface_manager::clear_pending_links()
+{
+    _pending_links.clear();
+    _link_deadlines.clear();
+}
+
+void rtnetlink_interface_manager::reserve_buffer(const size_t size)
+{
+    if (size > _buffer_size) {
+        auto &&page_size = size_t(sysconf(_SC_PAGESIZE));
+        auto &&rounded = (size + page_size - 1) / page_size * page_size;
+
+        auto &&buffer = static_cast<uint8_t *>(aligned_alloc(page_size,
+            rounded));
+        if (buffer == nullptr) {
+            throw bad_alloc();
+        }
+        _buffer.reset(buffer);
+        _buffer_size = rounded;
+    }
+}
+
 void rtnetlink_interface_manager::process_messages()
 {
-    // Gets the required buffer size.
-    auto &&packet_size = _os->recv(_rtnetlink, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+    // The worker thread blocks here if it has nothing else to wait for, but
+    // an external event loop must never block.
+    int flags = MSG_TRUNC;
+    if (_externally_driven) {
+        flags |= MSG_DONTWAIT;
+    }
+
+    // The real size is returned even if the message is truncated.
+    auto &&packet_size = _os->recv(_rtnetlink, _buffer.get(), _buffer_size,
+        flags);
     if (packet_size == -1) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
+        if (errno == ENOBUFS) {
+            // Some notifications are lost.
+            _overflow_count += 1;
+            syslog(LOG_WARNING,
+                "RTNETLINK socket overflowed (%" PRIu64 " times); resynchronizing",
+                _overflow_count.load());
+            resync();
+            return;
+        }
         throw system_error(errno, generic_category(), "could not receive from RTNETLINK");
     }
+    if (size_t(packet_size) > _buffer_size) {
+        // The message is lost, but the next one shall fit.
+        syslog(LOG_WARNING,
+            "RTNETLINK message truncated (%zd bytes); resynchronizing",
+            packet_size);
+        reserve_buffer(packet_size);
+        if (_dumping_links) {
+            // The end of the link dump may be lost with the message.
+            restart_refresh();
+        }
+        else {
+            resync();
+        }
+        return;
+    }
     if (packet_size != 0) {
-        auto &&buffer = make_unique<uint8_t []>(packet_size);
+        dispatch_messages(_buffer.get(), packet_size);
+    }
+}
 
-        // This must not block.
-        packet_size = _os->recv(_rtnetlink, buffer.get(), packet_size, 0);
-        if (packet_size == -1) {
-            throw system_error(errno, generic_category(), "could not receive from RTNETLINK");
+void rtnetlink_interface_manager::process_dump_messages()
+{
+    // This socket is read only after it is polled.
+    auto &&packet_size = _os->recv(_dump_rtnetlink, _buffer.get(),
+        _buffer_size, MSG_TRUNC | MSG_DONTWAIT);
+    if (packet_size == -1) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
         }
-
-        dispatch_messages(buffer.get(), packet_size);
+        throw system_error(errno, generic_category(), "could not receive from RTNETLINK");
+    }
+    if (size_t(packet_size) > _buffer_size) {
+        // The end of the address dump may be lost with the message.
+        syslog(LOG_WARNING,
+            "RTNETLINK message truncated (%zd bytes); resynchronizing",
+            packet_size);
+        reserve_buffer(packet_size);
+        if (_dumping_addresses) {
+            restart_refresh();
+        }
+        else {
+            cancel_address_refreshes();
+            resync();
+        }
+        return;
+    }
+    if (packet_size != 0) {
+        dispatch_dump_messages(_buffer.get(), packet_size);
     }
 }
 
 void rtnetlink_interface_manager::dispatch_messages(const void *messages,
     size_t size)
 {
+    // A refresh is applied as a single batch until the dumps are done.
+    auto &&notification = !_dumping_links && !_dumping_addresses;
+    if (!notification && !_progressive && !_refresh_batch) {
+        begin_batch();
+        _refresh_batch = true;
+    }
+
     bool done = false;
 
-    auto &&nlmsg = static_cast<const nlmsghdr *>(messages);
-    while (NLMSG_OK(nlmsg, size)) {
-        switch (nlmsg->nlmsg_type) {
+    {
+        // Messages in a buffer are applied as a batch.
+        batch messages_batch {this};
 
-        case NLMSG_NOOP:
-            if (debug_level() >= 1) {
-                syslog(LOG_DEBUG, "Got NLMSG_NOOP");
+        auto &&nlmsg = static_cast<const nlmsghdr *>(messages);
+        while (NLMSG_OK(nlmsg, size)) {
+            switch (nlmsg->nlmsg_type) {
+
+            case NLMSG_NOOP:
+                if (debug_level() >= 1) {
+                    syslog(LOG_DEBUG, "Got NLMSG_NOOP");
+                }
+                break;
+            case NLMSG_ERROR:
+                // An acknowledgment is only to wake the worker thread.
+                if (handle_nlmsgerr(nlmsg)) {
+                    done = true;
+                }
+                break;
+            case NLMSG_DONE:
+                done = true;
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                if ((nlmsg->nlmsg_flags & NLM_F_MULTI) == 0
+                    && (_dumping_addresses || _link_address_dump != 0)) {
+                    // The address dump may be older than this notification.
+                    auto &&offset = _journal.size();
+                    _journal.resize(offset + NLMSG_ALIGN(nlmsg->nlmsg_len));
+                    std::memcpy(&_journal[offset], nlmsg, nlmsg->nlmsg_len);
+                }
+                else if (nlmsg->nlmsg_type == RTM_NEWLINK
+                    || nlmsg->nlmsg_type == RTM_DELLINK) {
+                    handle_ifinfomsg(nlmsg, notification
+                        && (nlmsg->nlmsg_flags & NLM_F_MULTI) == 0);
+                }
+                else {
+                    handle_ifaddrmsg(nlmsg);
+                }
+                break;
+            default:
+                syslog(LOG_DEBUG, "Unknown NETLINK message type: %u",
+                    static_cast<unsigned int>(nlmsg->nlmsg_type));
+                break;
             }
-            break;
-        case NLMSG_ERROR:
-            handle_nlmsgerr(nlmsg);
-            break;
-        case NLMSG_DONE:
-            done = true;
-            break;
-        case RTM_NEWLINK:
-        case RTM_DELLINK:
-            handle_ifinfomsg(nlmsg);
-            break;
-        case RTM_NEWADDR:
-        case RTM_DELADDR:
-            handle_ifaddrmsg(nlmsg);
-            break;
-        default:
-            syslog(LOG_DEBUG, "Unknown NETLINK message type: %u",
-                static_cast<unsigned int>(nlmsg->nlmsg_type));
-            break;
+
+            if ((nlmsg->nlmsg_flags & NLM_F_DUMP_INTR) != 0) {
+                // The dump may be inconsistent.
+                _resync_pending = true;
+            }
+            nlmsg = NLMSG_NEXT(nlmsg, size);
+        }
+    }
+
+    refresh_queued_addresses();
+
+    if (done && _dumping_links) {
+        _dumping_links = false;
+        commit_refresh();
+    }
+}
+
+void rtnetlink_interface_manager::dispatch_dump_messages(const void *messages,
+    size_t size)
+{
+    if (_dumping_addresses && !_progressive && !_refresh_batch) {
+        begin_batch();
+        _refresh_batch = true;
+    }
+
+    bool done = false;
+
+    {
+        batch messages_batch {this};
+
+        auto &&nlmsg = static_cast<const nlmsghdr *>(messages);
+        while (NLMSG_OK(nlmsg, size)) {
+            switch (nlmsg->nlmsg_type) {
+            case NLMSG_ERROR:
+                handle_nlmsgerr(nlmsg);
+                done = true;
+                break;
+            case NLMSG_DONE:
+                done = true;
+                break;
+            case RTM_NEWADDR:
+                if (_link_address_dump != 0 && !_dump_filtered) {
+                    // Without strict checking, all the addresses are dumped.
+                    auto &&ifa = static_cast<const ifaddrmsg *>(
+                        NLMSG_DATA(nlmsg));
+                    if (nlmsg->nlmsg_len < NLMSG_LENGTH(sizeof (ifaddrmsg))
+                        || ifa->ifa_index != _link_address_dump) {
+                        break;
+                    }
+                }
+                handle_ifaddrmsg(nlmsg);
+                break;
+            default:
+                break;
+            }
+
+            if ((nlmsg->nlmsg_flags & NLM_F_DUMP_INTR) != 0) {
+                // The dump may be inconsistent.
+                _resync_pending = true;
+            }
+            nlmsg = NLMSG_NEXT(nlmsg, size);
         }
+    }
+
+    if (done && _dumping_addresses) {
+        _dumping_addresses = false;
+        replay_journal(false);
+        refresh_queued_addresses();
+        commit_refresh();
+    }
+    else if (done && _link_address_dump != 0) {
+        _link_address_dump = 0;
+        replay_journal(!_dumping_links);
+        refresh_queued_addresses();
+    }
+}
+
+void rtnetlink_interface_manager::replay_journal(const bool coalesced)
+{
+    batch journal_batch {this};
 
-        if ((nlmsg->nlmsg_flags & NLM_F_MULTI) == 0) {
-            // There should be no more messages.
-            done = true;
+    auto &&nlmsg = reinterpret_cast<const nlmsghdr *>(_journal.data());
+    auto &&size = _journal.size();
+    while (NLMSG_OK(nlmsg, size)) {
+        if (nlmsg->nlmsg_type == RTM_NEWLINK
+            || nlmsg->nlmsg_type == RTM_DELLINK) {
+            handle_ifinfomsg(nlmsg, coalesced);
+        }
+        else {
+            handle_ifaddrmsg(nlmsg);
         }
         nlmsg = NLMSG_NEXT(nlmsg, size);
     }
+    _journal.clear();
+}
 
-    if (done) {
-        switch (_refresh_state) {
-        case refresh_state::ifinfo:
-            _refresh_state = refresh_state::ifaddr;
-            request_ifaddrs();
-            break;
-        case refresh_state::ifaddr:
-            _refresh_state = refresh_state::standby;
-            end_refresh();
-            break;
-        default:
-            // Nothing to do.
-            break;
+void rtnetlink_interface_manager::refresh_queued_addresses()
+{
+    // The socket runs a single dump at a time.
+    if (_dumping_addresses || _link_address_dump != 0
+        || _address_refreshes.empty()) {
+        return;
+    }
+
+    auto &&interface_index = _address_refreshes.front();
+    _address_refreshes.pop_front();
+    request_ifaddrs(_dump_rtnetlink, interface_index);
+    _link_address_dump = interface_index;
+}
+
+void rtnetlink_interface_manager::cancel_address_refreshes()
+{
+    if (_link_address_dump != 0) {
+        // The rest of the dump would be mixed with the next one.
+        _dump_filtered = reopen_rtnetlink(_dump_rtnetlink, 0);
+        _link_address_dump = 0;
+        replay_journal(!_dumping_links && !_dumping_addresses);
+    }
+    _address_refreshes.clear();
+}
+
+void rtnetlink_interface_manager::commit_refresh()
+{
+    if (_dumping_links || _dumping_addresses) {
+        return;
+    }
+
+    // The refresh supersedes any link states being coalesced.
+    clear_pending_links();
+    commit_staging();
+    if (_refresh_batch) {
+        _refresh_batch = false;
+        commit_batch();
+    }
+    _progressive = false;
+    set_ready();
+    end_refresh();
+
+    if (_resync_pending) {
+        _resync_pending = false;
+        _resync_count += 1;
+        begin_refresh();
+    }
+}
+
+/*
+ * Returns the string value of an attribute.
+ */
+static string attribute_string(const rtattr *const rta)
+{
+    auto &&data = static_cast<const char *>(RTA_DATA(rta));
+    auto &&size = RTA_PAYLOAD(rta);
+    return string(data, strnlen(data, size));
+}
+
+/*
+ * Returns the link kind in an 'IFLA_LINKINFO' attribute.
+ */
+static string link_kind(const rtattr *const linkinfo)
+{
+    auto rta = static_cast<const rtattr *>(RTA_DATA(linkinfo));
+    unsigned int len = RTA_PAYLOAD(linkinfo);
+    while (RTA_OK(rta, len)) {
+        if (rta->rta_type == IFLA_INFO_KIND) {
+            return attribute_string(rta);
         }
+        rta = RTA_NEXT(rta, len);
     }
+    return string();
 }
 
-void rtnetlink_interface_manager::handle_nlmsgerr(const nlmsghdr *const nlmsg) const
+bool rtnetlink_interface_manager::handle_nlmsgerr(const nlmsghdr *const nlmsg) const
 {
     if (nlmsg->nlmsg_len < NLMSG_LENGTH(sizeof (nlmsgerr))) {
-        return;
+        return true;
     }
 
     auto err = static_cast<const nlmsgerr *>(NLMSG_DATA(nlmsg));
+    if (err->error == 0) {
+        return false;
+    }
     syslog(LOG_ERR, "Got NETLINK error: %s", strerror(-(err->error)));
+    return true;
 }
 
-void rtnetlink_interface_manager::handle_ifinfomsg(const nlmsghdr *nlmsg)
+void rtnetlink_interface_manager::handle_ifinfomsg(const nlmsghdr *nlmsg,
+    const bool coalesced)
 {
     if (nlmsg->nlmsg_len < NLMSG_LENGTH(sizeof (ifinfomsg))) {
         return;
@@ -239,9 +714,57 @@ void rtnetlink_interface_manager::handle_ifinfomsg(const nlmsghdr *nlmsg)
     }
 
     auto ifi = static_cast<const ifinfomsg *>(NLMSG_DATA(nlmsg));
-    if (nlmsg->nlmsg_type == RTM_NEWLINK
-        && (ifi->ifi_flags & IFF_UP) != 0
-        && (ifi->ifi_flags & IFF_MULTICAST) != 0) {
+    if (nlmsg->nlmsg_type == RTM_DELLINK) {
+        // The index may be reused for another interface later.
+        _link_verdicts.erase(ifi->ifi_index);
+        _pending_links.erase(ifi->ifi_index);
+        remove_interface(ifi->ifi_index);
+        return;
+    }
+
+    auto &&name = string();
+    unsigned int mtu = 0;
+    auto &&kind = string();
+
+    auto rta = reinterpret_cast<const rtattr *>(ifi + 1);
+    unsigned int len = nlmsg->nlmsg_len - NLMSG_LENGTH(sizeof (ifinfomsg));
+    while (RTA_OK(rta, len)) {
+        switch (rta->rta_type) {
+        case IFLA_IFNAME:
+            name = attribute_string(rta);
+            break;
+        case IFLA_MTU:
+            if (RTA_PAYLOAD(rta) >= sizeof (uint32_t)) {
+                mtu = *static_cast<const uint32_t *>(RTA_DATA(rta));
+            }
+            break;
+        case IFLA_LINKINFO:
+            kind = link_kind(rta);
+            break;
+        default:
+            break;
+        }
+        rta = RTA_NEXT(rta, len);
+    }
+
+    auto &&verdict = _link_verdicts.find(ifi->ifi_index);
+    auto &&excluded = verdict != nullptr && !verdict->allowed;
+    if (!link_allowed(ifi->ifi_index, name, kind)) {
+        return;
+    }
+    if (excluded) {
+        // The addresses of the link have been ignored, even in the address
+        // dump if it came first.
+        _address_refreshes.push_back(ifi->ifi_index);
+    }
+
+    set_interface_metadata(ifi->ifi_index, name, mtu, kind);
+    auto &&enabled = (ifi->ifi_flags & IFF_UP) != 0
+        && (ifi->ifi_flags & IFF_MULTICAST) != 0;
+    if (coalesced) {
+        set_link_state(ifi->ifi_index, enabled);
+    }
+    else if (enabled) {
         enable_interface(ifi->ifi_index);
     }
     else {
@@ -249,6 +772,38 @@ void rtnetlink_interface_manager::handle_ifinfomsg(const nlmsghdr *nlmsg)
     }
 }
 
+bool rtnetlink_interface_manager::link_allowed(
+    const unsigned int interface_index, const string &name,
+    const string &kind)
+{
+    if (_policy.empty()) {
+        return true;
+    }
+
+    // FNV-1a hash of the name and kind.
+    uint32_t hash = 2166136261U;
+    for (auto &&c : name + '\0' + kind) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619U;
+    }
+
+    auto &&verdict = _link_verdicts.find(interface_index);
+    if (verdict == nullptr || verdict->hash != hash) {
+        auto &&allowed = _policy.allows(name.c_str(), kind.c_str());
+        if (!allowed) {
+            if (debug_level() >= 1) {
+                syslog(LOG_DEBUG, "device excluded: %s", name.c_str());
+            }
+            // The link may have been allowed under another name.
+            if (verdict == nullptr || verdict->allowed) {
+                remove_interface(interface_index);
+            }
+        }
+        _link_verdicts.insert_or_assign(interface_index, {hash, allowed});
+        return allowed;
+    }
+    return verdict->allowed;
+}
+
 void rtnetlink_interface_manager::handle_ifaddrmsg(const nlmsghdr *nlmsg)
 {
     if (nlmsg->nlmsg_len < NLMSG_LENGTH(sizeof (ifaddrmsg))) {
@@ -259,6 +814,11 @@ void rtnetlink_interface_manager::handle_ifaddrmsg(const nlmsghdr *nlmsg)
     }
 
     auto ifa = static_cast<const ifaddrmsg *>(NLMSG_DATA(nlmsg));
+    // Addresses on links excluded by the policy are ignored.
+    auto &&verdict = _link_verdicts.find(ifa->ifa_index);
+    if (verdict != nullptr && !verdict->allowed) {
+        return;
+    }
     // Only handles non-temporary and at least link-local addresses.
     if ((ifa->ifa_flags & IFA_F_SECONDARY) != 0
         || (ifa->ifa_flags & IFA_F_TENTATIVE) != 0) {
@@ -288,31 +848,111 @@ void rtnetlink_interface_manager::handle_ifaddrmsg(const nlmsghdr *nlmsg)
 
 void rtnetlink_interface_manager::refresh(bool maybe_asynchronous)
 {
-    start_worker();
-    begin_refresh();
+    if (!_externally_driven) {
+        start_worker();
+    }
+
+    {
+        lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+
+        _refresh_requested = true;
+    }
+    if (_externally_driven) {
+        // This thread is the one that drives the manager.
+        begin_requested_refresh();
+    }
+    else {
+        // The worker thread owns the refresh state, so it begins the
+        // refresh itself.
+        wake_worker();
+    }
 
     if (!maybe_asynchronous) {
+        if (_externally_driven) {
+            // Nothing else drives the manager on this thread.
+            auto &&refreshing = [this]() {
+                lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+                return _refreshing;
+            };
+            while (refreshing()) {
+                pollfd fds[MAX_POLL_DESCRIPTORS];
+                int timeout = -1;
+                auto &&count = get_poll_descriptors(fds, timeout);
+                if (_os->poll(fds, count, timeout) == -1 && errno != EINTR) {
+                    throw system_error(errno, generic_category(),
+                        "could not poll the RTNETLINK sockets");
+                }
+                process_poll(fds, count);
+            }
+            return;
+        }
+
         unique_lock<decltype(_refresh_mutex)> lock(_refresh_mutex);
 
         _refresh_completion.wait(lock,
             [this]() {
-                return !_running || !_refreshing;
+                return !_running || (!_refresh_requested && !_refreshing);
             });
     }
 }
 
+void rtnetlink_interface_manager::begin_requested_refresh()
+{
+    lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+
+    if (_refresh_requested) {
+        _refresh_requested = false;
+        if (!_refreshing) {
+            _refreshing = true;
+            request_dumps();
+        }
+    }
+}
+
+void rtnetlink_interface_manager::wake_worker()
+{
+    // The kernel acknowledges a no-op request, as it does any request.
+    nlmsghdr request {};
+    request.nlmsg_len = NLMSG_LENGTH(0);
+    request.nlmsg_type = NLMSG_NOOP;
+    request.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+
+    // The socket may be reopened by the worker thread.
+    lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+
+    if (_os->send(_rtnetlink, &request, request.nlmsg_len, 0) == -1) {
+        throw system_error(errno, generic_category(), "could not send a RTNETLINK request");
+    }
+}
+
 void rtnetlink_interface_manager::begin_refresh()
 {
     lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
 
     if (!_refreshing) {
         _refreshing = true;
+        request_dumps();
+    }
+}
 
-        remove_interfaces();
+void rtnetlink_interface_manager::request_dumps()
+{
+    // Notifications journaled for an address dump of a link are applied to
+    // the current state.
+    cancel_address_refreshes();
 
-        _refresh_state = refresh_state::ifinfo;
-        request_ifinfos();
+    // The dumps are staged and compared with the current state, except for
+    // the first refresh so that interfaces are usable at once.
+    _progressive = !ready();
+    if (!_progressive) {
+        begin_staging();
     }
+
+    // Both dumps run at once and are merged into the staged table.
+    _dumping_links = true;
+    _dumping_addresses = true;
+    request_ifinfos();
+    request_ifaddrs(_dump_rtnetlink, 0);
 }
 
 void rtnetlink_interface_manager::end_refresh()
@@ -325,16 +965,72 @@ void rtnetlink_interface_manager::end_refresh()
     }
 }
 
+void rtnetlink_interface_manager::resync()
+{
+    {
+        lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+
+        if (_refreshing) {
+            _resync_pending = true;
+            return;
+        }
+    }
+
+    _resync_count += 1;
+    begin_refresh();
+}
+
+void rtnetlink_interface_manager::restart_refresh()
+{
+    // Nothing staged or journaled so far is applied, as the new dumps
+    // supersede them.
+    abort_staging();
+    _journal.clear();
+    if (_refresh_batch) {
+        _refresh_batch = false;
+        commit_batch();
+    }
+
+    lock_guard<decltype(_refresh_mutex)> lock(_refresh_mutex);
+
+    // The rest of the dumps would be mixed with the new ones.
+    if (_dumping_links) {
+        reopen_rtnetlink(_rtnetlink, NOTIFICATION_GROUPS);
+    }
+    if (_dumping_addresses) {
+        _dump_filtered = reopen_rtnetlink(_dump_rtnetlink, 0);
+    }
+
+    _resync_pending = false;
+    _resync_count += 1;
+    request_dumps();
+}
+
+bool rtnetlink_interface_manager::reopen_rtnetlink(int &rtnetlink,
+    const uint32_t groups)
+{
+    auto &&reopened = open_rtnetlink(_os, groups);
+    auto &&filtered = enable_strict_check(_os, reopened);
+
+    if (_os->close(rtnetlink) == -1) {
+        syslog(LOG_ERR, "Failed to close the RTNETLINK socket: %s",
+            strerror(errno));
+    }
+    rtnetlink = reopened;
+    return filtered;
+}
+
 void rtnetlink_interface_manager::start_worker()
 {
-    lock_guard<decltype(_worker_mutex)> lock(_worker_mutex);
+    unique_lock<decltype(_worker_mutex)> lock(_worker_mutex);
 
     if (!_worker_thread.joinable()) {
         _worker_thread = thread(&rtnetlink_interface_manager::run, this);
 
-        while (!_running) {
-            yield();
-        }
+        _worker_started.wait(lock,
+            [this]() {
+                return _running.load();
+            });
     }
 }
 
@@ -346,7 +1042,7 @@ void rtnetlink_interface_manager::stop_worker()
 
     if (_worker_thread.joinable()) {
         // This should make a blocking recv call return.
-        begin_refresh();
+        wake_worker();
 
         _worker_thread.join();
     }
@@ -20,6 +20,7 @@
 #define RTNETLINK_H 1
 
 #include "interface.h"
+#include "interface_policy.h"
 #include "posix.h"
 
 #if HAVE_LINUX_RTNETLINK_H
@@ -33,7 +34,14 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
 #include <cstddef>
 
 namespace xllmnrd
@@ -43,25 +51,142 @@ namespace xllmnrd
     /// Interface manager class based on the Linux RTNETLINK socket.
     class rtnetlink_interface_manager: public interface_manager
     {
+    public:
+
+        /// Default coalescing window for link state notifications, which
+        /// disables coalescing.
+        static constexpr std::chrono::milliseconds
+            DEFAULT_COALESCING_WINDOW {0};
+
+        /// Size of the receive buffer of the RTNETLINK socket.
+        static constexpr int RECEIVE_BUFFER_SIZE = 4 << 20;
+
+        /// Initial size of the buffer for RTNETLINK messages, which is
+        /// large enough for the dump messages of the kernel.
+        static constexpr size_t MESSAGE_BUFFER_SIZE = 32 * 1024;
+
+        /// Maximum number of descriptors to poll for a manager.
+        static constexpr size_t MAX_POLL_DESCRIPTORS = 2;
+
     private:
 
-        enum class refresh_state: char
+        /// Bits of the sockets ready for reading.
+        enum: unsigned int
         {
-            standby,
-            ifinfo,
-            ifaddr,
+            NOTIFICATION_READY = 1U << 0,
+            DUMP_READY = 1U << 1,
+        };
+
+        /// Verdict of the interface policy for a link.
+        struct link_verdict
+        {
+            /// Hash of the name and kind of the link when evaluated.
+            std::uint32_t hash;
+
+            bool allowed;
+        };
+
+        /// Link state waiting for the end of its coalescing window.
+        struct pending_link
+        {
+            bool enabled;
+
+            /// End of the window, which is extended by each notification.
+            std::chrono::steady_clock::time_point deadline;
         };
 
         /// Operating system interface.
         std::shared_ptr<posix> _os;
 
+        /// Deleter for memory allocated by 'aligned_alloc'.
+        struct free_delete
+        {
+            void operator ()(void *p) const
+            {
+                std::free(p);
+            }
+        };
+
         /// File descriptor for the RTNETLINK socket.
         int _rtnetlink {-1};
 
-        /// Indicates if a refresh is in progress.
+        /// File descriptor for the RTNETLINK socket for address dumps, which
+        /// run concurrently with link dumps on the other socket.
+        int _dump_rtnetlink {-1};
+
+        /// Indicates if the kernel filters dumps on the socket for address
+        /// dumps by strict checking.
+        bool _dump_filtered = false;
+
+        /// Page-aligned buffer for RTNETLINK messages.
+        ///
+        /// This is used only by the worker thread.
+        std::unique_ptr<std::uint8_t [], free_delete> _buffer;
+
+        /// Size of the buffer.
+        size_t _buffer_size = 0;
+
+        /// Indicates if a refresh is in progress, which is guarded by the
+        /// refresh mutex.
         bool _refreshing {false};
 
-        refresh_state _refresh_state = refresh_state::standby;
+        /// Indicates if a refresh has been requested by 'refresh' and not
+        /// begun by the worker thread yet, which is guarded by the refresh
+        /// mutex.
+        bool _refresh_requested {false};
+
+        /// Indicates if the manager is driven by an external event loop
+        /// instead of the worker thread.
+        bool _externally_driven = false;
+
+        /// Indicates if the link dump of the refresh is in progress.
+        std::atomic<bool> _dumping_links {false};
+
+        /// Indicates if the address dump of the refresh is in progress.
+        std::atomic<bool> _dumping_addresses {false};
+
+        /// Notifications received while the address dump is in progress,
+        /// which are replayed after the dump as they may be newer.
+        ///
+        /// This is used only by the worker thread.
+        std::vector<std::uint8_t> _journal;
+
+        /// Indicates if the refresh in progress is applied as messages
+        /// arrive instead of being staged, which is the case for the first
+        /// one as there is nothing to compare with.
+        std::atomic<bool> _progressive {false};
+
+        /// Indicates if a batch is open for the refresh in progress.
+        ///
+        /// This is used only by the worker thread.
+        bool _refresh_batch = false;
+
+        /// Window in which link state notifications are coalesced.
+        std::chrono::milliseconds _coalescing_window
+            {DEFAULT_COALESCING_WINDOW};
+
+        /// Link states waiting for the ends of their windows.
+        ///
+        /// This is used only by the worker thread.
+        ifindex_map<pending_link> _pending_links;
+
+        /// Deadlines of the pending link states in order, including those
+        /// superseded by later notifications.
+        ///
+        /// This is used only by the worker thread.
+        std::deque<std::pair<unsigned int,
+            std::chrono::steady_clock::time_point>> _link_deadlines;
+
+        /// Indicates if another refresh is needed after the current one.
+        ///
+        /// This is used only by the worker thread.
+        bool _resync_pending = false;
+
+        /// Number of times the RTNETLINK socket overflowed.
+        std::atomic<std::uint64_t> _overflow_count {0};
+
+        /// Number of refreshes made to recover from overflows.
+        std::atomic<std::uint64_t> _resync_count {0};
 
         /// Mutex for the refresh task.
         mutable std::mutex _refresh_mutex;
@@ -69,6 +194,25 @@ namespace xllmnrd
         // Condition variable for the refresh task.
         mutable std::condition_variable _refresh_completion;
 
+        /// Policy that selects interfaces.
+        interface_policy _policy;
+
+        /// Cached verdicts of the policy for links.
+        ///
+        /// This is used only by the worker thread.
+        ifindex_map<link_verdict> _link_verdicts;
+
+        /// Links whose addresses shall be dumped when the socket for address
+        /// dumps is free.
+        ///
+        /// This is used only by the worker thread.
+        std::deque<unsigned int> _address_refreshes;
+
+        /// Index of the link whose addresses are being dumped, or zero.
+        ///
+        /// This is used only by the worker thread.
+        unsigned int _link_address_dump = 0;
+
         // Indicates if the interface manager loop is running.
         std::atomic<bool> _running {false};
 
@@ -78,15 +222,29 @@ namespace xllmnrd
         // Mutex for the worker.
         mutable std::mutex _worker_mutex;
 
+        /// Condition variable notified when the worker thread has started.
+        std::condition_variable _worker_started;
+
     protected:
 
         /*
          * Opens a RTNETLINK socket.
          *
          * @param os an operation system interface
+         * @param groups multicast groups for notifications, or zero for none
          */
         [[nodiscard]]
-        static int open_rtnetlink(const std::shared_ptr<posix> &os);
+        static int open_rtnetlink(const std::shared_ptr<posix> &os,
+            std::uint32_t groups);
+
+        /**
+         * Enables strict checking of dump requests on a RTNETLINK socket so
+         * that the kernel filters the dumps.
+         *
+         * @return true if enabled, or false if not supported
+         */
+        static bool enable_strict_check(const std::shared_ptr<posix> &os,
+            int rtnetlink);
 
     public:
 
@@ -102,22 +260,130 @@ namespace xllmnrd
         ~rtnetlink_interface_manager() override;
 
 
+        /**
+         * Sets the policy that selects interfaces.
+         *
+         * This function must be called before the first refresh.
+         * Interfaces not allowed by the policy are never enabled, and their
+         * addresses are ignored.
+         */
+        void set_interface_policy(const interface_policy &policy)
+        {
+            _policy = policy;
+        }
+
+        /**
+         * Sets the window in which link state notifications are coalesced.
+         *
+         * A link that goes up or down is enabled or disabled only when no
+         * other notification has changed its state for the window, and
+         * only if its state then differs from the current one, so that a
+         * flap makes no change.  Address changes are applied at once.  A
+         * zero window disables coalescing.  This function must be called
+         * before the first refresh.
+         */
+        void set_coalescing_window(std::chrono::milliseconds window)
+        {
+            _coalescing_window = window;
+        }
+
+        /**
+         * Sets whether the manager is driven by an external event loop
+         * instead of its own worker thread.
+         *
+         * The event loop shall poll the descriptors given by
+         * 'get_poll_descriptors' and pass them to 'process_poll' after each
+         * poll, even if nothing is ready.  A synchronous refresh drives the
+         * manager on the calling thread, which must be the thread of the
+         * event loop.  This function must be called before the first
+         * refresh.
+         */
+        void set_externally_driven(bool externally_driven)
+        {
+            _externally_driven = externally_driven;
+        }
+
+        /**
+         * Gets the descriptors to poll for an external event loop.
+         *
+         * @param fds an array of at least 'MAX_POLL_DESCRIPTORS' elements
+         * @param timeout [out] the timeout in milliseconds, or -1 for none
+         * @return the number of descriptors
+         */
+        size_t get_poll_descriptors(pollfd *fds, int &timeout) const;
+
+        /**
+         * Processes the descriptors polled for an external event loop.
+         *
+         * Errors are logged and not thrown.
+         */
+        void process_poll(const pollfd *fds, size_t count);
+
         void refresh(bool maybe_asynchronous = false) override;
 
+        /// Returns the number of times the RTNETLINK socket overflowed.
+        std::uint64_t overflow_count() const
+        {
+            return _overflow_count;
+        }
+
+        /// Returns the number of refreshes made to recover from overflows.
+        std::uint64_t resync_count() const
+        {
+            return _resync_count;
+        }
+
     protected:
 
         /**
          * Begins a refresh task if not running.
+         *
+         * This function is called by the worker thread.
          */
         void begin_refresh();
 
+        /**
+         * Begins a refresh task if requested by 'refresh' and not running.
+         *
+         * This function is called by the worker thread.
+         */
+        void begin_requested_refresh();
+
+        /**
+         * Wakes the worker thread by a request whose acknowledgment arrives
+         * on the RTNETLINK socket for notifications.
+         *
+         * This function is thread-safe.
+         */
+        void wake_worker();
+
         /**
          * Ends the current refresh task if running.
          */
         void end_refresh();
 
         /**
-         * Starts a worker thread that monitors interface changes.
+         * Recovers from lost notifications by a refresh, which is deferred
+         * until the end of the current one if running.
+         *
+         * This function is called by the worker thread.
+         */
+        void resync();
+
+        /**
+         * Abandons the refresh in progress and starts it over, as a dump
+         * message has been lost.
+         *
+         * The sockets of the dumps in progress are reopened to discard the
+         * rest of the dumps.  Waiters for the refresh keep waiting until
+         * the new one is done.  This function is called by the worker
+         * thread.
+         */
+        void restart_refresh();
+
+        /**
+         * Starts a worker thread that monitors interface changes and waits
+         * for it to be running.
          *
          * This function is thread-safe.
          */
@@ -132,20 +398,140 @@ namespace xllmnrd
 
         void request_ifinfos() const;
 
-        void request_ifaddrs() const;
+        /**
+         * Requests a dump of addresses.
+         *
+         * @param rtnetlink a RTNETLINK socket
+         * @param interface_index an interface index to filter the dump, or
+         * zero for all, which is effective only with strict checking
+         */
+        void request_ifaddrs(int rtnetlink, unsigned int interface_index)
+            const;
+
+        /**
+         * Reallocates the buffer for RTNETLINK messages if it is smaller
+         * than a size.
+         *
+         * The size is rounded up to a multiple of the page size.
+         */
+        void reserve_buffer(size_t size);
 
         /// Processes NETLINK messages.
         void process_messages();
 
-    private:
+        /// Processes NETLINK messages of the address dump.
+        void process_dump_messages();
+
+        /**
+         * Waits for NETLINK messages until the first deadline of pending
+         * link states and applies those due.
+         *
+         * @return bits of the sockets that have messages available
+         */
+        unsigned int wait_messages();
+
+        /**
+         * Returns the bits of the sockets ready in polled descriptors and
+         * applies the pending link states due.
+         */
+        unsigned int check_poll(const pollfd *fds, size_t count);
+
+        /// Processes NETLINK messages on the ready sockets.
+        void process_ready(unsigned int ready);
 
-        /// Dispatches NETLINK messages.
+        /**
+         * Defers a link state to the end of a coalescing window, or applies
+         * it at once if coalescing is disabled.
+         */
+        void set_link_state(unsigned int interface_index, bool enabled);
+
+        /// Applies the pending link states whose windows have ended.
+        void apply_pending_links();
+
+        /// Discards all the pending link states.
+        void clear_pending_links();
+
+        /**
+         * Dispatches NETLINK messages.
+         *
+         * Messages outside a refresh are handled as notifications.
+         */
         void dispatch_messages(const void *messages, size_t size);
 
-        /// Handles a NETLINK error message.
-        void handle_nlmsgerr(const nlmsghdr *nlmsg) const;
+    private:
+
+        /**
+         * Stages the interfaces if ready and requests both of the dumps.
+         *
+         * This function must be called by the worker thread with the
+         * refresh mutex locked.
+         */
+        void request_dumps();
+
+        /**
+         * Replaces a RTNETLINK socket with a new one, which discards any
+         * messages pending on it.
+         *
+         * This function must be called with the refresh mutex locked.
+         *
+         * @return true if strict checking is enabled on the new socket
+         */
+        bool reopen_rtnetlink(int &rtnetlink, std::uint32_t groups);
+
+        /// Dispatches NETLINK messages of the address dump.
+        void dispatch_dump_messages(const void *messages, size_t size);
+
+        /**
+         * Replays the journaled notifications.
+         *
+         * @param coalesced true if state changes of links shall be
+         * coalesced as notifications
+         */
+        void replay_journal(bool coalesced);
+
+        /**
+         * Requests the dump of the addresses of the first link queued for
+         * that if the socket for address dumps is free.
+         *
+         * This is used when a link excluded by the policy becomes allowed,
+         * as its addresses have been ignored.  The dump is processed as the
+         * socket is polled, with the notifications journaled meanwhile.
+         */
+        void refresh_queued_addresses();
+
+        /**
+         * Discards the links queued for address dumps and abandons the one
+         * in progress, as a refresh dumps the addresses of all the links.
+         */
+        void cancel_address_refreshes();
+
+        /// Commits the refresh if both of the dumps are done.
+        void commit_refresh();
+
+        /**
+         * Handles a NETLINK error message.
+         *
+         * @return true if it reports an error, or false if it is an
+         * acknowledgment
+         */
+        bool handle_nlmsgerr(const nlmsghdr *nlmsg) const;
 
-        void handle_ifinfomsg(const nlmsghdr *nlmsg);
+        /**
+         * Handles a RTNETLINK message for a link.
+         *
+         * @param coalesced true if a state change of the link shall be
+         * coalesced in a window
+         */
+        void handle_ifinfomsg(const nlmsghdr *nlmsg, bool coalesced = false);
+
+        /**
+         * Returns true if a link is allowed by the policy.
+         *
+         * The policy is evaluated only if the name or kind of the link is
+         * changed.
+         */
+        bool link_allowed(unsigned int interface_index, const std::string &name,
+            const std::string &kind);
 
         // Handles a RTNETLINK message for an interface address change.
         void handle_ifaddrmsg(const nlmsghdr *nlmsg);
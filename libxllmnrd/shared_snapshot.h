@@ -0,0 +1,139 @@
+// shared_snapshot.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef SHARED_SNAPSHOT_H
+#define SHARED_SNAPSHOT_H 1
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    /**
+     * Immutable snapshot published to readers on any thread.
+     *
+     * The atomic functions for 'std::shared_ptr' take a mutex from a pool
+     * in libstdc++, so readers would wait for one another and for writers.
+     * Each thread instead caches the last snapshot it loaded together with
+     * the version counter at that time, and loads the pointer again only if
+     * the counter has changed since.  A reader that finds its cache valid
+     * does a single atomic load of the counter.
+     *
+     * The cache of a thread has 'CACHE_SIZE' entries for each type and is
+     * indexed by a unique identifier of the object, so a thread that reads
+     * more objects of a type may load their pointers more often.  A cached
+     * snapshot is kept alive until the entry is reused or the thread exits.
+     */
+    template<class T>
+    class shared_snapshot
+    {
+    public:
+
+        /// Number of objects whose snapshots each thread caches for a type.
+        static constexpr std::size_t CACHE_SIZE = 8;
+
+    private:
+
+        struct cache_entry
+        {
+            /// Identifier of the object, or zero if unused.
+            std::uint64_t owner = 0;
+
+            /// Version of the object when the snapshot was loaded.
+            std::uint64_t version = 0;
+
+            std::shared_ptr<const T> snapshot;
+        };
+
+        /// Returns the cache of the calling thread.
+        static std::array<cache_entry, CACHE_SIZE> &cache()
+        {
+            static thread_local std::array<cache_entry, CACHE_SIZE> entries;
+            return entries;
+        }
+
+        /// Returns a new identifier, which is never reused.
+        static std::uint64_t next_id()
+        {
+            static std::atomic<std::uint64_t> last_id {0};
+            return ++last_id;
+        }
+
+        const std::uint64_t _id = next_id();
+
+        /// Last published snapshot, which is accessed only by the atomic
+        /// functions.
+        std::shared_ptr<const T> _snapshot;
+
+        /// Version counter, which is incremented after each store.
+        std::atomic<std::uint64_t> _version {1};
+
+    public:
+
+        explicit shared_snapshot(
+            std::shared_ptr<const T> snapshot = std::make_shared<const T>())
+        :
+            _snapshot {std::move(snapshot)}
+        {
+            // Nothing to do.
+        }
+
+        // This class is not copy-constructible.
+        shared_snapshot(const shared_snapshot &) = delete;
+
+
+        // This class is not copy-assignable.
+        void operator =(const shared_snapshot &) = delete;
+
+
+        /**
+         * Returns the last published snapshot.
+         *
+         * This function is thread-safe.
+         */
+        std::shared_ptr<const T> load() const
+        {
+            auto &&version = _version.load(std::memory_order_acquire);
+            auto &&entry = cache()[_id % CACHE_SIZE];
+            if (entry.owner != _id || entry.version != version) {
+                // The snapshot loaded is at least as new as the version.
+                entry.snapshot = std::atomic_load(&_snapshot);
+                entry.owner = _id;
+                entry.version = version;
+            }
+            return entry.snapshot;
+        }
+
+        /**
+         * Publishes a snapshot.
+         *
+         * This function is thread-safe.
+         */
+        void store(std::shared_ptr<const T> snapshot)
+        {
+            std::atomic_store(&_snapshot, std::move(snapshot));
+            _version.fetch_add(1, std::memory_order_release);
+        }
+    };
+}
+
+#endif
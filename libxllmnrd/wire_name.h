@@ -0,0 +1,94 @@
+// wire_name.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This header defines helper functions for names in the wire format.
+
+#ifndef WIRE_NAME_H
+#define WIRE_NAME_H 1
+
+#include "ascii.h"
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <cstddef>
+
+namespace xllmnrd
+{
+    /**
+     * Hashes a name in the wire format case-insensitively.
+     *
+     * @param name a name in the wire format
+     * @param length [out] the length of the name including the terminator,
+     * or zero if the name is compressed
+     */
+    inline std::uint32_t hash_wire_name(const std::uint8_t *const name,
+        std::size_t &length)
+    {
+        // This is the 32-bit FNV-1a hash.
+        std::uint32_t hash = 2166136261U;
+        auto i = name;
+        std::size_t label_length = 0;
+        do {
+            label_length = *i;
+            if (label_length > 63) {
+                length = 0;
+                return hash;
+            }
+            for (std::size_t j = 0; j <= label_length; ++j) {
+                hash = (hash ^ ascii_tolower(*i++)) * 16777619U;
+            }
+        }
+        while (label_length != 0);
+
+        length = i - name;
+        return hash;
+    }
+
+    /**
+     * Converts a dotted name into the wire format in lowercase.
+     *
+     * @return true if the name is valid, or false.
+     */
+    inline bool to_wire_name(const char *first, const char *const last,
+        std::vector<std::uint8_t> &name)
+    {
+        name.clear();
+        while (first != last) {
+            auto &&dot = std::find(first, last, '.');
+            auto &&length = dot - first;
+            if (length == 0 || length > 63) {
+                return false;
+            }
+
+            name.push_back(static_cast<std::uint8_t>(length));
+            std::transform(first, dot, std::back_inserter(name),
+                [](char c) {return ascii_tolower(c);});
+
+            first = dot;
+            if (first != last) {
+                // Skips the dot, which may end the name.
+                ++first;
+            }
+        }
+        name.push_back(0);
+        return name.size() > 1 && name.size() <= 255;
+    }
+}
+
+#endif
@@ -0,0 +1,458 @@
+// zone.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "zone.h"
+
+#include "wire_name.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+using std::equal;
+using std::generic_category;
+using std::invalid_argument;
+using std::memcmp;
+using std::shared_ptr;
+using std::stable_sort;
+using std::string;
+using std::strtoul;
+using std::system_error;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::vector;
+using namespace xllmnrd;
+
+// Record type constants.
+static const uint16_t TYPE_A = 1;
+static const uint16_t TYPE_PTR = 12;
+static const uint16_t TYPE_TXT = 16;
+static const uint16_t TYPE_AAAA = 28;
+static const uint16_t TYPE_SRV = 33;
+static const uint16_t TYPE_ANY = 255;
+
+static const uint16_t CLASS_IN = 1;
+
+static const uint32_t DEFAULT_TIME_TO_LIVE = 30;
+
+/*
+ * Combines a name hash with a record type.
+ */
+inline uint32_t entry_hash(const uint32_t name_hash, const unsigned int type)
+{
+    return name_hash ^ (type * 0x9e3779b1U);
+}
+
+inline void put_uint16(vector<uint8_t> &v, const unsigned int x)
+{
+    v.push_back(uint8_t(x >> 8));
+    v.push_back(uint8_t(x));
+}
+
+inline void put_uint32(vector<uint8_t> &v, const uint32_t x)
+{
+    put_uint16(v, x >> 16);
+    put_uint16(v, x);
+}
+
+/*
+ * Splits a line of zone text into tokens.
+ *
+ * Double-quoted strings are kept as single tokens without the quotes.
+ */
+static vector<string> split_tokens(const string &line)
+{
+    auto &&tokens = vector<string>();
+
+    auto i = line.begin();
+    while (i != line.end()) {
+        if (*i == ' ' || *i == '\t' || *i == '\r') {
+            ++i;
+        }
+        else if (*i == '#') {
+            break;
+        }
+        else if (*i == '"') {
+            auto &&token = string();
+            ++i;
+            while (i != line.end() && *i != '"') {
+                if (*i == '\\' && i + 1 != line.end()) {
+                    ++i;
+                }
+                token.push_back(*i++);
+            }
+            if (i == line.end()) {
+                throw invalid_argument("unterminated string");
+            }
+            ++i;
+            tokens.push_back(token);
+        }
+        else {
+            auto &&token = string();
+            while (i != line.end() && *i != ' ' && *i != '\t' && *i != '\r'
+                && *i != '#') {
+                token.push_back(*i++);
+            }
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+/*
+ * Parses an unsigned decimal number.
+ */
+static unsigned long parse_number(const string &s, const unsigned long max)
+{
+    char *end = nullptr;
+    auto &&value = strtoul(s.c_str(), &end, 10);
+    if (s.empty() || *end != '\0' || value > max) {
+        throw invalid_argument("invalid number '" + s + "'");
+    }
+    return value;
+}
+
+/*
+ * Appends a dotted name in the wire format.
+ */
+static void put_name(vector<uint8_t> &v, const string &s)
+{
+    auto &&name = vector<uint8_t>();
+    if (!to_wire_name(s.data(), s.data() + s.size(), name)) {
+        throw invalid_argument("invalid name '" + s + "'");
+    }
+    v.insert(v.end(), name.begin(), name.end());
+}
+
+
+// Implementation of class 'zone_compiler'
+
+void zone_compiler::add_line(const string &line)
+{
+    auto &&tokens = split_tokens(line);
+    if (tokens.empty()) {
+        return;
+    }
+
+    auto r = record {};
+    auto &&name = tokens[0];
+    if (!to_wire_name(name.data(), name.data() + name.size(), r.name)) {
+        throw invalid_argument("invalid name '" + name + "'");
+    }
+
+    size_t i = 1;
+    uint32_t ttl = DEFAULT_TIME_TO_LIVE;
+    if (i < tokens.size() && !tokens[i].empty()
+        && tokens[i][0] >= '0' && tokens[i][0] <= '9') {
+        ttl = parse_number(tokens[i++], 0x7fffffffU);
+    }
+    if (i < tokens.size() && tokens[i] == "IN") {
+        ++i;
+    }
+    if (i == tokens.size()) {
+        throw invalid_argument("missing type");
+    }
+
+    auto &&type = tokens[i++];
+    auto &&rdata = vector<uint8_t>();
+    auto &&arguments = tokens.size() - i;
+    if (type == "A" && arguments == 1) {
+        r.type = TYPE_A;
+        in_addr in {};
+        if (inet_pton(AF_INET, tokens[i].c_str(), &in) != 1) {
+            throw invalid_argument("invalid address '" + tokens[i] + "'");
+        }
+        auto &&bytes = reinterpret_cast<const uint8_t *>(&in);
+        rdata.assign(bytes, bytes + sizeof in);
+    }
+    else if (type == "AAAA" && arguments == 1) {
+        r.type = TYPE_AAAA;
+        in6_addr in6 {};
+        if (inet_pton(AF_INET6, tokens[i].c_str(), &in6) != 1) {
+            throw invalid_argument("invalid address '" + tokens[i] + "'");
+        }
+        auto &&bytes = reinterpret_cast<const uint8_t *>(&in6);
+        rdata.assign(bytes, bytes + sizeof in6);
+    }
+    else if (type == "PTR" && arguments == 1) {
+        r.type = TYPE_PTR;
+        put_name(rdata, tokens[i]);
+    }
+    else if (type == "SRV" && arguments == 4) {
+        r.type = TYPE_SRV;
+        put_uint16(rdata, parse_number(tokens[i], 0xffff));
+        put_uint16(rdata, parse_number(tokens[i + 1], 0xffff));
+        put_uint16(rdata, parse_number(tokens[i + 2], 0xffff));
+        put_name(rdata, tokens[i + 3]);
+    }
+    else if (type == "TXT" && arguments >= 1) {
+        r.type = TYPE_TXT;
+        for (; i != tokens.size(); ++i) {
+            if (tokens[i].size() > 255) {
+                throw invalid_argument("too long string");
+            }
+            rdata.push_back(uint8_t(tokens[i].size()));
+            rdata.insert(rdata.end(), tokens[i].begin(), tokens[i].end());
+        }
+    }
+    else {
+        throw invalid_argument("invalid record of type '" + type + "'");
+    }
+    if (rdata.size() > 0xffff) {
+        throw invalid_argument("too long record");
+    }
+
+    // The owner name is a pointer to the question.
+    put_uint16(r.data, 0xc000U + 12);
+    put_uint16(r.data, r.type);
+    put_uint16(r.data, CLASS_IN);
+    put_uint32(r.data, ttl);
+    put_uint16(r.data, rdata.size());
+    r.data.insert(r.data.end(), rdata.begin(), rdata.end());
+
+    _records.push_back(r);
+}
+
+auto zone_compiler::compile() const -> vector<uint8_t>
+{
+    // Sorts the records by name and type so that each entry has a
+    // contiguous range of records.
+    auto &&sorted = vector<const record *>();
+    for (auto &&i : _records) {
+        sorted.push_back(&i);
+    }
+    stable_sort(sorted.begin(), sorted.end(),
+        [](const record *x, const record *y) {
+            if (x->name != y->name) {
+                return x->name < y->name;
+            }
+            return x->type < y->type;
+        });
+
+    auto &&entries = vector<zone_entry>();
+    auto &&data = vector<uint8_t>();
+    auto i = sorted.begin();
+    while (i != sorted.end()) {
+        auto &&name = (*i)->name;
+        size_t length = 0;
+        auto &&name_hash = hash_wire_name(name.data(), length);
+
+        auto any = zone_entry {};
+        any.hash = entry_hash(name_hash, TYPE_ANY);
+        any.type = TYPE_ANY;
+        any.name_offset = uint32_t(data.size());
+        data.insert(data.end(), name.begin(), name.end());
+        any.records_offset = uint32_t(data.size());
+
+        while (i != sorted.end() && (*i)->name == name) {
+            auto e = zone_entry {};
+            e.hash = entry_hash(name_hash, (*i)->type);
+            e.type = (*i)->type;
+            e.name_offset = any.name_offset;
+            e.records_offset = uint32_t(data.size());
+            for (auto &&type = (*i)->type;
+                i != sorted.end() && (*i)->name == name && (*i)->type == type;
+                ++i) {
+                data.insert(data.end(), (*i)->data.begin(), (*i)->data.end());
+                e.record_count += 1;
+                any.record_count += 1;
+            }
+            e.records_size = uint32_t(data.size() - e.records_offset);
+            entries.push_back(e);
+        }
+
+        any.records_size = uint32_t(data.size() - any.records_offset);
+        entries.push_back(any);
+    }
+
+    uint32_t bucket_count = 1;
+    while (bucket_count < 2 * entries.size()) {
+        bucket_count *= 2;
+    }
+    auto &&buckets = vector<uint32_t>(bucket_count);
+    for (size_t j = 0; j != entries.size(); ++j) {
+        auto &&k = entries[j].hash & (bucket_count - 1);
+        while (buckets[k] != 0) {
+            k = (k + 1) & (bucket_count - 1);
+        }
+        buckets[k] = uint32_t(j + 1);
+    }
+
+    auto &&image = vector<uint8_t>();
+    image.insert(image.end(), ZONE_MAGIC, ZONE_MAGIC + 4);
+    put_uint32(image, entries.size());
+    put_uint32(image, bucket_count);
+    put_uint32(image, data.size());
+    for (auto &&e : entries) {
+        put_uint32(image, e.hash);
+        put_uint16(image, e.type);
+        put_uint16(image, e.record_count);
+        put_uint32(image, e.name_offset);
+        put_uint32(image, e.records_offset);
+        put_uint32(image, e.records_size);
+    }
+    for (auto &&b : buckets) {
+        put_uint32(image, b);
+    }
+    image.insert(image.end(), data.begin(), data.end());
+    return image;
+}
+
+
+// Implementation of class 'zone_file'
+
+zone_file::zone_file(const void *const image, const size_t size)
+{
+    set_image(image, size);
+}
+
+zone_file::~zone_file()
+{
+    if (_mapped) {
+        munmap(const_cast<uint8_t *>(_image), _size);
+    }
+}
+
+shared_ptr<const zone_file> zone_file::open(const char *const file_name)
+{
+    int fd = ::open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw system_error(errno, generic_category(),
+            string("could not open ") + file_name);
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) == -1) {
+        auto &&error = errno;
+        close(fd);
+        throw system_error(error, generic_category(),
+            string("could not stat ") + file_name);
+    }
+
+    auto &&size = size_t(st.st_size);
+    auto &&image = size == 0 ? MAP_FAILED
+        : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    auto &&error = size == 0 ? EINVAL : errno;
+    close(fd);
+    if (image == MAP_FAILED) {
+        throw system_error(error, generic_category(),
+            string("could not map ") + file_name);
+    }
+
+    auto &&zone = shared_ptr<zone_file>(new zone_file());
+    zone->_image = static_cast<const uint8_t *>(image);
+    zone->_size = size;
+    zone->_mapped = true;
+    zone->set_image(image, size);
+    return zone;
+}
+
+void zone_file::set_image(const void *const image, const size_t size)
+{
+    auto &&bytes = static_cast<const uint8_t *>(image);
+    if (size < sizeof (zone_header)) {
+        throw invalid_argument("short zone image");
+    }
+
+    auto &&header = static_cast<const zone_header *>(image);
+    if (memcmp(header->magic, ZONE_MAGIC, 4) != 0) {
+        throw invalid_argument("bad zone magic");
+    }
+
+    auto &&entry_count = size_t(ntohl(header->entry_count));
+    auto &&bucket_count = size_t(ntohl(header->bucket_count));
+    auto &&data_size = size_t(ntohl(header->data_size));
+    if ((bucket_count & (bucket_count - 1)) != 0
+        || bucket_count < entry_count
+        || size != sizeof (zone_header) + entry_count * sizeof (zone_entry)
+            + bucket_count * 4 + data_size) {
+        throw invalid_argument("bad zone size");
+    }
+
+    _image = bytes;
+    _size = size;
+    _entries = reinterpret_cast<const zone_entry *>(bytes
+        + sizeof (zone_header));
+    _entry_count = uint32_t(entry_count);
+    _buckets = reinterpret_cast<const uint32_t *>(_entries + entry_count);
+    _bucket_count = uint32_t(bucket_count);
+    _data = reinterpret_cast<const uint8_t *>(_buckets + bucket_count);
+    _data_size = data_size;
+
+    // Entries are checked when they are found so that opening a zone file
+    // takes constant time.
+}
+
+auto zone_file::find(const uint8_t *const qname, const unsigned int type) const
+    -> records
+{
+    if (_bucket_count == 0) {
+        return {};
+    }
+
+    size_t length = 0;
+    auto &&hash = entry_hash(hash_wire_name(qname, length), type);
+    if (length == 0) {
+        return {};
+    }
+
+    auto &&mask = _bucket_count - 1;
+    auto &&i = hash & mask;
+    // The buckets cannot be full as the compiler keeps the load below 1/2,
+    // but the probe count is bounded anyway for unchecked images.
+    for (uint32_t n = 0; n != _bucket_count && _buckets[i] != 0; ++n) {
+        auto &&index = ntohl(_buckets[i]);
+        if (index > _entry_count) {
+            break;
+        }
+
+        auto &&e = _entries[index - 1];
+        if (ntohl(e.hash) == hash && ntohs(e.type) == type) {
+            auto &&name_offset = size_t(ntohl(e.name_offset));
+            auto &&records_offset = size_t(ntohl(e.records_offset));
+            auto &&records_size = size_t(ntohl(e.records_size));
+            if (name_offset > _data_size
+                || length > _data_size - name_offset
+                || records_offset > _data_size
+                || records_size > _data_size - records_offset) {
+                break;
+            }
+
+            auto &&name = _data + name_offset;
+            if (equal(qname, qname + length, name,
+                [](uint8_t x, uint8_t y) {return ascii_tolower(x) == y;})) {
+                return {_data + records_offset, records_size,
+                    ntohs(e.record_count)};
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return {};
+}
@@ -0,0 +1,197 @@
+// zone.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef ZONE_H
+#define ZONE_H 1
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Binary zone files are laid out as follows, with all integers in network
+// byte order:
+//
+//   header   - 'zone_header'
+//   entries  - 'zone_entry' x entry_count
+//   buckets  - uint32 x bucket_count, entry index plus one or zero if empty
+//   data     - names in the wire format and pre-serialized records
+//
+// Each record is serialized as an answer whose owner name is a compression
+// pointer to the question at offset 12, so that a response can be made by
+// copying the records after the question.
+
+namespace xllmnrd
+{
+    using std::size_t;
+
+    /// Magic number of binary zone files.
+    constexpr char ZONE_MAGIC[4] = {'X', 'L', 'Z', '1'};
+
+    /// Header of binary zone files.
+    struct zone_header
+    {
+        char magic[4];
+        std::uint32_t entry_count;
+        std::uint32_t bucket_count;
+        std::uint32_t data_size;
+    };
+
+    /// Index entry of binary zone files.
+    struct zone_entry
+    {
+        std::uint32_t hash;
+        std::uint16_t type;
+        std::uint16_t record_count;
+        std::uint32_t name_offset;
+        std::uint32_t records_offset;
+        std::uint32_t records_size;
+    };
+
+    /**
+     * Compiler of zone text into the binary zone format.
+     *
+     * Each line of zone text has the form 'NAME [TTL] [IN] TYPE RDATA...',
+     * where TYPE is one of 'A', 'AAAA', 'PTR', 'SRV' and 'TXT'.  Text after
+     * '#' is ignored.
+     */
+    class zone_compiler
+    {
+    private:
+
+        struct record
+        {
+            std::vector<std::uint8_t> name;
+            std::uint16_t type;
+            std::vector<std::uint8_t> data;
+        };
+
+        std::vector<record> _records;
+
+    public:
+
+        /**
+         * Adds a line of zone text.
+         *
+         * @exception std::invalid_argument if the line is invalid
+         */
+        void add_line(const std::string &line);
+
+        /// Returns the number of records added.
+        size_t size() const
+        {
+            return _records.size();
+        }
+
+        /**
+         * Returns the binary zone image for the records added.
+         */
+        std::vector<std::uint8_t> compile() const;
+    };
+
+    /**
+     * Read-only binary zone file mapped into memory.
+     */
+    class zone_file
+    {
+    public:
+
+        /// Pre-serialized records found in a zone file.
+        struct records
+        {
+            const std::uint8_t *data = nullptr;
+            size_t size = 0;
+            unsigned int count = 0;
+        };
+
+    private:
+
+        const std::uint8_t *_image = nullptr;
+
+        size_t _size = 0;
+
+        /// True if the image is mapped from a file.
+        bool _mapped = false;
+
+        const zone_entry *_entries = nullptr;
+
+        std::uint32_t _entry_count = 0;
+
+        const std::uint32_t *_buckets = nullptr;
+
+        std::uint32_t _bucket_count = 0;
+
+        const std::uint8_t *_data = nullptr;
+
+        size_t _data_size = 0;
+
+    public:
+
+        /**
+         * Constructs a zone object over an image in memory.
+         *
+         * The image must outlive the object.
+         *
+         * @exception std::invalid_argument if the image is invalid
+         */
+        zone_file(const void *image, size_t size);
+
+        // This class is not copy-constructible.
+        zone_file(const zone_file &) = delete;
+
+        ~zone_file();
+
+
+        // This class is not copy-assignable.
+        void operator =(const zone_file &) = delete;
+
+
+        /**
+         * Maps a binary zone file into memory.
+         *
+         * @param file_name name of a binary zone file
+         */
+        [[nodiscard]]
+        static std::shared_ptr<const zone_file> open(const char *file_name);
+
+        /// Returns the number of index entries.
+        size_t size() const
+        {
+            return _entry_count;
+        }
+
+        /**
+         * Finds records of a type for a name.
+         *
+         * @param qname a name in the wire format, which must already be
+         * validated
+         * @param type a record type, or 255 for any type
+         */
+        records find(const std::uint8_t *qname, unsigned int type) const;
+
+    protected:
+
+        zone_file() = default;
+
+        /// Validates an image and sets up the pointers into it.
+        void set_image(const void *image, size_t size);
+    };
+}
+
+#endif
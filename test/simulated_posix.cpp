@@ -0,0 +1,729 @@
+// simulated_posix.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "simulated_posix.h"
+
+#include <linux/rtnetlink.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::logic_error;
+using std::max;
+using std::memcpy;
+using std::min;
+using std::move;
+using std::size_t;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::vector;
+
+/// Maximum size of a datagram in a dump.
+static const size_t DUMP_PACKET_SIZE = 4096;
+
+/// Size of the IPv6 and UDP headers.
+static const size_t IPV6_UDP_OVERHEAD = 48;
+
+/*
+ * Appends an RTNETLINK attribute to a message.
+ */
+static void append_attribute(vector<uint8_t> &message, const uint16_t type,
+    const void *const data, const size_t size)
+{
+    auto &&offset = NLMSG_ALIGN(message.size());
+    message.resize(offset + RTA_SPACE(size));
+
+    auto &&rta = reinterpret_cast<rtattr *>(&message[offset]);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(size);
+    memcpy(RTA_DATA(rta), data, size);
+}
+
+/*
+ * Returns a new message with a header and a fixed part.
+ */
+template<class T>
+static vector<uint8_t> make_message(const uint16_t type, const uint16_t flags,
+    const uint32_t sequence, const T &body)
+{
+    auto &&message = vector<uint8_t>(NLMSG_SPACE(sizeof body));
+    auto &&nlmsg = reinterpret_cast<nlmsghdr *>(message.data());
+    nlmsg->nlmsg_type = type;
+    nlmsg->nlmsg_flags = flags;
+    nlmsg->nlmsg_seq = sequence;
+    memcpy(NLMSG_DATA(nlmsg), &body, sizeof body);
+    return message;
+}
+
+/*
+ * Sets the length of a message after its attributes are appended.
+ */
+static void finish_message(vector<uint8_t> &message)
+{
+    message.resize(NLMSG_ALIGN(message.size()));
+    reinterpret_cast<nlmsghdr *>(message.data())->nlmsg_len = message.size();
+}
+
+void simulated_posix::schedule(const clock::duration delay,
+    std::function<void ()> event)
+{
+    _events.emplace(_now + delay, move(event));
+}
+
+void simulated_posix::advance(const clock::duration duration)
+{
+    auto &&end = _now + duration;
+    while (!_events.empty() && _events.begin()->first <= end) {
+        _now = max(_now, _events.begin()->first);
+        run_events();
+    }
+    _now = end;
+}
+
+void simulated_posix::run_events()
+{
+    while (!_events.empty() && _events.begin()->first <= _now) {
+        auto event = move(_events.begin()->second);
+        _events.erase(_events.begin());
+        event();
+    }
+}
+
+unsigned int simulated_posix::add_link(const std::string &name,
+    const unsigned int mtu, const unsigned int flags)
+{
+    auto &&index = _next_index++;
+    _links[index] = {name, mtu, flags, {}, {}};
+    notify(RTMGRP_LINK, link_message(RTM_NEWLINK, 0, 0, index));
+    return index;
+}
+
+void simulated_posix::set_link_flags(const unsigned int index,
+    const unsigned int flags)
+{
+    auto &&found = _links.find(index);
+    if (found != _links.end()) {
+        found->second.flags = flags;
+        notify(RTMGRP_LINK, link_message(RTM_NEWLINK, 0, 0, index));
+    }
+}
+
+void simulated_posix::set_link_name(const unsigned int index,
+    const std::string &name)
+{
+    auto &&found = _links.find(index);
+    if (found != _links.end()) {
+        found->second.name = name;
+        notify(RTMGRP_LINK, link_message(RTM_NEWLINK, 0, 0, index));
+    }
+}
+
+void simulated_posix::remove_link(const unsigned int index)
+{
+    auto &&found = _links.find(index);
+    if (found == _links.end()) {
+        return;
+    }
+
+    // The kernel removes the addresses first.
+    for (auto &&i : found->second.in_addresses) {
+        notify(RTMGRP_IPV4_IFADDR, address_message(RTM_DELADDR, 0, 0, index,
+            AF_INET, &i, sizeof i));
+    }
+    for (auto &&i : found->second.in6_addresses) {
+        notify(RTMGRP_IPV6_IFADDR, address_message(RTM_DELADDR, 0, 0, index,
+            AF_INET6, &i, sizeof i));
+    }
+    notify(RTMGRP_LINK, link_message(RTM_DELLINK, 0, 0, index));
+    _links.erase(found);
+
+    for (auto &&i : _sockets) {
+        i.second.memberships.erase(index);
+    }
+}
+
+void simulated_posix::add_address(const unsigned int index,
+    const in_addr &address)
+{
+    auto &&found = _links.find(index);
+    if (found != _links.end()) {
+        found->second.in_addresses.push_back(address);
+        notify(RTMGRP_IPV4_IFADDR, address_message(RTM_NEWADDR, 0, 0, index,
+            AF_INET, &address, sizeof address));
+    }
+}
+
+void simulated_posix::add_address(const unsigned int index,
+    const in6_addr &address)
+{
+    auto &&found = _links.find(index);
+    if (found != _links.end()) {
+        found->second.in6_addresses.push_back(address);
+        notify(RTMGRP_IPV6_IFADDR, address_message(RTM_NEWADDR, 0, 0, index,
+            AF_INET6, &address, sizeof address));
+    }
+}
+
+void simulated_posix::remove_address(const unsigned int index,
+    const in6_addr &address)
+{
+    auto &&found = _links.find(index);
+    if (found == _links.end()) {
+        return;
+    }
+
+    auto &&addresses = found->second.in6_addresses;
+    auto &&i = find_if(addresses.begin(), addresses.end(),
+        [&address](const in6_addr &x) {
+            return IN6_ARE_ADDR_EQUAL(&x, &address);
+        });
+    if (i != addresses.end()) {
+        addresses.erase(i);
+        notify(RTMGRP_IPV6_IFADDR, address_message(RTM_DELADDR, 0, 0, index,
+            AF_INET6, &address, sizeof address));
+    }
+}
+
+size_t simulated_posix::deliver(const unsigned int index,
+    const sockaddr_in6 &sender, const in6_addr &destination,
+    const in_port_t port, const vector<uint8_t> &data)
+{
+    if (_links.find(index) == _links.end()) {
+        return 0;
+    }
+    if (IN6_IS_ADDR_MULTICAST(&destination) && membership_count(index) == 0) {
+        return 0;
+    }
+
+    auto from = sender;
+    if (IN6_IS_ADDR_LINKLOCAL(&from.sin6_addr)) {
+        from.sin6_scope_id = index;
+    }
+
+    size_t count = 0;
+    for (auto &&i : _sockets) {
+        if (i.second.domain == PF_INET6 && i.second.port == port) {
+            i.second.queue.push_back({_now, index, from, destination, data});
+            count += 1;
+        }
+    }
+    return count;
+}
+
+size_t simulated_posix::membership_count(const unsigned int index) const
+{
+    size_t count = 0;
+    for (auto &&i : _sockets) {
+        count += i.second.memberships.count(index);
+    }
+    return count;
+}
+
+int simulated_posix::socket(const int domain, const int type,
+    const int protocol)
+{
+    _statistics.socket_calls += 1;
+
+    auto &&base_type = type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if ((domain != PF_NETLINK || protocol != NETLINK_ROUTE)
+        && (domain != PF_INET6 || base_type != SOCK_DGRAM)) {
+        errno = EAFNOSUPPORT;
+        return -1;
+    }
+
+    auto &&fd = _next_fd++;
+    _sockets[fd].domain = domain;
+    _sockets[fd].nonblocking = (type & SOCK_NONBLOCK) != 0;
+    return fd;
+}
+
+int simulated_posix::bind(const int socket, const sockaddr *const address,
+    const socklen_t address_len)
+{
+    auto &&s = find_socket(socket);
+    if (s == nullptr) {
+        return -1;
+    }
+
+    if (s->domain == PF_NETLINK && address_len >= sizeof (sockaddr_nl)) {
+        s->groups = reinterpret_cast<const sockaddr_nl *>(address)->nl_groups;
+    }
+    else if (s->domain == PF_INET6 && address_len >= sizeof (sockaddr_in6)) {
+        s->port = reinterpret_cast<const sockaddr_in6 *>(address)->sin6_port;
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int simulated_posix::setsockopt(const int socket, const int level,
+    const int option_name, const void *const option_value,
+    const socklen_t option_len)
+{
+    auto &&s = find_socket(socket);
+    if (s == nullptr) {
+        return -1;
+    }
+
+    if (level == SOL_NETLINK && option_name == NETLINK_GET_STRICT_CHK
+        && option_len >= sizeof (int)) {
+        if (!_strict_check_supported) {
+            errno = ENOPROTOOPT;
+            return -1;
+        }
+        s->strict_check = *static_cast<const int *>(option_value) != 0;
+    }
+    else if (level == IPPROTO_IPV6 && (option_name == IPV6_JOIN_GROUP
+            || option_name == IPV6_LEAVE_GROUP)
+        && option_len >= sizeof (ipv6_mreq)) {
+        auto &&index = static_cast<const ipv6_mreq *>(option_value)
+            ->ipv6mr_interface;
+        if (_links.find(index) == _links.end()) {
+            errno = ENODEV;
+            return -1;
+        }
+        if (option_name == IPV6_JOIN_GROUP) {
+            if (!s->memberships.insert(index).second) {
+                errno = EADDRINUSE;
+                return -1;
+            }
+        }
+        else if (s->memberships.erase(index) == 0) {
+            errno = EADDRNOTAVAIL;
+            return -1;
+        }
+        _statistics.membership_changes += 1;
+    }
+    return 0;
+}
+
+int simulated_posix::close(const int fildes)
+{
+    if (_sockets.erase(fildes) == 0) {
+        errno = EBADF;
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t simulated_posix::recv(const int socket, void *const buffer,
+    const size_t length, const int flags)
+{
+    iovec iov {buffer, length};
+    msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return recvmsg(socket, &msg, flags);
+}
+
+ssize_t simulated_posix::send(const int socket, const void *const buffer,
+    const size_t length, const int flags)
+{
+    iovec iov {const_cast<void *>(buffer), length};
+    msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return sendmsg(socket, &msg, flags);
+}
+
+ssize_t simulated_posix::recvmsg(const int socket, msghdr *const message,
+    const int flags)
+{
+    auto &&s = find_socket(socket);
+    if (s == nullptr) {
+        return -1;
+    }
+    if (s->overflowed) {
+        s->overflowed = false;
+        errno = ENOBUFS;
+        return -1;
+    }
+    if (s->queue.empty()) {
+        if (!s->nonblocking && (flags & MSG_DONTWAIT) == 0) {
+            throw logic_error("simulated receive would block forever");
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+
+    auto &&d = s->queue.front();
+    size_t copied = 0;
+    for (size_t i = 0; i != message->msg_iovlen; ++i) {
+        auto n = min(message->msg_iov[i].iov_len, d.data.size() - copied);
+        memcpy(message->msg_iov[i].iov_base, d.data.data() + copied, n);
+        copied += n;
+    }
+    message->msg_flags = copied < d.data.size() ? MSG_TRUNC : 0;
+
+    if (message->msg_name != nullptr) {
+        if (s->domain == PF_INET6) {
+            memcpy(message->msg_name, &d.address,
+                min(size_t(message->msg_namelen), sizeof d.address));
+            message->msg_namelen = sizeof d.address;
+        }
+        else {
+            const sockaddr_nl kernel {AF_NETLINK, 0, 0, 0};
+            memcpy(message->msg_name, &kernel,
+                min(size_t(message->msg_namelen), sizeof kernel));
+            message->msg_namelen = sizeof kernel;
+        }
+    }
+
+    if (message->msg_control != nullptr) {
+        if (s->domain == PF_INET6
+            && message->msg_controllen >= CMSG_SPACE(sizeof (in6_pktinfo))) {
+            auto &&cmsg = CMSG_FIRSTHDR(message);
+            cmsg->cmsg_level = IPPROTO_IPV6;
+            cmsg->cmsg_type = IPV6_PKTINFO;
+            cmsg->cmsg_len = CMSG_LEN(sizeof (in6_pktinfo));
+            const in6_pktinfo pktinfo {d.destination, d.interface_index};
+            memcpy(CMSG_DATA(cmsg), &pktinfo, sizeof pktinfo);
+            message->msg_controllen = CMSG_SPACE(sizeof (in6_pktinfo));
+        }
+        else {
+            message->msg_controllen = 0;
+        }
+    }
+
+    auto &&size = d.data.size();
+    if ((flags & MSG_PEEK) == 0) {
+        s->queue.pop_front();
+    }
+    return ssize_t((flags & MSG_TRUNC) != 0 ? size : copied);
+}
+
+ssize_t simulated_posix::sendmsg(const int socket,
+    const msghdr *const message, const int)
+{
+    auto &&s = find_socket(socket);
+    if (s == nullptr) {
+        return -1;
+    }
+
+    auto &&data = vector<uint8_t>();
+    for (size_t i = 0; i != message->msg_iovlen; ++i) {
+        auto &&base = static_cast<const uint8_t *>(
+            message->msg_iov[i].iov_base);
+        data.insert(data.end(), base, base + message->msg_iov[i].iov_len);
+    }
+
+    if (s->domain == PF_NETLINK) {
+        auto &&size = data.size();
+        auto &&nlmsg = reinterpret_cast<const nlmsghdr *>(data.data());
+        if (_address_dump_delay != clock::duration::zero()
+            && size >= NLMSG_HDRLEN && nlmsg->nlmsg_type == RTM_GETADDR) {
+            schedule(_address_dump_delay,
+                [this, socket, data = move(data)]() {
+                    auto &&found = _sockets.find(socket);
+                    if (found != _sockets.end()) {
+                        handle_request(found->second, data.data(),
+                            data.size());
+                    }
+                });
+        }
+        else {
+            handle_request(*s, data.data(), data.size());
+        }
+        return size;
+    }
+
+    if (message->msg_name == nullptr
+        || message->msg_namelen < sizeof (sockaddr_in6)) {
+        errno = EDESTADDRREQ;
+        return -1;
+    }
+
+    auto &&recipient = *static_cast<const sockaddr_in6 *>(message->msg_name);
+    auto &&index = recipient.sin6_scope_id;
+
+    // Datagrams are never fragmented.
+    auto &&found = _links.find(index);
+    if (found != _links.end()
+        && data.size() + IPV6_UDP_OVERHEAD > found->second.mtu) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    auto &&size = data.size();
+    _sent.push_back({_now, index, recipient, in6addr_any, move(data)});
+    return size;
+}
+
+int simulated_posix::recvmmsg(const int socket, mmsghdr *const messages,
+    const unsigned int vlen, const int flags, timespec *)
+{
+    _statistics.recvmmsg_calls += 1;
+
+    auto &&message_flags = flags & ~MSG_WAITFORONE;
+    unsigned int i = 0;
+    while (i != vlen) {
+        auto &&received = recvmsg(socket, &messages[i].msg_hdr,
+            message_flags);
+        if (received == -1) {
+            return i != 0 ? int(i) : -1;
+        }
+        messages[i].msg_len = received;
+        ++i;
+        if ((flags & MSG_WAITFORONE) != 0) {
+            message_flags |= MSG_DONTWAIT;
+        }
+    }
+    return int(i);
+}
+
+int simulated_posix::sendmmsg(const int socket, mmsghdr *const messages,
+    const unsigned int vlen, const int flags)
+{
+    _statistics.sendmmsg_calls += 1;
+
+    unsigned int i = 0;
+    while (i != vlen) {
+        auto &&sent = sendmsg(socket, &messages[i].msg_hdr, flags);
+        if (sent == -1) {
+            return i != 0 ? int(i) : -1;
+        }
+        messages[i].msg_len = sent;
+        ++i;
+    }
+    return int(i);
+}
+
+int simulated_posix::poll(pollfd *const fds, const nfds_t nfds,
+    const int timeout)
+{
+    _statistics.poll_calls += 1;
+    run_events();
+
+    auto deadline = clock::time_point::max();
+    if (timeout >= 0) {
+        deadline = _now + milliseconds(timeout);
+    }
+
+    while (true) {
+        int ready = 0;
+        for (nfds_t i = 0; i != nfds; ++i) {
+            fds[i].revents = 0;
+            if (fds[i].fd < 0) {
+                continue;
+            }
+
+            auto &&found = _sockets.find(fds[i].fd);
+            if (found == _sockets.end()) {
+                fds[i].revents = POLLNVAL;
+            }
+            else if ((fds[i].events & POLLIN) != 0
+                && (!found->second.queue.empty()
+                    || found->second.overflowed)) {
+                fds[i].revents = POLLIN;
+            }
+            if (fds[i].revents != 0) {
+                ready += 1;
+            }
+        }
+        if (ready != 0 || _now >= deadline) {
+            return ready;
+        }
+
+        if (!_events.empty() && _events.begin()->first <= deadline) {
+            _now = max(_now, _events.begin()->first);
+            run_events();
+        }
+        else if (timeout < 0) {
+            throw logic_error("simulated poll would block forever");
+        }
+        else {
+            _now = deadline;
+        }
+    }
+}
+
+int simulated_posix::clock_gettime(const clockid_t clock_id,
+    timespec *const tp)
+{
+    if (clock_id != CLOCK_MONOTONIC) {
+        return ::clock_gettime(clock_id, tp);
+    }
+
+    auto &&time = duration_cast<nanoseconds>(_now.time_since_epoch());
+    tp->tv_sec = time.count() / 1000000000;
+    tp->tv_nsec = time.count() % 1000000000;
+    return 0;
+}
+
+auto simulated_posix::find_socket(const int fd) -> socket_state *
+{
+    auto &&found = _sockets.find(fd);
+    if (found == _sockets.end()) {
+        errno = EBADF;
+        return nullptr;
+    }
+    return &found->second;
+}
+
+void simulated_posix::handle_request(socket_state &s,
+    const void *const request, const size_t size)
+{
+    auto &&nlmsg = static_cast<const nlmsghdr *>(request);
+    if (size < NLMSG_HDRLEN || nlmsg->nlmsg_len > size) {
+        return;
+    }
+
+    auto &&sequence = nlmsg->nlmsg_seq;
+    auto &&messages = vector<vector<uint8_t>>();
+    switch (nlmsg->nlmsg_type) {
+    case RTM_GETLINK:
+        for (auto &&i : _links) {
+            messages.push_back(
+                link_message(RTM_NEWLINK, NLM_F_MULTI, sequence, i.first));
+        }
+        break;
+    case RTM_GETADDR:
+        {
+            // Only strict checking makes the kernel filter the dump.
+            unsigned int index = 0;
+            int family = AF_UNSPEC;
+            if (s.strict_check
+                && nlmsg->nlmsg_len >= NLMSG_LENGTH(sizeof (ifaddrmsg))) {
+                auto &&ifa = static_cast<const ifaddrmsg *>(NLMSG_DATA(nlmsg));
+                index = ifa->ifa_index;
+                family = ifa->ifa_family;
+            }
+
+            for (auto &&i : _links) {
+                if (index != 0 && i.first != index) {
+                    continue;
+                }
+                if (family == AF_UNSPEC || family == AF_INET) {
+                    for (auto &&j : i.second.in_addresses) {
+                        messages.push_back(address_message(RTM_NEWADDR,
+                            NLM_F_MULTI, sequence, i.first, AF_INET, &j,
+                            sizeof j));
+                    }
+                }
+                if (family == AF_UNSPEC || family == AF_INET6) {
+                    for (auto &&j : i.second.in6_addresses) {
+                        messages.push_back(address_message(RTM_NEWADDR,
+                            NLM_F_MULTI, sequence, i.first, AF_INET6, &j,
+                            sizeof j));
+                    }
+                }
+            }
+        }
+        break;
+    default:
+        {
+            nlmsgerr error {-EOPNOTSUPP, *nlmsg};
+            auto &&message = make_message(NLMSG_ERROR, 0, sequence, error);
+            finish_message(message);
+            s.queue.push_back({_now, 0, {}, {}, move(message)});
+        }
+        return;
+    }
+
+    auto &&done = make_message(NLMSG_DONE, NLM_F_MULTI, sequence, int(0));
+    finish_message(done);
+    messages.push_back(move(done));
+
+    // Messages are packed into datagrams as the kernel does.
+    auto &&packet = vector<uint8_t>();
+    for (auto &&i : messages) {
+        if (!packet.empty() && packet.size() + i.size() > DUMP_PACKET_SIZE) {
+            s.queue.push_back({_now, 0, {}, {}, move(packet)});
+            packet.clear();
+        }
+        packet.insert(packet.end(), i.begin(), i.end());
+    }
+    s.queue.push_back({_now, 0, {}, {}, move(packet)});
+}
+
+void simulated_posix::notify(const uint32_t group,
+    const vector<uint8_t> &message)
+{
+    for (auto &&i : _sockets) {
+        auto &&s = i.second;
+        if (s.domain != PF_NETLINK || (s.groups & group) == 0) {
+            continue;
+        }
+
+        if (_notification_limit != 0
+            && s.queue.size() >= _notification_limit) {
+            s.overflowed = true;
+            _statistics.netlink_overflows += 1;
+        }
+        else {
+            s.queue.push_back({_now, 0, {}, {}, message});
+        }
+    }
+}
+
+vector<uint8_t> simulated_posix::link_message(const uint16_t type,
+    const uint16_t flags, const uint32_t sequence,
+    const unsigned int index) const
+{
+    auto &&l = _links.at(index);
+
+    ifinfomsg ifi {};
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_index = index;
+    ifi.ifi_flags = l.flags;
+
+    auto &&message = make_message(type, flags, sequence, ifi);
+    append_attribute(message, IFLA_IFNAME, l.name.c_str(),
+        l.name.size() + 1);
+    uint32_t mtu = l.mtu;
+    append_attribute(message, IFLA_MTU, &mtu, sizeof mtu);
+    finish_message(message);
+    return message;
+}
+
+vector<uint8_t> simulated_posix::address_message(const uint16_t type,
+    const uint16_t flags, const uint32_t sequence, const unsigned int index,
+    const int family, const void *const address, const size_t size) const
+{
+    ifaddrmsg ifa {};
+    ifa.ifa_family = family;
+    ifa.ifa_index = index;
+    if (family == AF_INET6) {
+        auto &&in6 = static_cast<const in6_addr *>(address);
+        ifa.ifa_prefixlen = 64;
+        ifa.ifa_scope = IN6_IS_ADDR_LINKLOCAL(in6) ? RT_SCOPE_LINK
+            : IN6_IS_ADDR_LOOPBACK(in6) ? RT_SCOPE_HOST : RT_SCOPE_UNIVERSE;
+    }
+    else {
+        auto &&in = static_cast<const in_addr *>(address);
+        ifa.ifa_prefixlen = 24;
+        ifa.ifa_scope = (ntohl(in->s_addr) >> 24) == 127 ? RT_SCOPE_HOST
+            : RT_SCOPE_UNIVERSE;
+    }
+
+    auto &&message = make_message(type, flags, sequence, ifa);
+    append_attribute(message, IFA_ADDRESS, address, size);
+    finish_message(message);
+    return message;
+}
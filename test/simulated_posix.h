@@ -0,0 +1,336 @@
+// simulated_posix.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef SIMULATED_POSIX_H
+#define SIMULATED_POSIX_H 1
+
+#include "posix.h"
+#include <netinet/in.h>
+#include <net/if.h>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Simulated operating system interface for deterministic tests.
+ *
+ * It has a virtual multicast fabric of links, a fake RTNETLINK kernel that
+ * dumps the links and their addresses and notifies their changes, and a
+ * virtual clock that advances only when 'poll' would otherwise block.
+ * No call blocks; a receive on an empty socket fails with 'EAGAIN' if it
+ * is non-blocking, or throws 'std::logic_error' as it would block forever
+ * otherwise.
+ *
+ * This class is not thread-safe, so the objects using it must be driven
+ * on a single thread.
+ */
+class simulated_posix: public xllmnrd::posix
+{
+public:
+
+    /// Clock whose time points are used in virtual time.
+    using clock = std::chrono::steady_clock;
+
+    /// Datagram received or sent on a simulated UDP socket.
+    struct datagram
+    {
+        /// Virtual time when the datagram was sent.
+        clock::time_point time;
+
+        /// Index of the link on which the datagram was carried.
+        unsigned int interface_index;
+
+        /// Sender of a received datagram, or recipient of a sent one.
+        sockaddr_in6 address;
+
+        /// Destination address of a received datagram.
+        in6_addr destination;
+
+        std::vector<std::uint8_t> data;
+    };
+
+    /// Counts of calls.
+    struct statistics
+    {
+        std::size_t socket_calls = 0;
+
+        std::size_t recvmmsg_calls = 0;
+
+        std::size_t sendmmsg_calls = 0;
+
+        std::size_t poll_calls = 0;
+
+        /// Number of multicast groups joined or left.
+        std::size_t membership_changes = 0;
+
+        /// Number of notifications dropped by overflowing sockets.
+        std::size_t netlink_overflows = 0;
+    };
+
+private:
+
+    struct link
+    {
+        std::string name;
+
+        unsigned int mtu;
+
+        unsigned int flags;
+
+        std::vector<in_addr> in_addresses;
+
+        std::vector<in6_addr> in6_addresses;
+    };
+
+    struct socket_state
+    {
+        int domain;
+
+        /// True if the socket was opened with 'SOCK_NONBLOCK'.
+        bool nonblocking = false;
+
+        /// Multicast groups for RTNETLINK notifications.
+        std::uint32_t groups = 0;
+
+        bool strict_check = false;
+
+        /// Port bound, in network byte order.
+        in_port_t port = 0;
+
+        /// Interfaces on which the LLMNR group is joined.
+        std::set<unsigned int> memberships;
+
+        std::deque<datagram> queue;
+
+        /// True if a notification was dropped since the last receive.
+        bool overflowed = false;
+    };
+
+    clock::time_point _now {std::chrono::seconds(1)};
+
+    std::map<unsigned int, link> _links;
+
+    unsigned int _next_index = 1;
+
+    std::map<int, socket_state> _sockets;
+
+    int _next_fd = 1000;
+
+    std::multimap<clock::time_point, std::function<void ()>> _events;
+
+    std::vector<datagram> _sent;
+
+    /// Maximum number of notifications queued on a socket, or zero.
+    std::size_t _notification_limit = 0;
+
+    /// Indicates if the fake kernel supports strict checking.
+    bool _strict_check_supported = true;
+
+    /// Delay of the replies to address dump requests.
+    clock::duration _address_dump_delay {};
+
+    statistics _statistics;
+
+public:
+
+    simulated_posix() = default;
+
+
+    // Virtual time.
+
+    /// Returns the virtual time.
+    clock::time_point now() const
+    {
+        return _now;
+    }
+
+    /**
+     * Schedules an event at a virtual time from now.
+     *
+     * Events are run by 'poll' or 'advance' in order of their time.
+     */
+    void schedule(clock::duration delay, std::function<void ()> event);
+
+    /**
+     * Advances the virtual time, running the events due.
+     */
+    void advance(clock::duration duration);
+
+
+    // Links and addresses, which are notified to RTNETLINK sockets.
+
+    /**
+     * Adds a link.
+     *
+     * @return the index of the link
+     */
+    unsigned int add_link(const std::string &name, unsigned int mtu = 1500,
+        unsigned int flags = IFF_UP | IFF_MULTICAST);
+
+    void set_link_flags(unsigned int index, unsigned int flags);
+
+    void set_link_name(unsigned int index, const std::string &name);
+
+    void remove_link(unsigned int index);
+
+    void add_address(unsigned int index, const in_addr &address);
+
+    void add_address(unsigned int index, const in6_addr &address);
+
+    void remove_address(unsigned int index, const in6_addr &address);
+
+    /**
+     * Sets the maximum number of notifications queued on each RTNETLINK
+     * socket.
+     *
+     * Any more notifications are dropped, and the next receive fails with
+     * 'ENOBUFS' as on the real kernel.
+     *
+     * @param limit a number of notifications, or zero for no limit
+     */
+    void set_notification_limit(std::size_t limit)
+    {
+        _notification_limit = limit;
+    }
+
+    /**
+     * Sets whether the fake kernel supports strict checking of dump
+     * requests as kernels since Linux 4.20 do.
+     *
+     * Without the support, setting 'NETLINK_GET_STRICT_CHK' fails with
+     * 'ENOPROTOOPT' and dumps are never filtered.
+     */
+    void set_strict_check_supported(bool supported)
+    {
+        _strict_check_supported = supported;
+    }
+
+    /**
+     * Sets the delay in virtual time of the replies to address dump
+     * requests, which are made from the addresses at the end of the delay.
+     */
+    void set_address_dump_delay(clock::duration delay)
+    {
+        _address_dump_delay = delay;
+    }
+
+
+    // Multicast fabric.
+
+    /**
+     * Delivers a datagram from a link to the UDP sockets bound to a port.
+     *
+     * A datagram to a multicast group is delivered only if the group is
+     * joined on the link by any socket.
+     *
+     * @param port a port in network byte order
+     * @return the number of sockets to which the datagram is delivered
+     */
+    std::size_t deliver(unsigned int index, const sockaddr_in6 &sender,
+        const in6_addr &destination, in_port_t port,
+        const std::vector<std::uint8_t> &data);
+
+    /// Returns the number of sockets that joined a group on a link.
+    std::size_t membership_count(unsigned int index) const;
+
+    /// Returns the datagrams sent so far.
+    const std::vector<datagram> &sent() const
+    {
+        return _sent;
+    }
+
+    void clear_sent()
+    {
+        _sent.clear();
+    }
+
+    const statistics &get_statistics() const
+    {
+        return _statistics;
+    }
+
+
+    // Overrides.
+
+    int socket(int domain, int type, int protocol) override;
+
+    int bind(int socket, const sockaddr *address,
+        socklen_t address_len) override;
+
+    int setsockopt(int socket, int level, int option_name,
+        const void *option_value, socklen_t option_len) override;
+
+    int close(int fildes) override;
+
+    ::ssize_t recv(int socket, void *buffer, ::size_t length,
+        int flags) override;
+
+    ::ssize_t send(int socket, const void *buffer, ::size_t length,
+        int flags) override;
+
+    ::ssize_t recvmsg(int socket, msghdr *message, int flags) override;
+
+    ::ssize_t sendmsg(int socket, const msghdr *message, int flags) override;
+
+    int recvmmsg(int socket, mmsghdr *messages, unsigned int vlen, int flags,
+        timespec *timeout) override;
+
+    int sendmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+        int flags) override;
+
+    /**
+     * Polls the simulated sockets.
+     *
+     * If no socket is ready, the virtual time advances to the next event
+     * or to the timeout.  It throws 'std::logic_error' if it would block
+     * forever.
+     */
+    int poll(pollfd *fds, nfds_t nfds, int timeout) override;
+
+    /// Returns the virtual time for 'CLOCK_MONOTONIC'.
+    int clock_gettime(clockid_t clock_id, timespec *tp) override;
+
+protected:
+
+    socket_state *find_socket(int fd);
+
+    /// Runs the events due by the virtual time.
+    void run_events();
+
+    /// Handles a request to the fake RTNETLINK kernel.
+    void handle_request(socket_state &s, const void *request,
+        std::size_t size);
+
+    /// Queues a notification on the RTNETLINK sockets in a group.
+    void notify(std::uint32_t group, const std::vector<std::uint8_t> &message);
+
+    std::vector<std::uint8_t> link_message(std::uint16_t type,
+        std::uint16_t flags, std::uint32_t sequence, unsigned int index) const;
+
+    std::vector<std::uint8_t> address_message(std::uint16_t type,
+        std::uint16_t flags, std::uint32_t sequence, unsigned int index,
+        int family, const void *address, std::size_t size) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+// test_address_set.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "interface.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <utility>
+
+using CppUnit::TestFixture;
+using xllmnrd::address_set;
+using namespace std;
+
+/*
+ * Tests for address_set.
+ */
+class AddressSetTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(AddressSetTest);
+    CPPUNIT_TEST(testInsert);
+    CPPUNIT_TEST(testErase);
+    CPPUNIT_TEST(testCopy);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    static in_addr address(unsigned int n)
+    {
+        in_addr in {};
+        in.s_addr = htonl(0xc0000200 + n);
+        return in;
+    }
+
+    void testInsert()
+    {
+        auto addresses = address_set<in_addr, 2>();
+        for (auto &&n : {3U, 1U, 2U, 1U}) {
+            addresses.insert(address(n));
+        }
+        CPPUNIT_ASSERT_EQUAL(size_t(3), addresses.size());
+        CPPUNIT_ASSERT(!addresses.is_inline());
+
+        // Addresses must be kept in order.
+        auto n = 1U;
+        for (auto &&i : addresses) {
+            CPPUNIT_ASSERT_EQUAL(address(n).s_addr, i.s_addr);
+            n += 1;
+        }
+        CPPUNIT_ASSERT(!addresses.insert(address(2)).second);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), addresses.count(address(3)));
+    }
+
+    void testErase()
+    {
+        auto addresses = address_set<in_addr>();
+        addresses.insert(address(1));
+        addresses.insert(address(2));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), addresses.erase(address(1)));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), addresses.erase(address(1)));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), addresses.size());
+        CPPUNIT_ASSERT(addresses.find(address(1)) == addresses.end());
+        CPPUNIT_ASSERT(addresses.find(address(2)) == addresses.begin());
+    }
+
+    void testCopy()
+    {
+        auto addresses = address_set<in_addr, 2>();
+        for (auto &&n : {1U, 2U, 3U}) {
+            addresses.insert(address(n));
+        }
+
+        auto copy = addresses;
+        CPPUNIT_ASSERT(copy == addresses);
+        copy.erase(address(2));
+        CPPUNIT_ASSERT(copy != addresses);
+
+        auto moved = std::move(copy);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), moved.size());
+        CPPUNIT_ASSERT(copy.empty());
+        CPPUNIT_ASSERT(copy.is_inline());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(AddressSetTest);
@@ -0,0 +1,117 @@
+// test_hosts.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "hosts.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+using CppUnit::TestFixture;
+using xllmnrd::hosts_table;
+using namespace std;
+
+/*
+ * Tests for hosts_table.
+ */
+class HostsTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(HostsTest);
+    CPPUNIT_TEST(testFind);
+    CPPUNIT_TEST(testCaseInsensitive);
+    CPPUNIT_TEST(testComments);
+    CPPUNIT_TEST(testLoad);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    static const char TEXT[];
+
+private:
+    void testFind()
+    {
+        auto table = hosts_table(TEXT, strlen(TEXT));
+        CPPUNIT_ASSERT_EQUAL(size_t(3), table.size());
+
+        static const uint8_t FOO[] = {3, 'f', 'o', 'o', 0};
+        auto found = table.find(FOO);
+        CPPUNIT_ASSERT(found != nullptr);
+
+        auto in = table.in_addresses(*found);
+        CPPUNIT_ASSERT_EQUAL(ptrdiff_t(1), in.end() - in.begin());
+        CPPUNIT_ASSERT_EQUAL(inet_addr("192.0.2.1"), in.begin()->s_addr);
+
+        auto in6 = table.in6_addresses(*found);
+        CPPUNIT_ASSERT_EQUAL(ptrdiff_t(2), in6.end() - in6.begin());
+
+        static const uint8_t BAZ[] = {3, 'b', 'a', 'z', 0};
+        CPPUNIT_ASSERT(table.find(BAZ) == nullptr);
+    }
+
+    void testCaseInsensitive()
+    {
+        auto table = hosts_table(TEXT, strlen(TEXT));
+
+        static const uint8_t BAR_EXAMPLE[] = {
+            3, 'B', 'a', 'R', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0
+        };
+        auto found = table.find(BAR_EXAMPLE);
+        CPPUNIT_ASSERT(found != nullptr);
+        CPPUNIT_ASSERT(table.in_addresses(*found).empty());
+        CPPUNIT_ASSERT(!table.in6_addresses(*found).empty());
+    }
+
+    void testComments()
+    {
+        auto table = hosts_table(TEXT, strlen(TEXT));
+
+        static const uint8_t IGNORED[] = {7, 'i', 'g', 'n', 'o', 'r', 'e', 'd', 0};
+        CPPUNIT_ASSERT(table.find(IGNORED) == nullptr);
+    }
+
+    void testLoad()
+    {
+        char name[] = "/tmp/test_hosts.XXXXXX";
+        int fd = mkstemp(name);
+        CPPUNIT_ASSERT(fd != -1);
+        close(fd);
+        {
+            ofstream out(name);
+            out << TEXT;
+        }
+
+        auto table = hosts_table::load(name);
+        unlink(name);
+        CPPUNIT_ASSERT_EQUAL(size_t(3), table->size());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(HostsTest);
+
+const char HostsTest::TEXT[] =
+    "# Sample hosts file\n"
+    "192.0.2.1\tfoo  foo-alias # ignored\n"
+    "2001:db8::1 foo\n"
+    "fe80::1%eth0 foo bar.example.\n"
+    "not-an-address ignored\n";
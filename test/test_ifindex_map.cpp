@@ -0,0 +1,132 @@
+// test_ifindex_map.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "ifindex_map.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <cstdint>
+
+using CppUnit::TestFixture;
+using xllmnrd::ifindex_map;
+using namespace std;
+
+/*
+ * Tests for ifindex_map.
+ */
+class IfindexMapTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(IfindexMapTest);
+    CPPUNIT_TEST(testDense);
+    CPPUNIT_TEST(testSparse);
+    CPPUNIT_TEST(testInsert);
+    CPPUNIT_TEST(testChurn);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testDense()
+    {
+        auto map = ifindex_map<int>();
+        map.insert_or_assign(1, 10);
+        map.insert_or_assign(5, 50);
+        map.insert_or_assign(1, 11);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), map.size());
+        CPPUNIT_ASSERT_EQUAL(11, *map.find(1));
+        CPPUNIT_ASSERT_EQUAL(50, *map.find(5));
+        CPPUNIT_ASSERT(map.find(2) == nullptr);
+        CPPUNIT_ASSERT(map.find(1000) == nullptr);
+
+        CPPUNIT_ASSERT(map.erase(5));
+        CPPUNIT_ASSERT(!map.erase(5));
+        CPPUNIT_ASSERT(map.find(5) == nullptr);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), map.size());
+    }
+
+    void testSparse()
+    {
+        auto &&outlier = ifindex_map<int>::DENSE_LIMIT + 7;
+
+        auto map = ifindex_map<int>();
+        map.insert_or_assign(outlier, 70);
+        map.insert_or_assign(3, 30);
+        CPPUNIT_ASSERT_EQUAL(70, *map.find(outlier));
+
+        auto sum = 0;
+        map.for_each([&sum](unsigned int, int value) {
+            sum += value;
+        });
+        CPPUNIT_ASSERT_EQUAL(100, sum);
+
+        map.clear();
+        CPPUNIT_ASSERT(map.empty());
+        CPPUNIT_ASSERT(map.find(outlier) == nullptr);
+    }
+
+    void testInsert()
+    {
+        auto map = ifindex_map<int>();
+        CPPUNIT_ASSERT(map.insert_or_assign(2, 1));
+        CPPUNIT_ASSERT(!map.insert_or_assign(2, 2));
+        map.erase(2);
+        CPPUNIT_ASSERT(map.insert_or_assign(2, 3));
+        CPPUNIT_ASSERT_EQUAL(3, *map.find(2));
+    }
+
+    void testChurn()
+    {
+        // Indices are allocated cyclically, so they keep growing while a
+        // few interfaces are alive at a time.
+        auto map = ifindex_map<int>();
+        map.insert_or_assign(1, 1);
+        for (unsigned int i = 2; i != 200000; ++i) {
+            map.insert_or_assign(i, i);
+            if (i >= 10) {
+                CPPUNIT_ASSERT(map.erase(i - 8));
+            }
+            CPPUNIT_ASSERT(map.slot_count() <= 100);
+        }
+        CPPUNIT_ASSERT_EQUAL(size_t(9), map.size());
+        CPPUNIT_ASSERT_EQUAL(1, *map.find(1));
+        CPPUNIT_ASSERT_EQUAL(199999, *map.find(199999));
+        CPPUNIT_ASSERT(map.find(199991) == nullptr);
+
+        // Values move back to the vector as it becomes dense.
+        for (unsigned int i = 2; i != 1000; ++i) {
+            map.insert_or_assign(i, i);
+        }
+        CPPUNIT_ASSERT_EQUAL(size_t(1007), map.size());
+        CPPUNIT_ASSERT_EQUAL(500, *map.find(500));
+        CPPUNIT_ASSERT_EQUAL(199995, *map.find(199995));
+        for (unsigned int i = 2; i != 1000; ++i) {
+            CPPUNIT_ASSERT(map.erase(i));
+        }
+        CPPUNIT_ASSERT(map.slot_count() <= 100);
+
+        auto sum = 0U;
+        map.for_each([&sum](unsigned int index, int value) {
+            CPPUNIT_ASSERT_EQUAL(index, unsigned(value));
+            sum += 1;
+        });
+        CPPUNIT_ASSERT_EQUAL(9U, sum);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(IfindexMapTest);
@@ -0,0 +1,277 @@
+// test_interface.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "interface.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <functional>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+using CppUnit::TestFixture;
+using xllmnrd::interface_event;
+using xllmnrd::interface_listener;
+using xllmnrd::interface_manager;
+using namespace std;
+
+/*
+ * Interface manager whose changes are made by tests.
+ */
+class test_interface_manager: public interface_manager
+{
+public:
+    using interface_manager::begin_batch;
+    using interface_manager::commit_batch;
+    using interface_manager::begin_staging;
+    using interface_manager::commit_staging;
+    using interface_manager::enable_interface;
+    using interface_manager::disable_interface;
+    using interface_manager::remove_interface;
+    using interface_manager::add_interface_address;
+
+    void refresh(bool) override
+    {
+    }
+};
+
+/*
+ * Listener that calls a function for each event.
+ */
+class function_listener: public interface_listener
+{
+public:
+    function<void (const interface_event &, bool)> callback;
+
+    void interface_enabled(const interface_event &event) override
+    {
+        callback(event, true);
+    }
+
+    void interface_disabled(const interface_event &event) override
+    {
+        callback(event, false);
+    }
+};
+
+/*
+ * Tests for interface_manager.
+ */
+class InterfaceTest: public TestFixture, public interface_listener
+{
+    CPPUNIT_TEST_SUITE(InterfaceTest);
+    CPPUNIT_TEST(testBatch);
+    CPPUNIT_TEST(testStaging);
+    CPPUNIT_TEST(testGeneration);
+    CPPUNIT_TEST(testListeners);
+    CPPUNIT_TEST(testRemoveWhileDispatching);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    unsigned int enableCount = 0;
+    unsigned int disableCount = 0;
+    unsigned int dispatchCount = 0;
+
+    unique_ptr<test_interface_manager> manager;
+
+public:
+    void setUp() override
+    {
+        enableCount = 0;
+        disableCount = 0;
+        dispatchCount = 0;
+        manager.reset(new test_interface_manager());
+        manager->set_debug_level(-1);
+        manager->add_interface_listener(this);
+    }
+
+    void tearDown() override
+    {
+        manager->remove_interface_listener(this);
+        manager.reset();
+    }
+
+    void interface_enabled(const interface_event &) override
+    {
+        enableCount++;
+    }
+
+    void interface_disabled(const interface_event &) override
+    {
+        disableCount++;
+    }
+
+    void interface_events_dispatched(interface_manager *) override
+    {
+        dispatchCount++;
+    }
+
+private:
+    static in_addr address(unsigned int n)
+    {
+        in_addr in {};
+        in.s_addr = htonl(0xc0000200 + n);
+        return in;
+    }
+
+    void testBatch()
+    {
+        manager->begin_batch();
+        manager->enable_interface(1);
+        manager->enable_interface(2);
+        manager->disable_interface(2);
+        manager->enable_interface(3);
+        CPPUNIT_ASSERT(manager->find_interface(1) == nullptr);
+        manager->commit_batch();
+
+        CPPUNIT_ASSERT_EQUAL(2U, enableCount);
+        CPPUNIT_ASSERT_EQUAL(0U, disableCount);
+        CPPUNIT_ASSERT(manager->find_interface(1)->enabled);
+        // The end of the batch must be notified once.
+        CPPUNIT_ASSERT_EQUAL(1U, dispatchCount);
+
+        manager->disable_interface(3);
+        CPPUNIT_ASSERT_EQUAL(2U, dispatchCount);
+        // No event, no notification.
+        manager->disable_interface(3);
+        CPPUNIT_ASSERT_EQUAL(2U, dispatchCount);
+    }
+
+    void testStaging()
+    {
+        auto in1 = address(1);
+        auto in2 = address(2);
+        manager->enable_interface(1);
+        manager->add_interface_address(1, AF_INET, &in1);
+        manager->enable_interface(2);
+        auto generation = manager->find_interface(1)->generation;
+        CPPUNIT_ASSERT_EQUAL(2U, enableCount);
+
+        // The same state must make no events.
+        manager->begin_staging();
+        manager->enable_interface(1);
+        manager->add_interface_address(1, AF_INET, &in1);
+        manager->enable_interface(2);
+        manager->commit_staging();
+        CPPUNIT_ASSERT_EQUAL(2U, enableCount);
+        CPPUNIT_ASSERT_EQUAL(0U, disableCount);
+
+        manager->begin_staging();
+        manager->enable_interface(1);
+        manager->add_interface_address(1, AF_INET, &in2);
+        manager->enable_interface(3);
+        // The current state must be kept while staging.
+        CPPUNIT_ASSERT(manager->find_interface(2) != nullptr);
+        manager->commit_staging();
+        CPPUNIT_ASSERT_EQUAL(3U, enableCount);
+        CPPUNIT_ASSERT_EQUAL(1U, disableCount);
+
+        auto interface = manager->find_interface(1);
+        CPPUNIT_ASSERT_EQUAL(generation, interface->generation);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), interface->in_addresses.size());
+        CPPUNIT_ASSERT_EQUAL(in2.s_addr,
+            interface->in_addresses.begin()->s_addr);
+        CPPUNIT_ASSERT(manager->find_interface(2) == nullptr);
+    }
+
+    void testGeneration()
+    {
+        manager->enable_interface(1);
+        manager->enable_interface(2);
+        auto generation = manager->find_interface(1)->generation;
+        CPPUNIT_ASSERT(generation != manager->find_interface(2)->generation);
+
+        // A change keeps the generation.
+        manager->disable_interface(1);
+        CPPUNIT_ASSERT_EQUAL(generation,
+            manager->find_interface(1)->generation);
+
+        // A reused index has a new generation.
+        manager->remove_interface(1);
+        CPPUNIT_ASSERT(manager->find_interface(1) == nullptr);
+        manager->enable_interface(1);
+        CPPUNIT_ASSERT(generation != manager->find_interface(1)->generation);
+    }
+
+    void testListeners()
+    {
+        unsigned int otherCount = 0;
+        auto other = function_listener();
+        other.callback = [&](const interface_event &event, bool enabled) {
+            otherCount++;
+            if (enabled && event.interface_index == 1) {
+                // This would dead-lock if the mutex were still locked.
+                auto &&t = thread([this]() {
+                    manager->enable_interface(2);
+                });
+                t.join();
+            }
+        };
+        manager->add_interface_listener(&other);
+
+        manager->enable_interface(1);
+        CPPUNIT_ASSERT_EQUAL(2U, enableCount);
+        CPPUNIT_ASSERT_EQUAL(2U, otherCount);
+
+        manager->remove_interface_listener(&other);
+        manager->disable_interface(1);
+        CPPUNIT_ASSERT_EQUAL(1U, disableCount);
+        CPPUNIT_ASSERT_EQUAL(2U, otherCount);
+    }
+
+    void testRemoveWhileDispatching()
+    {
+        auto &&entered = promise<void>();
+        auto &&release = promise<void>();
+        auto &&released = release.get_future();
+        auto slow = function_listener();
+        slow.callback = [&](const interface_event &, bool) {
+            entered.set_value();
+            released.wait();
+        };
+        manager->add_interface_listener(&slow);
+
+        auto &&dispatcher = thread([this]() {
+            manager->enable_interface(1);
+        });
+        entered.get_future().wait();
+
+        // The listener must not be removed while it is being called.
+        atomic<bool> removed {false};
+        auto &&remover = thread([this, &slow, &removed]() {
+            manager->remove_interface_listener(&slow);
+            removed = true;
+        });
+        this_thread::sleep_for(chrono::milliseconds(20));
+        CPPUNIT_ASSERT(!removed);
+
+        release.set_value();
+        remover.join();
+        dispatcher.join();
+        CPPUNIT_ASSERT(removed);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(InterfaceTest);
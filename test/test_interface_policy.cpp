@@ -0,0 +1,74 @@
+// test_interface_policy.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "interface_policy.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+
+using CppUnit::TestFixture;
+using xllmnrd::interface_policy;
+using namespace std;
+
+/*
+ * Tests for interface_policy.
+ */
+class InterfacePolicyTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(InterfacePolicyTest);
+    CPPUNIT_TEST(testEmpty);
+    CPPUNIT_TEST(testExclude);
+    CPPUNIT_TEST(testInclude);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testEmpty()
+    {
+        auto policy = interface_policy();
+        CPPUNIT_ASSERT(policy.empty());
+        CPPUNIT_ASSERT(policy.allows("veth1234", "veth"));
+    }
+
+    void testExclude()
+    {
+        auto policy = interface_policy();
+        policy.exclude("cali*");
+        policy.exclude("kind:veth");
+        CPPUNIT_ASSERT(!policy.empty());
+        CPPUNIT_ASSERT(policy.allows("eth0", ""));
+        CPPUNIT_ASSERT(!policy.allows("cali0123456789a", ""));
+        CPPUNIT_ASSERT(!policy.allows("eth1", "veth"));
+    }
+
+    void testInclude()
+    {
+        auto policy = interface_policy();
+        policy.include("eth*");
+        policy.include("kind:bridge");
+        policy.exclude("eth9");
+        CPPUNIT_ASSERT(policy.allows("eth0", ""));
+        CPPUNIT_ASSERT(policy.allows("br0", "bridge"));
+        CPPUNIT_ASSERT(!policy.allows("wlan0", ""));
+        CPPUNIT_ASSERT(!policy.allows("eth9", ""));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(InterfacePolicyTest);
@@ -0,0 +1,77 @@
+// test_membership.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "membership.h"
+
+#include "llmnr.h"
+#include <net/if.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+
+using CppUnit::TestFixture;
+using xllmnrd::membership_pool;
+using namespace std;
+
+/*
+ * Tests for membership_pool.
+ */
+class MembershipTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(MembershipTest);
+    CPPUNIT_TEST(testJoin);
+    CPPUNIT_TEST(testPending);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testJoin()
+    {
+        auto &&lo = if_nametoindex("lo");
+        CPPUNIT_ASSERT(lo != 0);
+
+        auto &&pool = membership_pool(in6addr_mc_llmnr, 1);
+        CPPUNIT_ASSERT(pool.join(lo));
+        CPPUNIT_ASSERT(pool.join(lo));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), pool.get_statistics().joined);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), pool.get_statistics().sockets);
+
+        CPPUNIT_ASSERT(pool.leave(lo));
+        CPPUNIT_ASSERT(!pool.leave(lo));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), pool.get_statistics().joined);
+    }
+
+    void testPending()
+    {
+        // No interface should have this index.
+        const unsigned int missing = 0x7fffffff;
+
+        auto &&pool = membership_pool(in6addr_mc_llmnr);
+        CPPUNIT_ASSERT(!pool.join(missing));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), pool.get_statistics().pending);
+        CPPUNIT_ASSERT_EQUAL(size_t(0), pool.retry());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(2), pool.get_statistics().join_failures);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), pool.get_statistics().retries);
+
+        CPPUNIT_ASSERT(!pool.leave(missing));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), pool.get_statistics().pending);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(MembershipTest);
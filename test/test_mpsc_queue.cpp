@@ -0,0 +1,94 @@
+// test_mpsc_queue.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "mpsc_queue.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <thread>
+#include <vector>
+
+using CppUnit::TestFixture;
+using xllmnrd::mpsc_queue;
+using namespace std;
+
+/*
+ * Tests for mpsc_queue.
+ */
+class MPSCQueueTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(MPSCQueueTest);
+    CPPUNIT_TEST(testOrder);
+    CPPUNIT_TEST(testProducers);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testOrder()
+    {
+        auto queue = mpsc_queue<int>();
+        CPPUNIT_ASSERT(queue.empty());
+        queue.push(1);
+        queue.push(2);
+        CPPUNIT_ASSERT(!queue.empty());
+
+        int value = 0;
+        CPPUNIT_ASSERT(queue.try_pop(value));
+        CPPUNIT_ASSERT_EQUAL(1, value);
+        CPPUNIT_ASSERT(queue.try_pop(value));
+        CPPUNIT_ASSERT_EQUAL(2, value);
+        CPPUNIT_ASSERT(!queue.try_pop(value));
+        CPPUNIT_ASSERT(queue.empty());
+    }
+
+    void testProducers()
+    {
+        const int producers = 4;
+        const int count = 10000;
+
+        auto queue = mpsc_queue<int>();
+        auto threads = vector<thread>();
+        for (int i = 0; i != producers; ++i) {
+            threads.emplace_back([&queue, i]() {
+                for (int j = 0; j != count; ++j) {
+                    queue.push(i * count + j);
+                }
+            });
+        }
+
+        // Values from each producer must be in order.
+        auto next = vector<int>(producers);
+        int popped = 0;
+        while (popped != producers * count) {
+            int value = 0;
+            if (queue.try_pop(value)) {
+                CPPUNIT_ASSERT_EQUAL(next[value / count], value % count);
+                next[value / count] += 1;
+                popped += 1;
+            }
+        }
+        for (auto &&i : threads) {
+            i.join();
+        }
+        CPPUNIT_ASSERT(queue.empty());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(MPSCQueueTest);
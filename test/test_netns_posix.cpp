@@ -0,0 +1,109 @@
+// test_netns_posix.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "netns_posix.h"
+#include "rtnetlink.h"
+
+#if XLLMNRD_NETNS && XLLMNRD_RTNETLINK
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <thread>
+#include <string>
+
+using CppUnit::TestFixture;
+using xllmnrd::netns_posix;
+using xllmnrd::rtnetlink_interface_manager;
+using namespace std;
+
+/*
+ * Tests for netns_posix.
+ */
+class NetnsPosixTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(NetnsPosixTest);
+    CPPUNIT_TEST(testPath);
+    CPPUNIT_TEST(testRefresh);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    /// File descriptor for a new network namespace, or -1.
+    int netns = -1;
+
+public:
+    void setUp() override
+    {
+        // A thread enters a new namespace, which outlives it by the file.
+        thread([this]() {
+            if (unshare(CLONE_NEWNET) == 0) {
+                netns = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+            }
+        }).join();
+    }
+
+    void tearDown() override
+    {
+        if (netns != -1) {
+            close(netns);
+            netns = -1;
+        }
+    }
+
+private:
+    void testPath()
+    {
+        CPPUNIT_ASSERT_EQUAL(string("/var/run/netns/blue"),
+            netns_posix::netns_path("blue"));
+        CPPUNIT_ASSERT_EQUAL(string("/proc/1/ns/net"),
+            netns_posix::netns_path("/proc/1/ns/net"));
+    }
+
+    void testRefresh()
+    {
+        if (netns == -1) {
+            clog << "could not make a network namespace; skipped" << endl;
+            return;
+        }
+
+        auto &&path = "/proc/self/fd/" + to_string(netns);
+        auto &&os = make_shared<netns_posix>(path.c_str());
+        auto &&manager = rtnetlink_interface_manager(os);
+        manager.set_externally_driven(true);
+        manager.refresh();
+
+        // A new namespace has nothing but the loopback interface.
+        CPPUNIT_ASSERT(manager.ready());
+        auto &&lo = manager.find_interface(1);
+        CPPUNIT_ASSERT(lo != nullptr);
+        CPPUNIT_ASSERT_EQUAL(string("lo"), lo->name);
+        for (unsigned int i = 2; i != 64; ++i) {
+            CPPUNIT_ASSERT(manager.find_interface(i) == nullptr);
+        }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(NetnsPosixTest);
+
+#endif /* XLLMNRD_NETNS && XLLMNRD_RTNETLINK */
@@ -0,0 +1,192 @@
+// test_pcap.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "pcap.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <sstream>
+#include <stdexcept>
+
+using CppUnit::TestFixture;
+using xllmnrd::captured_datagram;
+using xllmnrd::pcap_reader;
+using xllmnrd::pcap_writer;
+using namespace std;
+
+/*
+ * Returns an IPv6 socket address from a string and a port.
+ */
+static sockaddr_in6 address(const char *s, uint16_t port)
+{
+    sockaddr_in6 result {};
+    result.sin6_family = AF_INET6;
+    result.sin6_port = htons(port);
+    inet_pton(AF_INET6, s, &result.sin6_addr);
+    return result;
+}
+
+/*
+ * Appends bytes of a big-endian pcap file.
+ */
+static void put_uint32(string &file, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        file.push_back(char(value >> shift));
+    }
+}
+
+/*
+ * Tests for pcap_reader and pcap_writer.
+ */
+class PcapTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(PcapTest);
+    CPPUNIT_TEST(testRoundTrip);
+    CPPUNIT_TEST(testEmptyPayload);
+    CPPUNIT_TEST(testEthernet);
+    CPPUNIT_TEST(testInvalid);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testRoundTrip()
+    {
+        auto &&stream = stringstream();
+        {
+            auto &&writer = pcap_writer(stream);
+            auto &&datagram = captured_datagram {};
+            datagram.time = chrono::nanoseconds(1600000000123456789);
+            datagram.source = address("fe80::2", 49152);
+            datagram.destination = address("ff02::1:3", 5355);
+            datagram.payload = {1, 2, 3};
+            writer.write(datagram);
+        }
+
+        auto &&reader = pcap_reader(stream);
+        CPPUNIT_ASSERT_EQUAL(xllmnrd::PCAP_LINKTYPE_RAW, reader.link_type());
+
+        auto &&datagram = captured_datagram {};
+        CPPUNIT_ASSERT(reader.read(datagram));
+        CPPUNIT_ASSERT_EQUAL(int64_t(1600000000123456789),
+            int64_t(datagram.time.count()));
+        CPPUNIT_ASSERT_EQUAL(htons(49152), datagram.source.sin6_port);
+        CPPUNIT_ASSERT_EQUAL(htons(5355), datagram.destination.sin6_port);
+        auto &&group = address("ff02::1:3", 0).sin6_addr;
+        CPPUNIT_ASSERT(IN6_ARE_ADDR_EQUAL(&group,
+            &datagram.destination.sin6_addr));
+        CPPUNIT_ASSERT(datagram.payload == vector<uint8_t>({1, 2, 3}));
+        CPPUNIT_ASSERT(!reader.read(datagram));
+    }
+
+    void testEmptyPayload()
+    {
+        // The datagram ends exactly at the end of the captured packet.
+        auto &&stream = stringstream();
+        {
+            auto &&writer = pcap_writer(stream);
+            auto &&datagram = captured_datagram {};
+            datagram.source = address("fe80::2", 49152);
+            datagram.destination = address("ff02::1:3", 5355);
+            writer.write(datagram);
+        }
+
+        auto &&reader = pcap_reader(stream);
+        auto &&datagram = captured_datagram {};
+        datagram.payload = {1};
+        CPPUNIT_ASSERT(reader.read(datagram));
+        CPPUNIT_ASSERT(datagram.payload.empty());
+        CPPUNIT_ASSERT(!reader.read(datagram));
+    }
+
+    void testEthernet()
+    {
+        // A big-endian file with microsecond timestamps.
+        auto &&file = string();
+        put_uint32(file, 0xa1b2c3d4);
+        put_uint32(file, 0x00020004);
+        put_uint32(file, 0);
+        put_uint32(file, 0);
+        put_uint32(file, 65535);
+        put_uint32(file, 1);
+
+        // An IPv4 frame, which is skipped.
+        auto &&ipv4 = string(12, '\0') + "\x08\x00" + string(28, '\0');
+        put_uint32(file, 1);
+        put_uint32(file, 0);
+        put_uint32(file, ipv4.size());
+        put_uint32(file, ipv4.size());
+        file += ipv4;
+
+        // A VLAN-tagged IPv6 frame with a UDP datagram of 2 octets.
+        auto &&frame = string(12, '\0') + string("\x81\x00\x00\x05", 4)
+            + "\x86\xdd";
+        auto &&ip6 = string(40, '\0');
+        ip6[0] = 0x60;
+        ip6[5] = 10;
+        ip6[6] = IPPROTO_UDP;
+        ip6[23] = 2;
+        ip6[39] = 1;
+        frame += ip6 + string("\xc0\x00\x14\xeb\x00\x0a\x00\x00xy", 10);
+        put_uint32(file, 2);
+        put_uint32(file, 500000);
+        put_uint32(file, frame.size());
+        put_uint32(file, frame.size());
+        file += frame;
+
+        auto &&stream = istringstream(file);
+        auto &&reader = pcap_reader(stream);
+        auto &&datagram = captured_datagram {};
+        CPPUNIT_ASSERT(reader.read(datagram));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), reader.skipped());
+        CPPUNIT_ASSERT_EQUAL(int64_t(2500000000),
+            int64_t(datagram.time.count()));
+        CPPUNIT_ASSERT_EQUAL(htons(5355), datagram.destination.sin6_port);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(2),
+            datagram.source.sin6_addr.s6_addr[15]);
+        CPPUNIT_ASSERT(datagram.payload == vector<uint8_t>({'x', 'y'}));
+        CPPUNIT_ASSERT(!reader.read(datagram));
+    }
+
+    void testInvalid()
+    {
+        auto &&stream = istringstream(string(24, 'x'));
+        CPPUNIT_ASSERT_THROW(pcap_reader {stream}, invalid_argument);
+
+        // A record is cut off.
+        auto &&file = string();
+        put_uint32(file, 0xa1b2c3d4);
+        put_uint32(file, 0x00020004);
+        put_uint32(file, 0);
+        put_uint32(file, 0);
+        put_uint32(file, 65535);
+        put_uint32(file, 101);
+        put_uint32(file, 0);
+        put_uint32(file, 0);
+        put_uint32(file, 40);
+        auto &&truncated = istringstream(file);
+        auto &&reader = pcap_reader(truncated);
+        auto &&datagram = captured_datagram {};
+        CPPUNIT_ASSERT_THROW(reader.read(datagram), invalid_argument);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(PcapTest);
@@ -0,0 +1,411 @@
+// test_responder.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "responder.h"
+#include "simulated_posix.h"
+#include "llmnr.h"
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <memory>
+#include <vector>
+#include <set>
+#include <string>
+#include <cstring>
+
+using CppUnit::TestFixture;
+using xllmnrd::rtnetlink_interface_manager;
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * Returns an IPv6 address from a string.
+ */
+static in6_addr in6(const char *s)
+{
+    in6_addr address {};
+    inet_pton(AF_INET6, s, &address);
+    return address;
+}
+
+/*
+ * Returns a query for a name.
+ */
+static vector<uint8_t> make_query(uint16_t id, const string &name,
+    uint16_t qtype)
+{
+    auto &&query = vector<uint8_t>(LLMNR_HEADER_SIZE);
+    query[0] = id >> 8;
+    query[1] = id & 0xff;
+    query[5] = 1; // qdcount
+    query.push_back(name.size());
+    query.insert(query.end(), name.begin(), name.end());
+    query.push_back(0);
+    query.push_back(qtype >> 8);
+    query.push_back(qtype & 0xff);
+    query.push_back(0);
+    query.push_back(LLMNR_QCLASS_IN);
+    return query;
+}
+
+static uint16_t get_uint16(const vector<uint8_t> &data, size_t offset)
+{
+    return (data[offset] << 8) | data[offset + 1];
+}
+
+/*
+ * Tests for the responder on a simulated network.
+ */
+class ResponderTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(ResponderTest);
+    CPPUNIT_TEST(testUnicast);
+    CPPUNIT_TEST(testMulticast);
+    CPPUNIT_TEST(testScopedNames);
+    CPPUNIT_TEST(testTruncation);
+    CPPUNIT_TEST(testFlood);
+    CPPUNIT_TEST(testChurn);
+    CPPUNIT_TEST(testFlap);
+    CPPUNIT_TEST(testFalseReadiness);
+    CPPUNIT_TEST(testAsynchronousStartup);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    shared_ptr<simulated_posix> os;
+
+    shared_ptr<rtnetlink_interface_manager> manager;
+
+    unique_ptr<responder> r;
+
+    unsigned int eth0 = 0;
+
+    sockaddr_in6 sender {};
+
+public:
+    void setUp() override
+    {
+        os = make_shared<simulated_posix>();
+        os->add_link("lo", 65536, IFF_UP | IFF_LOOPBACK);
+        eth0 = os->add_link("eth0");
+        os->add_address(eth0, in6("fe80::1"));
+
+        manager = make_shared<rtnetlink_interface_manager>(os);
+        manager->set_externally_driven(true);
+
+        sender.sin6_family = AF_INET6;
+        sender.sin6_port = htons(49152);
+        sender.sin6_addr = in6("fe80::2");
+    }
+
+    void tearDown() override
+    {
+        r.reset();
+        manager.reset();
+        os.reset();
+    }
+
+protected:
+    /*
+     * Starts a responder for the name "host".
+     */
+    void start()
+    {
+        auto &&name = vector<uint8_t> {4, 'h', 'o', 's', 't', 0};
+        r = make_unique<responder>(htons(LLMNR_PORT), manager,
+            vector<scoped_name> {{name, {}}}, os);
+        r->set_externally_driven(true);
+        r->start();
+    }
+
+    /*
+     * Drives the responder and the interface manager for a virtual time.
+     */
+    void run_for(nanoseconds duration)
+    {
+        auto &&end = os->now() + duration;
+        while (os->now() < end) {
+            pollfd fds[1 + rtnetlink_interface_manager::MAX_POLL_DESCRIPTORS];
+            fds[0] = {r->udp6_socket(), POLLIN, 0};
+            int timeout = -1;
+            auto &&count = manager->get_poll_descriptors(fds + 1, timeout);
+            auto &&remains = int(ceil<milliseconds>(end - os->now()).count());
+            if (timeout < 0 || timeout > remains) {
+                timeout = remains;
+            }
+
+            os->poll(fds, count + 1, timeout);
+            if (fds[0].revents != 0) {
+                r->process_udp6();
+            }
+            manager->process_poll(fds + 1, count);
+        }
+    }
+
+    void query(unsigned int index, uint16_t id, const in6_addr &destination,
+        uint16_t qtype = LLMNR_QTYPE_AAAA)
+    {
+        os->deliver(index, sender, destination, htons(LLMNR_PORT),
+            make_query(id, "host", qtype));
+    }
+
+private:
+    void testUnicast()
+    {
+        start();
+        query(eth0, 1, in6("fe80::1"));
+        query(eth0, 2, in6("fe80::1"), LLMNR_QTYPE_A);
+        run_for(milliseconds(1));
+
+        auto &&sent = os->sent();
+        CPPUNIT_ASSERT_EQUAL(size_t(2), sent.size());
+        CPPUNIT_ASSERT_EQUAL(eth0, sent[0].interface_index);
+        CPPUNIT_ASSERT_EQUAL(sender.sin6_port, sent[0].address.sin6_port);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(1), get_uint16(sent[0].data, 0));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(1), get_uint16(sent[0].data, 6));
+
+        auto &&address = in6("fe80::1");
+        auto &&data = sent[0].data;
+        CPPUNIT_ASSERT(memcmp(&data[data.size() - sizeof address],
+            &address, sizeof address) == 0);
+
+        // No A record exists.
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0), get_uint16(sent[1].data, 6));
+    }
+
+    void testMulticast()
+    {
+        start();
+        CPPUNIT_ASSERT_EQUAL(size_t(1), os->membership_count(eth0));
+
+        // The loopback interface cannot multicast.
+        CPPUNIT_ASSERT_EQUAL(size_t(0), os->membership_count(1));
+
+        query(eth0, 1, in6addr_mc_llmnr);
+        run_for(milliseconds(1));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), os->sent().size());
+    }
+
+    void testScopedNames()
+    {
+        auto &&eth1 = os->add_link("eth1");
+        os->add_address(eth1, in6("fe80::11"));
+
+        auto &&host = vector<uint8_t> {4, 'h', 'o', 's', 't', 0};
+        auto &&mgmt = vector<uint8_t> {4, 'm', 'g', 'm', 't', 0};
+        r = make_unique<responder>(htons(LLMNR_PORT), manager,
+            vector<scoped_name> {{host, {}}, {mgmt, {"eth0"}}}, os);
+        r->set_externally_driven(true);
+        r->start();
+
+        for (auto &&i : {eth0, eth1}) {
+            os->deliver(i, sender, in6addr_mc_llmnr, htons(LLMNR_PORT),
+                make_query(i, "mgmt", LLMNR_QTYPE_AAAA));
+            os->deliver(i, sender, in6addr_mc_llmnr, htons(LLMNR_PORT),
+                make_query(0x100 + i, "host", LLMNR_QTYPE_AAAA));
+        }
+        run_for(milliseconds(1));
+
+        // The scoped name is answered only on its interface.
+        auto &&ids = set<uint16_t>();
+        for (auto &&i : os->sent()) {
+            ids.insert(get_uint16(i.data, 0));
+        }
+        CPPUNIT_ASSERT(ids == set<uint16_t>({uint16_t(eth0),
+            uint16_t(0x100 + eth0), uint16_t(0x100 + eth1)}));
+    }
+
+    void testTruncation()
+    {
+        auto &&eth1 = os->add_link("eth1", 1280);
+        for (unsigned int i = 0; i != 100; ++i) {
+            auto &&address = in6("fd00::");
+            address.s6_addr[14] = i >> 8;
+            address.s6_addr[15] = i & 0xff;
+            os->add_address(eth1, address);
+        }
+
+        start();
+        query(eth1, 1, in6("fd00::1"));
+        run_for(milliseconds(1));
+
+        auto &&sent = os->sent();
+        CPPUNIT_ASSERT_EQUAL(size_t(1), sent.size());
+        CPPUNIT_ASSERT(sent[0].data.size() <= 1280 - 48);
+        CPPUNIT_ASSERT((get_uint16(sent[0].data, 2) & LLMNR_FLAG_TC) != 0);
+        CPPUNIT_ASSERT(get_uint16(sent[0].data, 6) < 100);
+    }
+
+    void testFlood()
+    {
+        start();
+        for (uint16_t i = 0; i != 1000; ++i) {
+            query(eth0, i, in6addr_mc_llmnr);
+        }
+        run_for(milliseconds(1));
+
+        // Queries are received and answered in batches.
+        CPPUNIT_ASSERT_EQUAL(size_t(1000), os->sent().size());
+        auto &&batches = (1000 + responder::BATCH_SIZE - 1)
+            / responder::BATCH_SIZE;
+        CPPUNIT_ASSERT_EQUAL(batches, os->get_statistics().recvmmsg_calls);
+        CPPUNIT_ASSERT_EQUAL(batches, os->get_statistics().sendmmsg_calls);
+    }
+
+    void testChurn()
+    {
+        manager->set_coalescing_window(milliseconds(10));
+        start();
+
+        // A query flood on two links while the second one comes and goes.
+        unsigned int eth1 = 0;
+        for (int i = 0; i != 500; ++i) {
+            os->schedule(microseconds(100 * i), [this, i, &eth1]() {
+                query(eth0, i, in6addr_mc_llmnr);
+                if (eth1 != 0) {
+                    query(eth1, 0x8000 + i, in6addr_mc_llmnr);
+                }
+            });
+        }
+        os->schedule(milliseconds(10), [this, &eth1]() {
+            eth1 = os->add_link("eth1");
+            os->add_address(eth1, in6("fe80::11"));
+        });
+        os->schedule(milliseconds(35), [this, &eth1]() {
+            os->remove_link(eth1);
+            eth1 = 0;
+        });
+        auto &&start_time = os->now();
+        run_for(milliseconds(60));
+
+        size_t eth0_answers = 0;
+        auto first_eth1_answer = nanoseconds::max();
+        auto last_eth1_answer = nanoseconds::min();
+        for (auto &&i : os->sent()) {
+            // Every response is sent without delay in virtual time.
+            auto &&id = get_uint16(i.data, 0);
+            auto &&query_time = microseconds(100 * (id & 0x7fff));
+            auto &&time = i.time - start_time;
+            CPPUNIT_ASSERT(time == query_time);
+
+            if ((id & 0x8000) == 0) {
+                CPPUNIT_ASSERT_EQUAL(uint16_t(1), get_uint16(i.data, 6));
+                eth0_answers += 1;
+            }
+            else if (get_uint16(i.data, 6) != 0) {
+                first_eth1_answer = min(first_eth1_answer, time);
+                last_eth1_answer = max(last_eth1_answer, time);
+            }
+        }
+        CPPUNIT_ASSERT_EQUAL(size_t(500), eth0_answers);
+
+        // The link is enabled at the end of its window.
+        CPPUNIT_ASSERT(first_eth1_answer >= milliseconds(20));
+        CPPUNIT_ASSERT(first_eth1_answer <= milliseconds(21));
+        CPPUNIT_ASSERT(last_eth1_answer <= milliseconds(35));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), os->membership_count(eth0 + 1));
+    }
+
+    void testFlap()
+    {
+        manager->set_coalescing_window(milliseconds(10));
+        start();
+        run_for(milliseconds(1));
+        auto &&changes = os->get_statistics().membership_changes;
+
+        // An address change on a link already up is applied at once.
+        os->add_address(eth0, in6("fe80::5"));
+        run_for(milliseconds(1));
+        CPPUNIT_ASSERT_EQUAL(size_t(2), manager->in6_addresses(eth0).size());
+
+        // A flap within the window makes no net change.
+        os->set_link_flags(eth0, IFF_MULTICAST);
+        os->schedule(milliseconds(5), [this]() {
+            os->set_link_flags(eth0, IFF_UP | IFF_MULTICAST);
+        });
+        run_for(milliseconds(30));
+        CPPUNIT_ASSERT_EQUAL(changes,
+            os->get_statistics().membership_changes);
+        CPPUNIT_ASSERT(os->membership_count(eth0) != 0);
+
+        // A link that stays down is disabled at the end of its window.
+        os->set_link_flags(eth0, IFF_MULTICAST);
+        run_for(milliseconds(9));
+        CPPUNIT_ASSERT(os->membership_count(eth0) != 0);
+        run_for(milliseconds(2));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), os->membership_count(eth0));
+    }
+
+    void testFalseReadiness()
+    {
+        start();
+        run_for(milliseconds(1));
+
+        // Sockets reported readable with nothing to read must not block.
+        r->process_udp6();
+        pollfd fds[rtnetlink_interface_manager::MAX_POLL_DESCRIPTORS];
+        int timeout = -1;
+        auto &&count = manager->get_poll_descriptors(fds, timeout);
+        for (size_t i = 0; i != count; ++i) {
+            fds[i].revents = POLLIN;
+        }
+        manager->process_poll(fds, count);
+        CPPUNIT_ASSERT(os->sent().empty());
+
+        query(eth0, 1, in6addr_mc_llmnr);
+        run_for(milliseconds(1));
+        CPPUNIT_ASSERT_EQUAL(size_t(1), os->sent().size());
+    }
+
+    void testAsynchronousStartup()
+    {
+        os->set_address_dump_delay(milliseconds(10));
+
+        auto &&name = vector<uint8_t> {4, 'h', 'o', 's', 't', 0};
+        r = make_unique<responder>(htons(LLMNR_PORT), manager,
+            vector<scoped_name> {{name, {}}}, os);
+        r->set_externally_driven(true);
+        r->set_asynchronous_startup(true);
+        r->start();
+
+        // The link is enabled as soon as it is dumped.
+        run_for(milliseconds(1));
+        CPPUNIT_ASSERT(!manager->ready());
+        CPPUNIT_ASSERT_EQUAL(size_t(1), os->membership_count(eth0));
+
+        // No empty answer while its addresses are still coming.
+        query(eth0, 1, in6addr_mc_llmnr);
+        run_for(milliseconds(1));
+        CPPUNIT_ASSERT(os->sent().empty());
+
+        run_for(milliseconds(10));
+        CPPUNIT_ASSERT(manager->ready());
+
+        query(eth0, 2, in6addr_mc_llmnr);
+        run_for(milliseconds(1));
+        auto &&sent = os->sent();
+        CPPUNIT_ASSERT_EQUAL(size_t(1), sent.size());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(2), get_uint16(sent[0].data, 0));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(1), get_uint16(sent[0].data, 6));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(ResponderTest);
@@ -24,22 +24,126 @@
 
 #if XLLMNRD_RTNETLINK
 
+#include "simulated_posix.h"
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
 #include <syslog.h>
 #include <unistd.h>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <cerrno>
 
 #ifndef LOG_PERROR
 #define LOG_PERROR 0
 #endif
 
 using CppUnit::TestFixture;
+using xllmnrd::default_posix;
+using xllmnrd::interface_policy;
 using xllmnrd::rtnetlink_interface_manager;
 using xllmnrd::interface_event;
 using xllmnrd::interface_listener;
 using namespace std;
 
+/*
+ * POSIX implementation that makes the notification socket overflow on
+ * request.
+ */
+class overflowing_posix: public default_posix
+{
+public:
+    atomic<bool> overflow {false};
+
+    atomic<int> notification_socket {-1};
+
+    int bind(int socket, const sockaddr *address, socklen_t address_len)
+        override
+    {
+        auto &&nl = reinterpret_cast<const sockaddr_nl *>(address);
+        if (nl->nl_groups != 0) {
+            notification_socket = socket;
+        }
+        return default_posix::bind(socket, address, address_len);
+    }
+
+    ssize_t recv(int socket, void *buffer, size_t length, int flags) override
+    {
+        if (socket == notification_socket && overflow.exchange(false)) {
+            errno = ENOBUFS;
+            return -1;
+        }
+        return default_posix::recv(socket, buffer, length, flags);
+    }
+};
+
+/*
+ * POSIX implementation that truncates the message at the end of the first
+ * address dump on request.
+ */
+class truncating_posix: public default_posix
+{
+public:
+    atomic<bool> truncate {false};
+
+    atomic<int> dump_socket {-1};
+
+    int bind(int socket, const sockaddr *address, socklen_t address_len)
+        override
+    {
+        auto &&nl = reinterpret_cast<const sockaddr_nl *>(address);
+        if (nl->nl_groups == 0) {
+            dump_socket = socket;
+        }
+        return default_posix::bind(socket, address, address_len);
+    }
+
+    ssize_t recv(int socket, void *buffer, size_t length, int flags) override
+    {
+        auto &&size = default_posix::recv(socket, buffer, length, flags);
+        if (socket == dump_socket && size > 0 && size_t(size) <= length) {
+            auto &&nlmsg = static_cast<const nlmsghdr *>(buffer);
+            auto &&remains = size_t(size);
+            while (NLMSG_OK(nlmsg, remains)) {
+                if (nlmsg->nlmsg_type == NLMSG_DONE
+                    && truncate.exchange(false)) {
+                    // The message is reported larger than the buffer.
+                    return length + 1;
+                }
+                nlmsg = NLMSG_NEXT(nlmsg, remains);
+            }
+        }
+        return size;
+    }
+};
+
+/*
+ * POSIX implementation that records the threads that send RTNETLINK
+ * requests other than no-ops.
+ */
+class recording_posix: public default_posix
+{
+public:
+    mutex requests_mutex;
+
+    vector<thread::id> request_threads;
+
+    ssize_t send(int socket, const void *buffer, size_t length, int flags)
+        override
+    {
+        auto &&nlmsg = static_cast<const nlmsghdr *>(buffer);
+        if (length >= NLMSG_HDRLEN && nlmsg->nlmsg_type >= NLMSG_MIN_TYPE) {
+            lock_guard<mutex> lock(requests_mutex);
+            request_threads.push_back(this_thread::get_id());
+        }
+        return default_posix::send(socket, buffer, length, flags);
+    }
+};
+
 /*
  * Tests for rtnetlink_interface_manager.
  */
@@ -48,6 +152,11 @@ class RtnetlinkTest: public TestFixture, public interface_listener
     CPPUNIT_TEST_SUITE(RtnetlinkTest);
     CPPUNIT_TEST(testRefresh1);
     CPPUNIT_TEST(testRefresh2);
+    CPPUNIT_TEST(testRefreshOnWorker);
+    CPPUNIT_TEST(testOverflow);
+    CPPUNIT_TEST(testTruncatedDump);
+    CPPUNIT_TEST(testAllowedLinkStrict);
+    CPPUNIT_TEST(testAllowedLinkNonStrict);
     CPPUNIT_TEST_SUITE_END();
 
 private:
@@ -112,6 +221,139 @@ private:
         manager->refresh();
         CPPUNIT_ASSERT(enableCount > disableCount);
     }
+
+private:
+    void testRefreshOnWorker()
+    {
+        auto &&os = make_shared<recording_posix>();
+        manager.reset(new rtnetlink_interface_manager(os));
+        manager->refresh();
+        manager->refresh();
+
+        // The dumps are requested by the worker thread, which owns the
+        // refresh state.
+        lock_guard<mutex> lock(os->requests_mutex);
+        CPPUNIT_ASSERT_EQUAL(size_t(4), os->request_threads.size());
+        for (auto &&i : os->request_threads) {
+            CPPUNIT_ASSERT(i != this_thread::get_id());
+        }
+    }
+
+private:
+    void testOverflow()
+    {
+        auto &&os = make_shared<overflowing_posix>();
+        manager.reset(new rtnetlink_interface_manager(os));
+        manager->add_interface_listener(this);
+        manager->refresh();
+        auto &&enabled = enableCount;
+
+        os->overflow = true;
+        // This wakes the worker thread.
+        manager->refresh(true);
+        for (int i = 0; i != 100 && manager->resync_count() == 0; ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        manager->refresh();
+
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), manager->overflow_count());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), manager->resync_count());
+        // The resync must make no events for unchanged interfaces.
+        CPPUNIT_ASSERT_EQUAL(enabled, enableCount);
+        CPPUNIT_ASSERT_EQUAL(0U, disableCount);
+        manager->remove_interface_listener(this);
+    }
+
+private:
+    void testTruncatedDump()
+    {
+        auto &&os = make_shared<truncating_posix>();
+        os->truncate = true;
+        manager.reset(new rtnetlink_interface_manager(os));
+        manager->refresh(true);
+        for (int i = 0; i != 200 && !manager->ready(); ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+
+        // The refresh must start over instead of waiting for the lost end.
+        CPPUNIT_ASSERT(manager->ready());
+        CPPUNIT_ASSERT(!os->truncate);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), manager->resync_count());
+        manager->refresh();
+    }
+
+private:
+    /*
+     * Tests a link that becomes allowed by a rename on a simulated kernel.
+     */
+    void testAllowedLink(const bool strict_check)
+    {
+        auto &&os = make_shared<simulated_posix>();
+        os->set_strict_check_supported(strict_check);
+        auto &&eth0 = os->add_link("eth0");
+        auto &&veth0 = os->add_link("veth0");
+        auto &&veth1 = os->add_link("veth1");
+        in6_addr addresses[3] = {};
+        for (unsigned int i = 0; i != 3; ++i) {
+            inet_pton(AF_INET6, "fe80::1", &addresses[i]);
+            addresses[i].s6_addr[15] += i;
+            os->add_address(eth0 + i, addresses[i]);
+        }
+
+        auto &&policy = interface_policy();
+        policy.exclude("veth*");
+        manager.reset(new rtnetlink_interface_manager(os));
+        manager->set_interface_policy(policy);
+        manager->set_externally_driven(true);
+        manager->refresh();
+        CPPUNIT_ASSERT_EQUAL(size_t(1), manager->in6_addresses(eth0).size());
+        CPPUNIT_ASSERT(manager->find_interface(veth0) == nullptr);
+        auto &&sockets = os->get_statistics().socket_calls;
+
+        // The addresses of the renamed link have been ignored, so they are
+        // dumped on the socket for address dumps.
+        os->set_link_name(veth0, "eth1");
+        auto &&drive = [&](int n) {
+            for (int i = 0; i != n; ++i) {
+                pollfd fds[rtnetlink_interface_manager::MAX_POLL_DESCRIPTORS];
+                int timeout = -1;
+                auto &&count = manager->get_poll_descriptors(fds, timeout);
+                os->poll(fds, count, 0);
+                manager->process_poll(fds, count);
+            }
+        };
+        drive(10);
+
+        auto &&interface = manager->find_interface(veth0);
+        CPPUNIT_ASSERT(interface != nullptr);
+        CPPUNIT_ASSERT(interface->enabled);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), interface->in6_addresses.size());
+        CPPUNIT_ASSERT(IN6_ARE_ADDR_EQUAL(&addresses[1],
+            &*interface->in6_addresses.begin()));
+        // Other links are unaffected even if the dump is not filtered.
+        CPPUNIT_ASSERT_EQUAL(size_t(1), manager->in6_addresses(eth0).size());
+        CPPUNIT_ASSERT(manager->find_interface(veth1) == nullptr);
+        CPPUNIT_ASSERT_EQUAL(sockets, os->get_statistics().socket_calls);
+
+        // An address removed after the dump is requested stays removed.
+        os->set_link_name(veth1, "eth2");
+        drive(1);
+        os->remove_address(veth1, addresses[2]);
+        drive(10);
+        CPPUNIT_ASSERT(manager->find_interface(veth1) != nullptr);
+        CPPUNIT_ASSERT(manager->in6_addresses(veth1).empty());
+        manager.reset();
+    }
+
+    void testAllowedLinkStrict()
+    {
+        testAllowedLink(true);
+    }
+
+    void testAllowedLinkNonStrict()
+    {
+        testAllowedLink(false);
+    }
 };
 CPPUNIT_TEST_SUITE_REGISTRATION(RtnetlinkTest);
 
@@ -0,0 +1,114 @@
+// test_shared_snapshot.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "shared_snapshot.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using CppUnit::TestFixture;
+using xllmnrd::shared_snapshot;
+using namespace std;
+
+/*
+ * Tests for shared_snapshot.
+ */
+class SharedSnapshotTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(SharedSnapshotTest);
+    CPPUNIT_TEST(testStore);
+    CPPUNIT_TEST(testCacheConflict);
+    CPPUNIT_TEST(testThreads);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    void testStore()
+    {
+        auto &&snapshot = shared_snapshot<int>(make_shared<const int>(1));
+        auto &&first = snapshot.load();
+        CPPUNIT_ASSERT_EQUAL(1, *first);
+        // The cached snapshot must be returned while nothing is stored.
+        CPPUNIT_ASSERT(snapshot.load() == first);
+
+        snapshot.store(make_shared<const int>(2));
+        CPPUNIT_ASSERT_EQUAL(2, *snapshot.load());
+        CPPUNIT_ASSERT_EQUAL(1, *first);
+    }
+
+    void testCacheConflict()
+    {
+        // More objects than the cache entries must not mix their snapshots.
+        auto &&count = 3 * shared_snapshot<int>::CACHE_SIZE;
+        auto &&snapshots = vector<unique_ptr<shared_snapshot<int>>>();
+        for (size_t i = 0; i != count; ++i) {
+            snapshots.emplace_back(new shared_snapshot<int>(
+                make_shared<const int>(static_cast<int>(i))));
+        }
+        for (int round = 0; round != 2; ++round) {
+            for (size_t i = 0; i != count; ++i) {
+                CPPUNIT_ASSERT_EQUAL(static_cast<int>(i),
+                    *snapshots[i]->load());
+            }
+        }
+    }
+
+    void testThreads()
+    {
+        const int count = 10000;
+
+        auto &&snapshot = shared_snapshot<int>(make_shared<const int>(0));
+        auto &&done = atomic<bool>(false);
+
+        // Each reader must see the values in order and the last one.
+        auto &&readers = vector<thread>();
+        auto &&failures = atomic<int>(0);
+        for (int i = 0; i != 4; ++i) {
+            readers.emplace_back([&]() {
+                int last = 0;
+                while (!done.load()) {
+                    auto &&value = *snapshot.load();
+                    if (value < last) {
+                        failures += 1;
+                    }
+                    last = value;
+                }
+                if (*snapshot.load() != count) {
+                    failures += 1;
+                }
+            });
+        }
+
+        for (int i = 1; i <= count; ++i) {
+            snapshot.store(make_shared<const int>(i));
+        }
+        done = true;
+        for (auto &&i : readers) {
+            i.join();
+        }
+        CPPUNIT_ASSERT_EQUAL(0, failures.load());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedSnapshotTest);
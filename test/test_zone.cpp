@@ -0,0 +1,121 @@
+// test_zone.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "zone.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <stdexcept>
+
+using CppUnit::TestFixture;
+using xllmnrd::zone_compiler;
+using xllmnrd::zone_file;
+using namespace std;
+
+/*
+ * Tests for zone_compiler and zone_file.
+ */
+class ZoneTest: public TestFixture
+{
+    CPPUNIT_TEST_SUITE(ZoneTest);
+    CPPUNIT_TEST(testFind);
+    CPPUNIT_TEST(testAny);
+    CPPUNIT_TEST(testInvalidLine);
+    CPPUNIT_TEST(testInvalidImage);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    vector<uint8_t> image;
+
+public:
+    void setUp() override
+    {
+        auto compiler = zone_compiler();
+        compiler.add_line("# Sample zone");
+        compiler.add_line("_ipp._tcp.printer 60 IN SRV 0 0 631 printer");
+        compiler.add_line("printer TXT \"rp=printers/1\" \"note=Room 1\"");
+        compiler.add_line("printer A 192.0.2.10");
+        compiler.add_line("printer AAAA 2001:db8::10");
+        CPPUNIT_ASSERT_EQUAL(size_t(4), compiler.size());
+        image = compiler.compile();
+    }
+
+private:
+    void testFind()
+    {
+        auto zone = zone_file(image.data(), image.size());
+
+        static const uint8_t PRINTER[] = {
+            7, 'P', 'r', 'i', 'n', 't', 'e', 'r', 0
+        };
+        auto txt = zone.find(PRINTER, 16);
+        CPPUNIT_ASSERT_EQUAL(1U, txt.count);
+        // Pointer, type, class, TTL, length and two strings.
+        CPPUNIT_ASSERT_EQUAL(size_t(12 + 14 + 12), txt.size);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0xc0), txt.data[0]);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(12), txt.data[1]);
+
+        static const uint8_t SRV_NAME[] = {
+            4, '_', 'i', 'p', 'p', 4, '_', 't', 'c', 'p',
+            7, 'p', 'r', 'i', 'n', 't', 'e', 'r', 0
+        };
+        auto srv = zone.find(SRV_NAME, 33);
+        CPPUNIT_ASSERT_EQUAL(1U, srv.count);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(60), srv.data[9]);
+
+        CPPUNIT_ASSERT_EQUAL(0U, zone.find(SRV_NAME, 16).count);
+    }
+
+    void testAny()
+    {
+        auto zone = zone_file(image.data(), image.size());
+
+        static const uint8_t PRINTER[] = {
+            7, 'p', 'r', 'i', 'n', 't', 'e', 'r', 0
+        };
+        CPPUNIT_ASSERT_EQUAL(3U, zone.find(PRINTER, 255).count);
+    }
+
+    void testInvalidLine()
+    {
+        auto compiler = zone_compiler();
+        CPPUNIT_ASSERT_THROW(compiler.add_line("name MX 10 mail"),
+            invalid_argument);
+        CPPUNIT_ASSERT_THROW(compiler.add_line("name A 2001:db8::1"),
+            invalid_argument);
+        CPPUNIT_ASSERT_THROW(compiler.add_line("name TXT \"open"),
+            invalid_argument);
+        CPPUNIT_ASSERT_EQUAL(size_t(0), compiler.size());
+    }
+
+    void testInvalidImage()
+    {
+        CPPUNIT_ASSERT_THROW(zone_file(image.data(), image.size() - 1),
+            invalid_argument);
+
+        auto broken = image;
+        broken[0] = 'Y';
+        CPPUNIT_ASSERT_THROW(zone_file(broken.data(), broken.size()),
+            invalid_argument);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(ZoneTest);
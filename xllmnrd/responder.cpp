@@ -25,13 +25,12 @@
 #include "llmnr.h"
 #include "rtnetlink.h"
 #include "ascii.h"
-#include "socket_utility.h"
-#include <net/if.h> /* if_indextoname */
 #include <arpa/inet.h> /* inet_ntop */
 #include <sys/socket.h>
+#include <fnmatch.h>
 #include <syslog.h>
-#include <set>
 #include <vector>
+#include <string>
 #include <array>
 #include <algorithm>
 #include <system_error>
@@ -42,21 +41,28 @@
 #include <cinttypes>
 #include <cassert>
 
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
 using std::array;
 using std::copy;
 using std::copy_n;
 using std::error_code;
 using std::for_each;
 using std::generic_category;
+using std::int64_t;
+using std::lock_guard;
 using std::make_shared;
 using std::make_unique;
-using std::set;
+using std::move;
 using std::shared_ptr;
+using std::size_t;
 using std::strcspn;
+using std::string;
 using std::strlen;
 using std::strerror;
 using std::swap;
 using std::system_error;
+using std::to_string;
 using std::uint8_t;
 using std::uint16_t;
 using std::uint32_t;
@@ -66,6 +72,18 @@ using namespace xllmnrd;
 
 static const uint32_t TIME_TO_LIVE = 30;
 
+// Minimum link MTU for IPv6.
+static const unsigned int IPV6_MIN_MTU = 1280;
+
+// Size of the IPv6 and UDP headers.
+static const unsigned int IPV6_UDP_OVERHEAD = 40 + 8;
+
+// Linux socket option to receive multicast packets for the groups joined by
+// other sockets.
+#ifndef IPV6_MULTICAST_ALL
+#define IPV6_MULTICAST_ALL 29
+#endif
+
 
 /*
  * Logs a socket address.
@@ -139,11 +157,53 @@ inline void log_with_sender(const int pri, const char *const message,
     log_with_sender(pri, message, sender, sizeof *sender);
 }
 
+/*
+ * Returns true if a query name equals a name in the wire format.
+ *
+ * The comparison is case-insensitive in ASCII.
+ */
+inline bool equal_names(const uint8_t *qname, const vector<uint8_t> &name)
+{
+    auto &&i = name.begin();
+    while (i != name.end()) {
+        size_t length = *i++;
+        if (*qname++ != length) {
+            return false;
+        }
+        if (length == 0) {
+            return true;
+        }
+        while (length--) {
+            if (ascii_toupper(*qname++) != ascii_toupper(*i++)) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+// Member functions of 'scoped_name'.
+
+bool scoped_name::matches_interface(const char *const interface_name) const
+{
+    if (interfaces.empty()) {
+        return true;
+    }
+    for (auto &&i : interfaces) {
+        if (fnmatch(i.c_str(), interface_name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Member functions.
 
-int responder::open_udp6(const in_port_t port)
+template<class InterfaceManager, class OS>
+int basic_responder<InterfaceManager, OS>::open_udp6(
+    const shared_ptr<OS> &os, const in_port_t port)
 {
-    int udp6 = socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    int udp6 = os->socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP);
     if (udp6 == -1) {
         throw system_error(errno, generic_category(),
             "could not open an IPv6 UDP socket");
@@ -155,14 +215,14 @@ int responder::open_udp6(const in_port_t port)
 
         // This option is mandatory.
 
-        if (setsockopt(udp6, IPPROTO_IPV6, IPV6_RECVPKTINFO, &ON) == -1) {
+        if (os->setsockopt(udp6, IPPROTO_IPV6, IPV6_RECVPKTINFO, &ON) == -1) {
             throw system_error(errno, generic_category(),
                 "could not set socket option 'IPV6_RECVPKTINFO'");
         }
 
         // Others are not.
 
-        if (setsockopt(udp6, IPPROTO_IPV6, IPV6_V6ONLY, &ON) == -1) {
+        if (os->setsockopt(udp6, IPPROTO_IPV6, IPV6_V6ONLY, &ON) == -1) {
             syslog(LOG_WARNING,
                 "could not set socket option 'IPV6_V6ONLY' to %d: %s",
                 ON, strerror(errno));
@@ -170,14 +230,23 @@ int responder::open_udp6(const in_port_t port)
 
         // The unicast hop limit SHOULD be 1.
         static const int HOP_1 = 1;
-        if (setsockopt(udp6, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &HOP_1) == -1) {
+        if (os->setsockopt(udp6, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &HOP_1)
+            == -1) {
             syslog(LOG_WARNING,
                 "could not set socket option 'IPV6_UNICAST_HOPS' to %d: %s",
                 HOP_1, strerror(errno));
         }
 
+        // Memberships are held by other sockets.
+        if (os->setsockopt(udp6, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &ON)
+            == -1) {
+            syslog(LOG_WARNING,
+                "could not set socket option 'IPV6_MULTICAST_ALL' to %d: %s",
+                ON, strerror(errno));
+        }
+
 #ifdef IPV6_DONTFRAG
-        if (setsockopt(udp6, IPPROTO_IPV6, IPV6_DONTFRAG, &ON) == -1) {
+        if (os->setsockopt(udp6, IPPROTO_IPV6, IPV6_DONTFRAG, &ON) == -1) {
             syslog(LOG_WARNING,
                 "could not set socket option 'IPV6_DONTFRAG' to %d: %s",
                 ON, strerror(errno));
@@ -193,143 +262,208 @@ int responder::open_udp6(const in_port_t port)
             in6addr_any, // .sin6_addr
             0,           // .sin6_scode_id
         };
-        if (bind(udp6, &addr) == -1) {
+        if (os->bind(udp6, &addr) == -1) {
             throw system_error(errno, generic_category(),
                 "could not bind the UDP socket");
         }
     }
     catch (...) {
-        close(udp6);
+        os->close(udp6);
         throw;
     }
 
     return udp6;
 }
 
-responder::responder()
-:
-    responder(htons(LLMNR_PORT))
+/*
+ * Truncates a response to the answers that fit in a size and sets the TC
+ * flag.
+ */
+inline void truncate_response(vector<uint8_t> &buffer, const size_t size)
 {
-    // Nothing to do.
-}
+    auto &&response = reinterpret_cast<llmnr_header *>(buffer.data());
+    response->flags |= htons(LLMNR_FLAG_TC);
+
+    size_t remains = buffer.size() - LLMNR_HEADER_SIZE;
+    auto &&i = llmnr_skip_name(llmnr_data(response), &remains);
+    if (i == nullptr || remains < 4) {
+        buffer.resize(size);
+        return;
+    }
+    i += 4;
+    remains -= 4;
+
+    auto &&end = i;
+    uint16_t count = 0;
+    while (count != ntohs(response->ancount)) {
+        i = llmnr_skip_name(i, &remains);
+        if (i == nullptr || remains < 10
+            || remains - 10 < llmnr_get_uint16(i + 8)) {
+            break;
+        }
+        auto &&record_size = 10 + llmnr_get_uint16(i + 8);
+        if (size_t(i + record_size - buffer.data()) > size) {
+            break;
+        }
+        i += record_size;
+        remains -= record_size;
 
-responder::responder(const in_port_t port)
-:
-    responder(port, make_shared<rtnetlink_interface_manager>())
-{
-    // Nothing to do.
+        end = i;
+        count += 1;
+    }
+
+    response->ancount = htons(count);
+    buffer.resize(end - buffer.data());
 }
 
-responder::responder(const in_port_t port,
-    const shared_ptr<interface_manager> &interface_manager)
+template<class InterfaceManager, class OS>
+basic_responder<InterfaceManager, OS>::basic_responder(const in_port_t port,
+    const shared_ptr<InterfaceManager> &interface_manager,
+    const vector<scoped_name> &names, const shared_ptr<OS> &os)
 :
     _interface_manager {interface_manager},
-    _udp6 {open_udp6(port)}
+    _os {os},
+    _udp6 {open_udp6(_os, port)},
+    _batch {make_unique<udp6_batch>()},
+    _memberships {_os, in6addr_mc_llmnr},
+    _names {names}
 {
+    for (size_t i = 0; i != _names.size(); ++i) {
+        if (_names[i].interfaces.empty()) {
+            _unscoped_names.push_back(i);
+        }
+        else {
+            _scoped = true;
+        }
+    }
+
     _interface_manager->add_interface_listener(this);
-    _interface_manager->refresh();
 }
 
-responder::~responder()
+template<class InterfaceManager, class OS>
+basic_responder<InterfaceManager, OS>::~basic_responder()
 {
     _interface_manager->remove_interface_listener(this);
 
     int udp6 = -1;
     swap(_udp6, udp6);
     if (udp6 != -1) {
-        close(udp6);
+        _os->close(udp6);
     }
 }
 
-void responder::run()
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::start()
+{
+    _start_time = _os->steady_time();
+    _interface_manager->refresh(_asynchronous_startup);
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::run()
 {
     _running = true;
+    start();
+
     while (_running) {
         process_udp6();
+
+        if (_statistics_requested.exchange(false)) {
+            report_statistics();
+        }
     }
 }
 
-void responder::terminate()
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::terminate()
 {
     _running = false;
     // TODO: Should the recv call be interrupted?
 }
 
-void responder::process_udp6() const
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::report_statistics() const
 {
-    if (_running) {
-        auto &&packet_size = recv(_udp6, nullptr, 0, MSG_PEEK | MSG_TRUNC);
-        if (packet_size == -1) {
-            if (errno != EINTR) {
-                syslog(LOG_ERR,
-                    "could not receive a packet: %s", strerror(errno));
-            }
-            return;
-        }
-
-        vector<char> buffer(packet_size);
-
-        sockaddr_in6 sender {};
-        unsigned int ifindex = 0;
-        packet_size = recv_udp6(buffer.data(), buffer.size(), sender, ifindex);
-        if (packet_size == -1) {
-            if (errno != EINTR) {
-                syslog(LOG_ERR,
-                    "cound not receive a packet: %s", strerror(errno));
-            }
-            return;
-        }
+    auto &&interface_count = _interface_scopes.load()->size();
+
+    auto &&memberships = _memberships.get_statistics();
+    syslog(LOG_INFO, "%zu interfaces enabled; "
+        "multicast group joined on %zu, pending on %zu, with %zu sockets; "
+        "%" PRIu64 " join failures, %" PRIu64 " retries",
+        interface_count, memberships.joined, memberships.pending,
+        memberships.sockets, memberships.join_failures,
+        memberships.retries);
+
+    auto &&first_answer_time = _first_answer_time.load();
+    if (first_answer_time >= 0) {
+        syslog(LOG_INFO, "first answer %.3f ms after start",
+            first_answer_time / 1000.0);
+    }
+}
 
-        // The sender address must not be multicast.
-        if (IN6_IS_ADDR_MULTICAST(&sender.sin6_addr)) {
-            log_with_sender(LOG_INFO, "invalid source packet", &sender);
-            return;
-        }
-        if (size_t(packet_size) < sizeof (llmnr_header)) {
-            log_with_sender(LOG_INFO, "short packet", &sender);
-            return;
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::process_udp6()
+{
+    auto &&count = receive_udp6();
+    if (count == -1) {
+        // Nothing may be available even if the socket was polled readable.
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+            syslog(LOG_ERR,
+                "could not receive a packet: %s", strerror(errno));
         }
+        return;
+    }
 
-        auto &&packet = reinterpret_cast<const llmnr_header *>(buffer.data());
-        if (llmnr_is_valid_query(packet)) {
-            if ((packet->flags & htons(LLMNR_FLAG_C)) == 0) {
-                handle_udp6_query(packet, packet_size, sender, ifindex);
-            }
-        }
-        else {
-            log_with_sender(LOG_INFO, "non-query packet", &sender);
-        }
+    for (int i = 0; i != count; ++i) {
+        handle_udp6_packet(_batch->query_headers[i]);
     }
+    flush_responses();
 }
 
-ssize_t responder::recv_udp6(void *const buffer, const size_t buffer_size,
-    sockaddr_in6 &sender, unsigned int &ifindex) const
+template<class InterfaceManager, class OS>
+int basic_responder<InterfaceManager, OS>::receive_udp6()
 {
-    array<iovec, 1> iov = {
-        {
-            buffer,      // .iov_base
-            buffer_size, // .iov_len
-        },
-    };
-    array<char, 128> control;
-    msghdr msg = {
-        &sender,        // .msg_name
-        sizeof sender,  // .msg_namelen
-        iov.data(),     // .msg_iov
-        iov.size(),     // .msg_iovlen
-        control.data(), // .msg_control
-        control.size(), // .msg_controllen
-        0,              // .msg_flags
-    };
-    auto &&received = recvmsg(_udp6, &msg, 0);
-    if (received < 0) {
-        return received;
+    for (size_t i = 0; i != BATCH_SIZE; ++i) {
+        auto &&query = _batch->queries[i];
+        query.iov = {
+            query.data.data(), // .iov_base
+            query.data.size(), // .iov_len
+        };
+        _batch->query_headers[i] = {
+            {
+                &query.sender,        // .msg_name
+                sizeof query.sender,  // .msg_namelen
+                &query.iov,           // .msg_iov
+                1,                    // .msg_iovlen
+                query.control.data(), // .msg_control
+                query.control.size(), // .msg_controllen
+                0,                    // .msg_flags
+            },
+            0, // .msg_len
+        };
+    }
+
+    // This call blocks only until the first packet arrives, and not at all
+    // if externally driven.
+    int flags = MSG_WAITFORONE;
+    if (_externally_driven) {
+        flags |= MSG_DONTWAIT;
     }
+    return _os->recvmmsg(_udp6, _batch->query_headers.data(), BATCH_SIZE,
+        flags, nullptr);
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::handle_udp6_packet(
+    const mmsghdr &header)
+{
+    auto &&msg = header.msg_hdr;
+    auto &&sender = *static_cast<const sockaddr_in6 *>(msg.msg_name);
     if (msg.msg_namelen < sizeof sender) {
-        errno = ENOMSG;
-        return -1;
+        return;
     }
 
+    unsigned int ifindex = 0;
     auto &&cmsg = CMSG_FIRSTHDR(&msg);
     while (cmsg != nullptr) {
         if (cmsg->cmsg_level == IPPROTO_IPV6
@@ -339,14 +473,35 @@ ssize_t responder::recv_udp6(void *const buffer, const size_t buffer_size,
             ifindex = ipi6->ipi6_ifindex;
         }
 
-        cmsg = CMSG_NXTHDR(&msg, cmsg);
+        cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&msg), cmsg);
+    }
+
+    // The sender address must not be multicast.
+    if (IN6_IS_ADDR_MULTICAST(&sender.sin6_addr)) {
+        log_with_sender(LOG_INFO, "invalid source packet", &sender);
+        return;
+    }
+    auto &&packet_size = size_t(header.msg_len);
+    if (packet_size < sizeof (llmnr_header)) {
+        log_with_sender(LOG_INFO, "short packet", &sender);
+        return;
+    }
+
+    auto &&packet = static_cast<const llmnr_header *>(msg.msg_iov->iov_base);
+    if (llmnr_is_valid_query(packet)) {
+        if ((packet->flags & htons(LLMNR_FLAG_C)) == 0) {
+            handle_udp6_query(packet, packet_size, sender, ifindex);
+        }
+    }
+    else {
+        log_with_sender(LOG_INFO, "non-query packet", &sender);
     }
-    return received;
 }
 
-void responder::handle_udp6_query(const llmnr_header *const query,
-    const size_t query_size, const sockaddr_in6 &sender,
-    const unsigned int ifindex) const
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::handle_udp6_query(
+    const llmnr_header *const query, const size_t query_size,
+    const sockaddr_in6 &sender, const unsigned int ifindex)
 {
     // These must already be checked.
     assert(query_size >= sizeof query);
@@ -356,9 +511,27 @@ void responder::handle_udp6_query(const llmnr_header *const query,
 
     auto &&qname_end = llmnr_skip_name(qname, &remains);
     if (qname_end && remains >= 4) {
-        auto &&name = matching_host_name(qname);
+        if (_zone != nullptr
+            && llmnr_get_uint16(qname_end + 2) == LLMNR_QCLASS_IN) {
+            auto &&records = _zone->find(qname, llmnr_get_uint16(qname_end));
+            if (records.count != 0) {
+                respond_with_records(query, qname_end, records, sender,
+                    ifindex);
+                return;
+            }
+        }
+
+        auto &&name = matching_name(qname, ifindex);
         if (!name.empty()) {
-            respond_for_name(_udp6, query, qname_end, name, sender, ifindex);
+            respond_for_name(query, qname_end, name, sender, ifindex);
+        }
+        else if (_hosts != nullptr) {
+            auto &&table = _hosts->table();
+            auto &&entry = table->find(qname);
+            if (entry != nullptr) {
+                respond_for_hosts_entry(query, qname, qname_end,
+                    *table, *entry, sender, ifindex);
+            }
         }
     }
     else {
@@ -366,26 +539,100 @@ void responder::handle_udp6_query(const llmnr_header *const query,
     }
 }
 
-void responder::respond_for_name(const int fd, const llmnr_header *const query,
-    const uint8_t *const qname_end, const vector<uint8_t> &name,
-    const sockaddr_in6 &sender, const unsigned int interface_index) const
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::respond_for_name(
+    const llmnr_header *const query, const uint8_t *const qname_end,
+    const vector<uint8_t> &name, const sockaddr_in6 &sender,
+    const unsigned int interface_index)
 {
-    set<in_addr> in_addresses;
-    set<in6_addr> in6_addresses;
+    const interface_manager::in_address_set no_in_addresses;
+    const interface_manager::in6_address_set no_in6_addresses;
+    auto in_addresses = &no_in_addresses;
+    auto in6_addresses = &no_in6_addresses;
+
+    // The snapshot keeps the address sets alive without copying them.
+    auto &&interface = _interface_manager->find_interface(interface_index);
+
+    // An empty answer would be wrong if the addresses are still coming.
+    if (_asynchronous_startup && !_interface_manager->ready()
+        && (interface == nullptr || (interface->in_addresses.empty()
+            && interface->in6_addresses.empty()))) {
+        return;
+    }
+
+    auto &&qtype = llmnr_get_uint16(qname_end);
+    auto &&qclass = llmnr_get_uint16(qname_end + 2);
+    if (interface != nullptr && qclass == LLMNR_QCLASS_IN) {
+        if (qtype == LLMNR_QTYPE_A || qtype == LLMNR_QTYPE_ANY) {
+            in_addresses = &interface->in_addresses;
+        }
+        if (qtype == LLMNR_QTYPE_AAAA || qtype == LLMNR_QTYPE_ANY) {
+            in6_addresses = &interface->in6_addresses;
+        }
+    }
+
+    respond_with_addresses(query, qname_end, name, *in_addresses,
+        *in6_addresses, sender, interface_index);
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::respond_for_hosts_entry(
+    const llmnr_header *const query, const uint8_t *const qname,
+    const uint8_t *const qname_end, const hosts_table &table,
+    const hosts_table::entry &entry, const sockaddr_in6 &sender,
+    const unsigned int interface_index)
+{
+    auto in_addresses = hosts_table::range<in_addr> {};
+    auto in6_addresses = hosts_table::range<in6_addr> {};
 
     auto &&qtype = llmnr_get_uint16(qname_end);
     auto &&qclass = llmnr_get_uint16(qname_end + 2);
     if (qclass == LLMNR_QCLASS_IN) {
         if (qtype == LLMNR_QTYPE_A || qtype == LLMNR_QTYPE_ANY) {
-            in_addresses = _interface_manager->in_addresses(interface_index);
+            in_addresses = table.in_addresses(entry);
         }
         if (qtype == LLMNR_QTYPE_AAAA || qtype == LLMNR_QTYPE_ANY) {
-            in6_addresses = _interface_manager->in6_addresses(interface_index);
+            in6_addresses = table.in6_addresses(entry);
         }
     }
 
-    std::vector<uint8_t> buffer {
-        reinterpret_cast<const uint8_t *>(query), qname_end + 4};
+    respond_with_addresses(query, qname_end,
+        vector<uint8_t>(qname, qname_end), in_addresses, in6_addresses,
+        sender, interface_index);
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::respond_with_records(
+    const llmnr_header *const query, const uint8_t *const qname_end,
+    const zone_file::records &records, const sockaddr_in6 &sender,
+    const unsigned int interface_index)
+{
+    auto &&question_end = qname_end + 4;
+    auto &&buffer = response_buffer();
+    buffer.reserve(question_end - reinterpret_cast<const uint8_t *>(query)
+        + records.size);
+    buffer.assign(reinterpret_cast<const uint8_t *>(query), question_end);
+    buffer.insert(buffer.end(), records.data, records.data + records.size);
+
+    auto response = reinterpret_cast<llmnr_header *>(buffer.data());
+    response->flags = htons(LLMNR_FLAG_QR);
+    response->ancount = htons(records.count);
+    response->nscount = htons(0);
+    response->arcount = htons(0);
+
+    send_response(sender, interface_index);
+}
+
+template<class InterfaceManager, class OS>
+template<class InRange, class In6Range>
+void basic_responder<InterfaceManager, OS>::respond_with_addresses(
+    const llmnr_header *const query, const uint8_t *const qname_end,
+    const vector<uint8_t> &name, const InRange &in_addresses,
+    const In6Range &in6_addresses, const sockaddr_in6 &sender,
+    const unsigned int interface_index)
+{
+    auto &&buffer = response_buffer();
+    buffer.assign(reinterpret_cast<const uint8_t *>(query), qname_end + 4);
 
     auto response = reinterpret_cast<llmnr_header *>(buffer.data());
     response->flags = htons(LLMNR_FLAG_QR);
@@ -438,17 +685,104 @@ void responder::respond_for_name(const int fd, const llmnr_header *const query,
             response->ancount = htons(ntohs(response->ancount) + 1);
         });
 
-    // Sends the response.
-    auto sent = sendto(fd, buffer.data(), buffer.size(), 0, &sender);
-    if (sent == -1 && errno == EMSGSIZE && buffer.size() > 512) {
-        // Resends the response with truncation.
-        response->flags |= htons(LLMNR_FLAG_TC);
-        sendto(fd, buffer.data(), 512, 0, &sender);
+    send_response(sender, interface_index);
+}
+
+template<class InterfaceManager, class OS>
+auto basic_responder<InterfaceManager, OS>::response_buffer()
+    -> vector<uint8_t> &
+{
+    // Each query has one response at most, but it is safe to flush.
+    if (_batch->response_count == BATCH_SIZE) {
+        flush_responses();
     }
+
+    auto &&buffer = _batch->responses[_batch->response_count].data;
+    buffer.clear();
+    return buffer;
 }
 
-auto responder::matching_host_name(const uint8_t *const qname) const
-    -> vector<uint8_t>
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::send_response(
+    const sockaddr_in6 &sender, const unsigned int interface_index)
+{
+    auto &&response = _batch->responses[_batch->response_count];
+    auto &&buffer = response.data;
+
+    // Responses are kept within the link MTU to avoid fragmentation.
+    auto &&interface = _interface_manager->find_interface(interface_index);
+    if (interface != nullptr && interface->mtu >= IPV6_MIN_MTU) {
+        auto &&size_limit = size_t(interface->mtu - IPV6_UDP_OVERHEAD);
+        if (buffer.size() > size_limit) {
+            truncate_response(buffer, size_limit);
+        }
+    }
+
+    response.recipient = sender;
+    _batch->response_count += 1;
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::flush_responses()
+{
+    auto &&count = _batch->response_count;
+    for (size_t i = 0; i != count; ++i) {
+        auto &&response = _batch->responses[i];
+        response.iov = {
+            response.data.data(), // .iov_base
+            response.data.size(), // .iov_len
+        };
+        _batch->response_headers[i] = {
+            {
+                &response.recipient,       // .msg_name
+                sizeof response.recipient, // .msg_namelen
+                &response.iov,             // .msg_iov
+                1,                         // .msg_iovlen
+                nullptr,                   // .msg_control
+                0,                         // .msg_controllen
+                0,                         // .msg_flags
+            },
+            0, // .msg_len
+        };
+    }
+
+    size_t i = 0;
+    while (i != count) {
+        auto &&sent = _os->sendmmsg(_udp6, &_batch->response_headers[i],
+            count - i, 0);
+        if (sent == -1) {
+            auto &&response = _batch->responses[i];
+            if (errno == EMSGSIZE && response.data.size() > 512) {
+                // Resends the response with truncation.
+                truncate_response(response.data, 512);
+                response.iov.iov_len = response.data.size();
+                continue;
+            }
+            if (errno != EINTR) {
+                syslog(LOG_ERR,
+                    "could not send a response: %s", strerror(errno));
+                i += 1;
+            }
+            continue;
+        }
+        if (sent > 0 && _first_answer_time.load() < 0) {
+            auto &&elapsed = duration_cast<microseconds>(
+                _os->steady_time() - _start_time).count();
+            int64_t expected = -1;
+            if (_first_answer_time.compare_exchange_strong(expected,
+                elapsed)) {
+                syslog(LOG_INFO, "first answer %.3f ms after start",
+                    elapsed / 1000.0);
+            }
+        }
+        i += sent;
+    }
+    _batch->response_count = 0;
+}
+
+template<class InterfaceManager, class OS>
+auto basic_responder<InterfaceManager, OS>::matching_host_name(
+    const uint8_t *const qname) const -> vector<uint8_t>
 {
     array<char, LLMNR_LABEL_MAX + 1> host_name;
     gethostname(host_name.data(), host_name.size());
@@ -481,44 +815,134 @@ auto responder::matching_host_name(const uint8_t *const qname) const
     return name;
 }
 
-void responder::interface_enabled(const interface_event &event)
+template<class InterfaceManager, class OS>
+auto basic_responder<InterfaceManager, OS>::matching_name(
+    const uint8_t *const qname, const unsigned int interface_index) const
+    -> vector<uint8_t>
+{
+    // The snapshot is kept alive while its names are used.
+    auto &&scopes = shared_ptr<const interface_scope_table>();
+    auto &&names = &_unscoped_names;
+    if (_scoped) {
+        scopes = _interface_scopes.load();
+        auto &&scope = scopes->find(interface_index);
+        if (scope != nullptr) {
+            names = &(*scope)->names;
+        }
+    }
+
+    for (auto &&i : *names) {
+        auto &&name = _names[i].name;
+        if (name.empty()) {
+            auto &&host_name = matching_host_name(qname);
+            if (!host_name.empty()) {
+                return host_name;
+            }
+        }
+        else if (equal_names(qname, name)) {
+            return name;
+        }
+    }
+    return {};
+}
+
+template<class InterfaceManager, class OS>
+auto basic_responder<InterfaceManager, OS>::interface_name(
+    const unsigned int interface_index) const -> string
+{
+    auto &&interface = _interface_manager->find_interface(interface_index);
+    if (interface != nullptr && !interface->name.empty()) {
+        return interface->name;
+    }
+    return "#" + to_string(interface_index);
+}
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::interface_enabled(
+    const interface_event &event)
 {
     if (event.interface_index != 0) {
-        array<char, IF_NAMESIZE> interface_name = {'?'};
-        if_indextoname(event.interface_index, interface_name.data());
+        auto &&interface_name = this->interface_name(event.interface_index);
 
-        const ipv6_mreq mr {
-            in6addr_mc_llmnr,      // .ipv6mr_multiaddr
-            event.interface_index, // .ipv6mr_interface
-        };
-        if (setsockopt(_udp6, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mr) == 0) {
+        auto &&scope = make_shared<interface_scope>();
+        for (size_t i = 0; i != _names.size(); ++i) {
+            if (_names[i].matches_interface(interface_name.c_str())) {
+                scope->names.push_back(i);
+            }
+        }
+        {
+            lock_guard<decltype(_interface_scopes_mutex)> lock
+                {_interface_scopes_mutex};
+
+            _working_interface_scopes.insert_or_assign(event.interface_index,
+                move(scope));
+            _interface_scopes_modified = true;
+        }
+
+        if (_memberships.join(event.interface_index)) {
             syslog(LOG_NOTICE, "joined the IPv6 LLMNR multicast group on %s",
-                interface_name.data());
+                interface_name.c_str());
         }
         else {
-            syslog(LOG_ERR, "could not join the IPv6 LLMNR multicast group on %s",
-                interface_name.data());
+            syslog(LOG_ERR,
+                "could not join the IPv6 LLMNR multicast group on %s: %s",
+                interface_name.c_str(), strerror(errno));
+        }
+
+        // Any earlier failure may have been temporary.
+        auto &&retried = _memberships.retry();
+        if (retried != 0) {
+            syslog(LOG_NOTICE,
+                "joined the IPv6 LLMNR multicast group on %zu more interfaces",
+                retried);
         }
     }
 }
 
-void responder::interface_disabled(const interface_event &event)
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::interface_disabled(
+    const interface_event &event)
 {
     if (event.interface_index != 0) {
-        array<char, IF_NAMESIZE> interface_name = {'?'};
-        if_indextoname(event.interface_index, interface_name.data());
+        auto &&interface_name = this->interface_name(event.interface_index);
 
-        const ipv6_mreq mr {
-            in6addr_mc_llmnr,      // .ipv6mr_multiaddr
-            event.interface_index, // .ipv6mr_interface
-        };
-        if (setsockopt(_udp6, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &mr) == 0) {
-            syslog(LOG_NOTICE, "left the IPv6 LLMNR multicast group on %s",
-                interface_name.data());
+        {
+            lock_guard<decltype(_interface_scopes_mutex)> lock
+                {_interface_scopes_mutex};
+
+            if (_working_interface_scopes.erase(event.interface_index)) {
+                _interface_scopes_modified = true;
+            }
         }
-        else {
-            syslog(LOG_ERR, "could not leave the IPv6 LLMNR multicast group on %s",
-                interface_name.data());
+
+        if (_memberships.leave(event.interface_index)) {
+            syslog(LOG_NOTICE, "left the IPv6 LLMNR multicast group on %s",
+                interface_name.c_str());
         }
     }
 }
+
+template<class InterfaceManager, class OS>
+void basic_responder<InterfaceManager, OS>::interface_events_dispatched(
+    interface_manager *)
+{
+    lock_guard<decltype(_interface_scopes_mutex)> lock
+        {_interface_scopes_mutex};
+
+    if (_interface_scopes_modified) {
+        // Scopes are shared between snapshots, so only pointers are copied.
+        _interface_scopes.store(
+            make_shared<const interface_scope_table>(
+                _working_interface_scopes));
+        _interface_scopes_modified = false;
+    }
+}
+
+// Explicit instantiations.
+
+template class basic_responder<interface_manager, posix>;
+template class basic_responder<rtnetlink_interface_manager, native_posix>;
+
+#if XLLMNRD_NETNS
+template class basic_responder<rtnetlink_interface_manager, netns_posix>;
+#endif
@@ -21,65 +21,331 @@
 
 #include "llmnr_packet.h"
 #include "interface.h"
+#include "membership.h"
+#include "posix.h"
+#include "rtnetlink.h"
+#include "netns_posix.h"
+#include "hosts.h"
+#include "zone.h"
+#include "shared_snapshot.h"
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <unistd.h>
+#include <array>
 #include <vector>
+#include <string>
+#include <mutex>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <cstdint>
 
+using xllmnrd::hosts_file;
+using xllmnrd::hosts_table;
 using xllmnrd::interface_event;
 using xllmnrd::interface_listener;
 using xllmnrd::interface_manager;
+using xllmnrd::membership_pool;
+using xllmnrd::native_posix;
+using xllmnrd::posix;
+using xllmnrd::zone_file;
 
 
+/**
+ * Names for which a responder answers.
+ */
+struct scoped_name
+{
+    /// Name in the wire format, or empty for the host name.
+    std::vector<std::uint8_t> name;
+
+    /// Interface name patterns to which the name is scoped, or empty for all.
+    std::vector<std::string> interfaces;
+
+    /**
+     * Returns true if the name is answered on an interface.
+     *
+     * @param interface_name the name of an interface
+     */
+    bool matches_interface(const char *interface_name) const;
+};
+
+/**
+ * Returns the operating system interface used unless one is given.
+ */
+template<class OS>
+inline std::shared_ptr<OS> make_default_os()
+{
+    return std::make_shared<OS>();
+}
+
+template<>
+inline std::shared_ptr<posix> make_default_os<posix>()
+{
+    return std::make_shared<native_posix>();
+}
+
 /**
  * LLMNR responder objects.
+ *
+ * The interface manager and the operating system interface are given as
+ * template parameters.  If they are final classes, calls to them on the
+ * query path need no virtual dispatch; otherwise any subclasses, such as
+ * mocks, can be used.
  */
-class responder: public interface_listener
+template<class InterfaceManager, class OS>
+class basic_responder: public interface_listener
 {
+public:
+
+    /// Maximum number of packets received or sent by a single system call.
+    static constexpr std::size_t BATCH_SIZE = 16;
+
+    /// Size of the buffer for each query.
+    ///
+    /// Any longer query is truncated, which leaves its question intact.
+    static constexpr std::size_t QUERY_BUFFER_SIZE = 1536;
+
 private:
 
-    std::shared_ptr<interface_manager> _interface_manager;
+    /// Scope of names for an interface.
+    struct interface_scope
+    {
+        /// Indices of the names answered on the interface.
+        std::vector<std::size_t> names;
+    };
+
+    /// Table from interface indices to name scopes.
+    using interface_scope_table =
+        xllmnrd::ifindex_map<std::shared_ptr<const interface_scope>>;
+
+    /// Query received in a batch.
+    struct query_slot
+    {
+        std::array<std::uint8_t, QUERY_BUFFER_SIZE> data;
+
+        sockaddr_in6 sender;
+
+        iovec iov;
+
+        std::array<char, 128> control;
+    };
+
+    /// Response queued in a batch.
+    struct response_slot
+    {
+        /// Response data, whose capacity is kept for reuse.
+        std::vector<std::uint8_t> data;
+
+        sockaddr_in6 recipient;
+
+        iovec iov;
+    };
+
+    /// Buffers for batched I/O on the UDP socket, which are allocated once
+    /// and reused by each call to 'process_udp6'.
+    struct udp6_batch
+    {
+        std::array<query_slot, BATCH_SIZE> queries;
+
+        std::array<mmsghdr, BATCH_SIZE> query_headers;
+
+        std::array<response_slot, BATCH_SIZE> responses;
+
+        std::array<mmsghdr, BATCH_SIZE> response_headers;
+
+        /// Number of responses queued.
+        std::size_t response_count = 0;
+    };
+
+    std::shared_ptr<InterfaceManager> _interface_manager;
+
+    /// Operating system interface to open sockets.
+    std::shared_ptr<OS> _os;
 
     int _udp6 = -1;
 
+    /// Batch buffers, used only by the thread that processes the socket.
+    std::unique_ptr<udp6_batch> _batch;
+
     std::atomic<bool> _running {false};
 
+    /// True if a statistics report is requested.
+    std::atomic<bool> _statistics_requested {false};
+
+    /// True if the responder loop is entered before the first refresh of
+    /// the interfaces completes.
+    bool _asynchronous_startup = false;
+
+    /// True if the responder is driven by an external event loop.
+    bool _externally_driven = false;
+
+    /// Time when the responder loop was entered.
+    std::chrono::steady_clock::time_point _start_time;
+
+    /// Time from the start to the first answer in microseconds, or -1 if
+    /// nothing has been answered.
+    mutable std::atomic<std::int64_t> _first_answer_time {-1};
+
+    /// Memberships of the LLMNR multicast group.
+    membership_pool _memberships;
+
+    /// Names to respond for.
+    std::vector<scoped_name> _names;
+
+    /// Indices of the names answered on any interface.
+    std::vector<std::size_t> _unscoped_names;
+
+    /// Indicates if any name is scoped to interfaces.
+    bool _scoped = false;
+
+    /// Last published table of the name scopes of the enabled interfaces.
+    ///
+    /// Queries read it without locks so that they never wait for interface
+    /// events.
+    xllmnrd::shared_snapshot<interface_scope_table> _interface_scopes;
+
+    /// Working table of the name scopes, which is guarded by the mutex and
+    /// published once for each run of interface events.
+    interface_scope_table _working_interface_scopes;
+
+    /// Indicates if the working table has been changed since it was last
+    /// published, which is guarded by the mutex.
+    bool _interface_scopes_modified = false;
+
+    /// Mutex for updates of the name scopes.
+    std::mutex _interface_scopes_mutex;
+
+    /// Hosts file source, or null if not used.
+    std::shared_ptr<hosts_file> _hosts;
+
+    /// Binary zone file, or null if not used.
+    std::shared_ptr<const zone_file> _zone;
+
 protected:
 
     /**
      * Opens an IPv6 UDP socket for LLMNR.
      *
+     * @param os an operating system interface to open the socket
      * @param port a port to bind the socket, in network byte order.
      */
     [[nodiscard]]
-    static int open_udp6(in_port_t port);
+    static int open_udp6(const std::shared_ptr<OS> &os, in_port_t port);
 
 public:
 
-    responder();
-
-    explicit responder(in_port_t port);
-
-    responder(in_port_t port,
-        const std::shared_ptr<interface_manager> &interface_manager);
+    /**
+     * Constructs a responder object.
+     *
+     * @param port a port in network byte order
+     * @param interface_manager an interface manager
+     * @param names names to respond for, where an empty one is the host name
+     * @param os an operating system interface to open sockets, which may
+     * place them in another network namespace
+     */
+    basic_responder(in_port_t port,
+        const std::shared_ptr<InterfaceManager> &interface_manager,
+        const std::vector<scoped_name> &names = {scoped_name {}},
+        const std::shared_ptr<OS> &os = make_default_os<OS>());
 
     // This class is not copy-constructible.
-    responder(const responder &) = delete;
+    basic_responder(const basic_responder &) = delete;
 
 
-    virtual ~responder();
+    virtual ~basic_responder();
 
 
     // This class is not copy-assignable.
-    void operator =(const responder &) = delete;
+    void operator =(const basic_responder &) = delete;
+
+
+    /**
+     * Sets a hosts file source for additional names.
+     *
+     * This function must be called before the responder loop is entered.
+     */
+    void set_hosts_file(const std::shared_ptr<hosts_file> &hosts)
+    {
+        _hosts = hosts;
+    }
 
+    /**
+     * Sets a binary zone file for static records.
+     *
+     * This function must be called before the responder loop is entered.
+     */
+    void set_zone_file(const std::shared_ptr<const zone_file> &zone)
+    {
+        _zone = zone;
+    }
 
     /**
-     * Enters the responder loop.
+     * Sets whether the responder loop is entered without waiting for the
+     * first refresh of the interfaces.
+     *
+     * In the asynchronous startup, each interface is answered as soon as
+     * its addresses are known, and queries on interfaces whose addresses
+     * are not known yet are ignored until the refresh completes.
+     * This function must be called before the responder loop is entered.
+     */
+    void set_asynchronous_startup(bool asynchronous)
+    {
+        _asynchronous_startup = asynchronous;
+    }
+
+    /**
+     * Sets whether the responder is driven by an external event loop
+     * instead of 'run'.
+     *
+     * The UDP socket is then read without blocking, so that a readiness
+     * reported by 'poll' for a datagram discarded later, for example for
+     * its checksum, never blocks the event loop.  This function must be
+     * called before the responder loop is entered.
+     */
+    void set_externally_driven(bool externally_driven)
+    {
+        _externally_driven = externally_driven;
+    }
+
+    /**
+     * Returns the time from the start of the responder loop to the first
+     * answer, or a negative value if nothing has been answered.
+     *
+     * This function is thread-safe.
+     */
+    std::chrono::microseconds first_answer_time() const
+    {
+        return std::chrono::microseconds(_first_answer_time.load());
+    }
+
+    /// Returns the file descriptor of the UDP socket.
+    int udp6_socket() const
+    {
+        return _udp6;
+    }
+
+    /**
+     * Refreshes the interfaces and starts the clock for the first answer.
+     *
+     * This function is called by 'run' or by an external event loop.
+     */
+    void start();
+
+    /**
+     * Refreshes the interfaces and enters the responder loop.
      */
     void run();
 
+    /**
+     * Receives a batch of packets on the UDP socket and responds to them.
+     *
+     * This function blocks until a packet is available unless the
+     * responder is externally driven, in which case it returns at once if
+     * nothing is available.
+     */
+    void process_udp6();
+
     /**
      * Requests termination of the responder loop.
      *
@@ -87,19 +353,81 @@ public:
      */
     void terminate();
 
+    /**
+     * Requests a statistics report from the responder loop.
+     *
+     * This function is to be called by signal handlers.
+     */
+    void request_statistics()
+    {
+        _statistics_requested = true;
+    }
+
+    /**
+     * Reports the numbers of interfaces and multicast memberships and the
+     * time to the first answer to the system log.
+     */
+    void report_statistics() const;
+
 protected:
 
-    void process_udp6() const;
+    /**
+     * Receives up to 'BATCH_SIZE' packets into the batch buffers.
+     *
+     * @return the number of packets received, or -1 on error
+     */
+    int receive_udp6();
 
-    ssize_t recv_udp6(void *buffer, size_t buffer_size, sockaddr_in6 &sender,
-        unsigned int &ifindex) const;
+    /**
+     * Handles a packet received in the batch buffers.
+     */
+    void handle_udp6_packet(const mmsghdr &header);
 
     void handle_udp6_query(const llmnr_header *query, size_t query_size,
-        const sockaddr_in6 &sender, unsigned int ifindex) const;
+        const sockaddr_in6 &sender, unsigned int ifindex);
+
+    void respond_for_name(const llmnr_header *query,
+        const uint8_t *qname_end, const std::vector<std::uint8_t> &name,
+        const sockaddr_in6 &sender, unsigned int interface_index);
 
-    void respond_for_name(int fd, const llmnr_header *query,
+    void respond_for_hosts_entry(const llmnr_header *query,
+        const uint8_t *qname, const uint8_t *qname_end,
+        const hosts_table &table, const hosts_table::entry &entry,
+        const sockaddr_in6 &sender, unsigned int interface_index);
+
+    /**
+     * Queues a response with pre-serialized records from a zone file.
+     */
+    void respond_with_records(const llmnr_header *query,
+        const uint8_t *qname_end, const zone_file::records &records,
+        const sockaddr_in6 &sender, unsigned int interface_index);
+
+    /**
+     * Queues a response with addresses.
+     */
+    template<class InRange, class In6Range>
+    void respond_with_addresses(const llmnr_header *query,
         const uint8_t *qname_end, const std::vector<std::uint8_t> &name,
-        const sockaddr_in6 &sender, unsigned int interface_index) const;
+        const InRange &in_addresses, const In6Range &in6_addresses,
+        const sockaddr_in6 &sender, unsigned int interface_index);
+
+    /**
+     * Returns an empty buffer for the next response in the batch.
+     */
+    std::vector<std::uint8_t> &response_buffer();
+
+    /**
+     * Queues the response in the buffer returned by 'response_buffer',
+     * truncating it if it does not fit in the link MTU.
+     */
+    void send_response(const sockaddr_in6 &sender,
+        unsigned int interface_index);
+
+    /**
+     * Sends the queued responses, resending any response with truncation
+     * if it is too large.
+     */
+    void flush_responses();
 
     /**
      * Returns the matching host name, or an empty vector if nothing matches.
@@ -107,11 +435,54 @@ protected:
     auto matching_host_name(const std::uint8_t *qname) const
         -> std::vector<std::uint8_t>;
 
+    /**
+     * Returns the matching name answered on an interface, or an empty vector
+     * if nothing matches.
+     */
+    auto matching_name(const std::uint8_t *qname,
+        unsigned int interface_index) const -> std::vector<std::uint8_t>;
+
+    /**
+     * Returns the name of an interface for logging and scoping.
+     */
+    std::string interface_name(unsigned int interface_index) const;
+
 public:
 
     void interface_enabled(const interface_event &event) override;
 
     void interface_disabled(const interface_event &event) override;
+
+    /**
+     * Publishes the name scopes changed by a run of interface events.
+     *
+     * Until then, queries on a newly enabled interface are answered only for
+     * the names not scoped to interfaces.
+     */
+    void interface_events_dispatched(interface_manager *source) override;
 };
 
+/// Responder that works with any interface manager and operating system
+/// interface.
+using responder = basic_responder<interface_manager, posix>;
+
+/// Responder for the daemon.
+using native_responder = basic_responder<
+    xllmnrd::rtnetlink_interface_manager, native_posix>;
+
+extern template class basic_responder<interface_manager, posix>;
+extern template class basic_responder<xllmnrd::rtnetlink_interface_manager,
+    native_posix>;
+
+#if XLLMNRD_NETNS
+
+/// Responder for a network namespace.
+using netns_responder = basic_responder<
+    xllmnrd::rtnetlink_interface_manager, xllmnrd::netns_posix>;
+
+extern template class basic_responder<xllmnrd::rtnetlink_interface_manager,
+    xllmnrd::netns_posix>;
+
+#endif
+
 #endif
@@ -0,0 +1,96 @@
+// responder_group.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "responder_group.h"
+
+#include <poll.h>
+#include <syslog.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+using std::move;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::strerror;
+using std::unique_ptr;
+using std::vector;
+using xllmnrd::rtnetlink_interface_manager;
+
+void responder_group::add(const string &netns,
+    const shared_ptr<rtnetlink_interface_manager> &interface_manager,
+    unique_ptr<responder_type> responder)
+{
+    _members.push_back({netns, interface_manager, move(responder), 0});
+}
+
+void responder_group::run()
+{
+    _running = true;
+    for (auto &&i : _members) {
+        i.responder->start();
+    }
+
+    auto &&fds = vector<pollfd>();
+    while (_running) {
+        fds.clear();
+
+        // Each member has its UDP socket followed by those of its manager.
+        int timeout = -1;
+        for (auto &&i : _members) {
+            fds.push_back({i.responder->udp6_socket(), POLLIN, 0});
+
+            pollfd manager_fds[rtnetlink_interface_manager::MAX_POLL_DESCRIPTORS];
+            int manager_timeout = -1;
+            i.poll_count = i.interface_manager->get_poll_descriptors(
+                manager_fds, manager_timeout);
+            fds.insert(fds.end(), manager_fds, manager_fds + i.poll_count);
+            if (manager_timeout >= 0
+                && (timeout < 0 || manager_timeout < timeout)) {
+                timeout = manager_timeout;
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), timeout) == -1 && errno != EINTR) {
+            syslog(LOG_ERR, "could not poll sockets: %s", strerror(errno));
+            break;
+        }
+
+        auto &&fd = fds.data();
+        for (auto &&i : _members) {
+            if (fd->revents != 0) {
+                i.responder->process_udp6();
+            }
+            // This must be called even if nothing is ready.
+            i.interface_manager->process_poll(fd + 1, i.poll_count);
+            fd += 1 + i.poll_count;
+        }
+
+        if (_statistics_requested.exchange(false)) {
+            for (auto &&i : _members) {
+                syslog(LOG_INFO, "network namespace %s:", i.netns.c_str());
+                i.responder->report_statistics();
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// responder_group.h -*- C++ -*-
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef RESPONDER_GROUP_H
+#define RESPONDER_GROUP_H 1
+
+#include "responder.h"
+#include "rtnetlink.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+/**
+ * Group of responders for network namespaces, which are driven by a single
+ * event loop on the calling thread.
+ *
+ * Each member has its own interface manager and responder, whose sockets
+ * are opened in its namespace, but no thread of its own.
+ */
+class responder_group
+{
+public:
+
+#if XLLMNRD_NETNS
+    /// Responder type of the members.
+    using responder_type = netns_responder;
+#else
+    // Without network namespaces, no group is built, but this class still
+    // compiles with the generic form.
+    using responder_type = responder;
+#endif
+
+private:
+
+    /// Responder and interface manager for a network namespace.
+    struct member
+    {
+        std::string netns;
+
+        std::shared_ptr<xllmnrd::rtnetlink_interface_manager>
+            interface_manager;
+
+        std::unique_ptr<responder_type> responder;
+
+        /// Number of descriptors polled for the interface manager.
+        std::size_t poll_count;
+    };
+
+    std::vector<member> _members;
+
+    std::atomic<bool> _running {false};
+
+    /// True if a statistics report is requested.
+    std::atomic<bool> _statistics_requested {false};
+
+public:
+
+    responder_group() = default;
+
+    // This class is not copy-constructible.
+    responder_group(const responder_group &) = delete;
+
+
+    // This class is not copy-assignable.
+    void operator =(const responder_group &) = delete;
+
+
+    /**
+     * Adds a member for a network namespace.
+     *
+     * The interface manager and the responder must be externally driven,
+     * and the responder must use the interface manager.
+     *
+     * @param netns the name of the network namespace for logging
+     */
+    void add(const std::string &netns,
+        const std::shared_ptr<xllmnrd::rtnetlink_interface_manager>
+            &interface_manager,
+        std::unique_ptr<responder_type> responder);
+
+    /**
+     * Starts all the responders and enters the event loop.
+     */
+    void run();
+
+    /**
+     * Requests termination of the event loop.
+     *
+     * This function is to be called by signal handlers.
+     */
+    void terminate()
+    {
+        _running = false;
+    }
+
+    /**
+     * Requests a statistics report of all the responders.
+     *
+     * This function is to be called by signal handlers.
+     */
+    void request_statistics()
+    {
+        _statistics_requested = true;
+    }
+};
+
+#endif
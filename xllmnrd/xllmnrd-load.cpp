@@ -0,0 +1,923 @@
+// xllmnrd-load.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program sends LLMNR queries to a responder at a given rate and mix
+// and reports the throughput, loss and latency measured with kernel
+// timestamps.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "llmnr_packet.h"
+#include "llmnr.h"
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cinttypes>
+#include <cmath>
+#include <cerrno>
+
+using std::array;
+using std::discrete_distribution;
+using std::fprintf;
+using std::minstd_rand;
+using std::printf;
+using std::size_t;
+using std::sort;
+using std::string;
+using std::strerror;
+using std::to_string;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::int64_t;
+using std::vector;
+using namespace std::chrono;
+
+/// Kinds of queries in a mix.
+enum query_kind
+{
+    KIND_A,
+    KIND_AAAA,
+    KIND_ANY,
+    KIND_MISS,
+    KIND_BAD,
+    KIND_COUNT,
+};
+
+/// Names of the kinds of queries for the '--mix' option.
+static const array<const char *, KIND_COUNT> KIND_NAMES {
+    "a", "aaaa", "any", "miss", "bad",
+};
+
+/// Maximum number of messages that 'sendmmsg' takes.
+static const unsigned int MAX_BATCH = 1024;
+
+/// Number of query IDs, which limits the queries that may be in flight.
+static const double ID_COUNT = 65536;
+
+/// Options of the program.
+struct load_options
+{
+    /// Queries per second, or zero for no limit.
+    double rate = 1000;
+
+    /// Seconds to send queries.
+    double duration = 10;
+
+    /// Maximum number of queries sent by a single system call.
+    unsigned int batch = 16;
+
+    /// Milliseconds to wait for late responses.
+    unsigned int wait = 1000;
+
+    /// Name to query, which defaults to the host name.
+    string name;
+
+    /// Weights of the kinds of queries.
+    array<double, KIND_COUNT> mix {0, 1, 0, 0, 0};
+
+    in_port_t port = htons(LLMNR_PORT);
+};
+
+/// Record of a query.
+struct query_record
+{
+    query_kind kind;
+
+    /// Time before the query was passed to the kernel, or zero if it could
+    /// not be sent.
+    int64_t send_time = 0;
+
+    /// Kernel timestamp of the query sent, or zero if unknown.
+    int64_t tx_time = 0;
+
+    /// Time when the first response was received, or zero if none.
+    int64_t rx_time = 0;
+};
+
+/**
+ * Returns a time in nanoseconds.
+ */
+inline int64_t to_nanoseconds(const timespec &t)
+{
+    return int64_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * Returns the time of the clock that kernel timestamps use.
+ */
+inline int64_t realtime_now()
+{
+    timespec t {};
+    clock_gettime(CLOCK_REALTIME, &t);
+    return to_nanoseconds(t);
+}
+
+/**
+ * Prints the version information.
+ */
+inline void print_version()
+{
+    printf("xllmnrd-load (%s) %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+    printf("Copyright (C) 2013-2021 Kaz Nishimura\n");
+    printf("\
+This is free software: you are free to change and redistribute it.\n\
+There is NO WARRANTY, to the extent permitted by law.\n");
+}
+
+/**
+ * Prints the command usage.
+ *
+ * @param arg0 the command name
+ */
+inline void print_usage(const char *const arg0)
+{
+    printf("Usage: %s [OPTION]... [ADDRESS]\n", arg0);
+    printf("Send LLMNR queries to ADDRESS (::1 by default) and report the "
+        "throughput,\nloss and latency of the responses.\n");
+    printf("\n");
+    printf("  -r, --rate=QPS        send QPS queries per second "
+        "(0 for no limit)\n");
+    printf("  -d, --duration=SEC    send queries for SEC seconds\n");
+    printf("  -b, --batch=N         send up to N queries per system call\n");
+    printf("  -n, --name=NAME       query NAME instead of the host name\n");
+    printf("  -m, --mix=KIND:WEIGHT[,KIND:WEIGHT]...\n");
+    printf("                        mix queries of KIND by WEIGHT\n");
+    printf("  -w, --wait=MSEC       wait MSEC milliseconds for late "
+        "responses\n");
+    printf("  -p, --port=PORT       send queries to PORT\n");
+    printf("      --help            display this help and exit\n");
+    printf("      --version         output version information and exit\n");
+    printf("\n");
+    printf("KIND is one of 'a', 'aaaa' and 'any' for queries of NAME, "
+        "'miss' for queries\nof other names and 'bad' for malformed "
+        "packets.  The default mix is 'aaaa:1'.\n");
+    printf("ADDRESS may be a multicast or link-local address with a zone "
+        "such as\n'ff02::1:3%%eth0'.\n");
+    printf("\n");
+    printf("Report bugs to <%s>.\n", PACKAGE_BUGREPORT);
+}
+
+/**
+ * Parses a mix of kinds of queries.
+ *
+ * @return true if parsed, or false otherwise
+ */
+static bool parse_mix(const char *spec, array<double, KIND_COUNT> &mix)
+{
+    mix.fill(0);
+    auto &&items = string(spec);
+    size_t start = 0;
+    while (start <= items.size()) {
+        auto &&end = items.find(',', start);
+        if (end == string::npos) {
+            end = items.size();
+        }
+        auto &&item = items.substr(start, end - start);
+        auto &&colon = item.find(':');
+        auto &&kind = item.substr(0, colon);
+        double weight = 1;
+        if (colon != string::npos) {
+            char *weight_end = nullptr;
+            weight = std::strtod(item.c_str() + colon + 1, &weight_end);
+            if (*weight_end != '\0' || weight < 0) {
+                return false;
+            }
+        }
+
+        auto &&found = std::find_if(KIND_NAMES.begin(), KIND_NAMES.end(),
+            [&kind](const char *name) {
+                return kind == name;
+            });
+        if (found == KIND_NAMES.end()) {
+            return false;
+        }
+        mix[found - KIND_NAMES.begin()] = weight;
+        start = end + 1;
+    }
+    return std::any_of(mix.begin(), mix.end(), [](double weight) {
+        return weight > 0;
+    });
+}
+
+/**
+ * Builds a query of a kind.
+ *
+ * Malformed packets rotate among a short header, a response and a name
+ * that overruns the packet.
+ */
+static void make_query(vector<uint8_t> &packet, const uint32_t sequence,
+    const query_kind kind, const string &name)
+{
+    packet.assign(LLMNR_HEADER_SIZE, 0);
+    packet[0] = sequence >> 8;
+    packet[1] = sequence;
+    packet[5] = 1; // qdcount
+
+    auto label = name;
+    uint16_t qtype = LLMNR_QTYPE_AAAA;
+    switch (kind) {
+    case KIND_A:
+        qtype = LLMNR_QTYPE_A;
+        break;
+    case KIND_ANY:
+        qtype = LLMNR_QTYPE_ANY;
+        break;
+    case KIND_MISS:
+        label = "xllmnrd-load-" + to_string(sequence);
+        break;
+    case KIND_BAD:
+        switch (sequence % 3) {
+        case 0:
+            packet.resize(LLMNR_HEADER_SIZE / 2);
+            return;
+        case 1:
+            packet[2] = LLMNR_FLAG_QR >> 8;
+            break;
+        default:
+            packet.push_back(LLMNR_LABEL_MAX);
+            packet.insert(packet.end(), label.begin(), label.end());
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    packet.push_back(label.size());
+    packet.insert(packet.end(), label.begin(), label.end());
+    packet.push_back(0);
+    packet.push_back(qtype >> 8);
+    packet.push_back(qtype & 0xff);
+    packet.push_back(LLMNR_QCLASS_IN >> 8);
+    packet.push_back(LLMNR_QCLASS_IN & 0xff);
+}
+
+/**
+ * Load generator on a UDP socket.
+ */
+class load_generator
+{
+private:
+
+    /// Capacity of the buffer for each packet.
+    static constexpr size_t PACKET_CAPACITY = 1536;
+
+    /// Buffers for a batch of packets.
+    struct slot
+    {
+        vector<uint8_t> data;
+
+        iovec iov;
+
+        sockaddr_in6 address;
+
+        array<char, 256> control;
+    };
+
+    const load_options &_options;
+
+    sockaddr_in6 _target;
+
+    int _udp6 = -1;
+
+    /// True if kernel timestamps are enabled.
+    bool _timestamping = false;
+
+    /// Records of the queries in order of their IDs.
+    vector<query_record> _records;
+
+    /// Indices of the records of the queries sent, which are keyed by the
+    /// transmit timestamps.
+    vector<uint32_t> _sent;
+
+    vector<slot> _slots;
+
+    vector<mmsghdr> _headers;
+
+    minstd_rand _random;
+
+    discrete_distribution<int> _kinds;
+
+    uint64_t _send_errors = 0;
+
+    uint64_t _unexpected = 0;
+
+    uint64_t _duplicates = 0;
+
+public:
+
+    load_generator(const load_options &options, const sockaddr_in6 &target)
+    :
+        _options {options},
+        _target {target},
+        _slots(options.batch),
+        _headers(options.batch),
+        _kinds(options.mix.begin(), options.mix.end())
+    {
+        for (auto &&i : _slots) {
+            i.data.reserve(PACKET_CAPACITY);
+        }
+    }
+
+    // This class is not copy-constructible.
+    load_generator(const load_generator &) = delete;
+
+    ~load_generator()
+    {
+        if (_udp6 != -1) {
+            close(_udp6);
+        }
+    }
+
+    // This class is not copy-assignable.
+    void operator =(const load_generator &) = delete;
+
+    /**
+     * Opens the socket.
+     *
+     * @return 0 on success, or an error number
+     */
+    int open();
+
+    /**
+     * Sends queries for a duration and waits for late responses.
+     *
+     * @return the time spent sending queries
+     */
+    nanoseconds run();
+
+    /**
+     * Prints the results.
+     *
+     * @param elapsed the time spent sending queries
+     */
+    void report(nanoseconds elapsed) const;
+
+protected:
+
+    /// Sends a batch of queries.
+    void send_batch(size_t count);
+
+    /**
+     * Receives responses and transmit timestamps for up to a timeout.
+     *
+     * @param timeout a timeout, or zero not to block
+     */
+    void receive(nanoseconds timeout);
+
+    /// Receives the available responses.
+    void receive_responses();
+
+    /// Receives the available transmit timestamps.
+    void receive_timestamps();
+
+    /// Returns the record of a response by its ID, or null.
+    query_record *find_record(uint16_t id);
+
+    /// Prepares the headers of a batch for receiving.
+    void prepare_receive();
+};
+
+int load_generator::open()
+{
+    _udp6 = socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (_udp6 == -1) {
+        return errno;
+    }
+
+    // A large buffer keeps responses and timestamps during bursts.
+    int buffer_size = 4 << 20;
+    setsockopt(_udp6, SOL_SOCKET, SO_RCVBUF, &buffer_size,
+        sizeof buffer_size);
+
+    static const int HOP_1 = 1;
+    setsockopt(_udp6, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &HOP_1,
+        sizeof HOP_1);
+
+    // Each transmit timestamp is keyed by the number of datagrams sent
+    // before it, which is the index of its record.
+    int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE
+        | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID
+        | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(_udp6, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags)
+        == 0) {
+        _timestamping = true;
+    }
+    else {
+        fprintf(stderr, "kernel timestamps not available: %s\n",
+            strerror(errno));
+    }
+    return 0;
+}
+
+nanoseconds load_generator::run()
+{
+    auto &&start = steady_clock::now();
+    auto &&end = start + duration_cast<nanoseconds>(
+        duration<double>(_options.duration));
+    auto &&interval = _options.rate > 0
+        ? duration<double, std::nano>(1e9 / _options.rate)
+        : duration<double, std::nano>(0);
+
+    while (true) {
+        auto &&now = steady_clock::now();
+        if (now >= end) {
+            break;
+        }
+
+        // Queries are paced from the start to avoid drift.
+        size_t count = _options.batch;
+        if (_options.rate > 0) {
+            auto &&due = size_t((now - start) / interval) + 1;
+            if (due <= _records.size()) {
+                auto &&next = start + duration_cast<nanoseconds>(
+                    interval * double(_records.size()));
+                receive(std::min(next, end) - now);
+                continue;
+            }
+            count = std::min(count, due - _records.size());
+        }
+
+        send_batch(count);
+        receive(nanoseconds(0));
+    }
+    auto &&elapsed = steady_clock::now() - start;
+
+    auto &&wait_end = steady_clock::now() + milliseconds(_options.wait);
+    auto now = steady_clock::now();
+    while (now < wait_end) {
+        receive(wait_end - now);
+        now = steady_clock::now();
+    }
+    return elapsed;
+}
+
+void load_generator::send_batch(const size_t count)
+{
+    auto &&first = uint32_t(_records.size());
+    for (size_t i = 0; i != count; ++i) {
+        auto &&kind = query_kind(_kinds(_random));
+        auto &&s = _slots[i];
+        make_query(s.data, first + i, kind, _options.name);
+        s.iov = {s.data.data(), s.data.size()};
+        _headers[i] = {
+            {
+                &_target,        // .msg_name
+                sizeof _target,  // .msg_namelen
+                &s.iov,          // .msg_iov
+                1,               // .msg_iovlen
+                nullptr,         // .msg_control
+                0,               // .msg_controllen
+                0,               // .msg_flags
+            },
+            0, // .msg_len
+        };
+
+        auto &&record = query_record {};
+        record.kind = kind;
+        _records.push_back(record);
+    }
+
+    size_t sent = 0;
+    while (sent != count) {
+        auto &&send_time = realtime_now();
+        auto &&result = sendmmsg(_udp6, &_headers[sent], count - sent, 0);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // The rest of the batch is dropped.
+            if (_send_errors == 0) {
+                fprintf(stderr, "could not send a query: %s\n",
+                    strerror(errno));
+            }
+            _send_errors += count - sent;
+            break;
+        }
+        for (int i = 0; i != result; ++i) {
+            _records[first + sent + i].send_time = send_time;
+            _sent.push_back(first + sent + i);
+        }
+        sent += result;
+    }
+}
+
+void load_generator::prepare_receive()
+{
+    for (size_t i = 0; i != _slots.size(); ++i) {
+        auto &&s = _slots[i];
+        s.data.resize(s.data.capacity());
+        s.iov = {s.data.data(), s.data.size()};
+        _headers[i] = {
+            {
+                &s.address,        // .msg_name
+                sizeof s.address,  // .msg_namelen
+                &s.iov,            // .msg_iov
+                1,                 // .msg_iovlen
+                s.control.data(),  // .msg_control
+                s.control.size(),  // .msg_controllen
+                0,                 // .msg_flags
+            },
+            0, // .msg_len
+        };
+    }
+}
+
+void load_generator::receive(const nanoseconds timeout)
+{
+    if (timeout > nanoseconds(0)) {
+        pollfd fd {_udp6, POLLIN, 0};
+        auto &&seconds = duration_cast<std::chrono::seconds>(timeout);
+        timespec t {};
+        t.tv_sec = seconds.count();
+        t.tv_nsec = duration_cast<nanoseconds>(timeout - seconds).count();
+        if (ppoll(&fd, 1, &t, nullptr) <= 0) {
+            return;
+        }
+    }
+
+    receive_responses();
+    if (_timestamping) {
+        receive_timestamps();
+    }
+}
+
+void load_generator::receive_responses()
+{
+    while (true) {
+        prepare_receive();
+        auto &&count = recvmmsg(_udp6, _headers.data(), _headers.size(),
+            MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return;
+        }
+
+        auto &&now = realtime_now();
+        for (int i = 0; i != count; ++i) {
+            auto &&msg = _headers[i].msg_hdr;
+            auto &&data = _slots[i].data.data();
+            if (_headers[i].msg_len < LLMNR_HEADER_SIZE
+                || (data[2] & (LLMNR_FLAG_QR >> 8)) == 0) {
+                continue;
+            }
+
+            auto &&rx_time = now;
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET
+                    && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                    auto &&stamps = reinterpret_cast<const scm_timestamping *>(
+                        CMSG_DATA(cmsg));
+                    rx_time = to_nanoseconds(stamps->ts[0]);
+                }
+            }
+
+            auto &&record = find_record((data[0] << 8) | data[1]);
+            if (record == nullptr || record->kind == KIND_MISS
+                || record->kind == KIND_BAD) {
+                _unexpected += 1;
+            }
+            else if (record->rx_time != 0) {
+                _duplicates += 1;
+            }
+            else {
+                record->rx_time = rx_time;
+            }
+        }
+    }
+}
+
+void load_generator::receive_timestamps()
+{
+    while (true) {
+        prepare_receive();
+        auto &&count = recvmmsg(_udp6, _headers.data(), _headers.size(),
+            MSG_ERRQUEUE | MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return;
+        }
+
+        for (int i = 0; i != count; ++i) {
+            auto &&msg = _headers[i].msg_hdr;
+            int64_t tx_time = 0;
+            const sock_extended_err *error = nullptr;
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET
+                    && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                    auto &&stamps = reinterpret_cast<const scm_timestamping *>(
+                        CMSG_DATA(cmsg));
+                    tx_time = to_nanoseconds(stamps->ts[0]);
+                }
+                else if (cmsg->cmsg_level == SOL_IPV6
+                    && cmsg->cmsg_type == IPV6_RECVERR) {
+                    error = reinterpret_cast<const sock_extended_err *>(
+                        CMSG_DATA(cmsg));
+                }
+            }
+            if (error != nullptr
+                && error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING
+                && error->ee_data < _sent.size() && tx_time != 0) {
+                _records[_sent[error->ee_data]].tx_time = tx_time;
+            }
+        }
+    }
+}
+
+query_record *load_generator::find_record(const uint16_t id)
+{
+    if (_records.empty()) {
+        return nullptr;
+    }
+
+    // The latest query with the ID is taken.
+    auto &&last = _records.size() - 1;
+    auto &&index = last - ((last - id) & 0xffff);
+    if (index > last) {
+        return nullptr;
+    }
+    return &_records[index];
+}
+
+/**
+ * Returns a percentile of sorted values by the nearest rank.
+ */
+inline double percentile(const vector<int64_t> &values, const double p)
+{
+    auto &&rank = size_t(std::ceil(p / 100 * values.size()));
+    return values[rank != 0 ? rank - 1 : 0] / 1000.0;
+}
+
+void load_generator::report(const nanoseconds elapsed) const
+{
+    array<uint64_t, KIND_COUNT> counts {};
+    uint64_t expected = 0;
+    uint64_t answered = 0;
+    uint64_t kernel_stamped = 0;
+    auto &&latencies = vector<int64_t>();
+    for (auto &&i : _records) {
+        if (i.send_time == 0) {
+            continue;
+        }
+        counts[i.kind] += 1;
+        if (i.kind == KIND_MISS || i.kind == KIND_BAD) {
+            continue;
+        }
+        expected += 1;
+        if (i.rx_time != 0) {
+            answered += 1;
+            auto tx_time = i.send_time;
+            if (i.tx_time != 0) {
+                tx_time = i.tx_time;
+                kernel_stamped += 1;
+            }
+            latencies.push_back(i.rx_time - tx_time);
+        }
+    }
+    sort(latencies.begin(), latencies.end());
+
+    auto &&seconds = duration<double>(elapsed).count();
+    printf("sent        %zu queries in %.3f s (%.0f/s)",
+        _sent.size(), seconds, _sent.size() / seconds);
+    auto separator = " -";
+    for (size_t i = 0; i != KIND_COUNT; ++i) {
+        if (counts[i] != 0) {
+            printf("%s %s %" PRIu64, separator, KIND_NAMES[i], counts[i]);
+            separator = ",";
+        }
+    }
+    printf("\n");
+    if (_send_errors != 0) {
+        printf("send errors %" PRIu64 "\n", _send_errors);
+    }
+    printf("answered    %" PRIu64 " of %" PRIu64 " (%.0f/s, loss %.2f%%)\n",
+        answered, expected, answered / seconds,
+        expected != 0 ? 100.0 * (expected - answered) / expected : 0.0);
+    printf("unexpected  %" PRIu64 " responses, %" PRIu64 " duplicates\n",
+        _unexpected, _duplicates);
+    if (!latencies.empty()) {
+        printf("latency     p50 %.1f us, p90 %.1f us, p99 %.1f us, "
+            "p99.9 %.1f us, max %.1f us\n",
+            percentile(latencies, 50), percentile(latencies, 90),
+            percentile(latencies, 99), percentile(latencies, 99.9),
+            latencies.back() / 1000.0);
+        printf("timestamps  %s receive, kernel send for %" PRIu64
+            " of %zu\n", _timestamping ? "kernel" : "user",
+            kernel_stamped, latencies.size());
+    }
+}
+
+/**
+ * Parses a target address.
+ *
+ * @return 0 on success, or an error code of 'getaddrinfo'
+ */
+static int parse_target(const char *address, const in_port_t port,
+    sockaddr_in6 &target)
+{
+    addrinfo hints {};
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    addrinfo *result = nullptr;
+    auto &&error = getaddrinfo(address, nullptr, &hints, &result);
+    if (error != 0) {
+        return error;
+    }
+    std::memcpy(&target, result->ai_addr, sizeof target);
+    target.sin6_port = port;
+    freeaddrinfo(result);
+    return 0;
+}
+
+/**
+ * Parses an unsigned integer option.
+ */
+static unsigned long parse_number(const char *arg0, const char *value,
+    const unsigned long max)
+{
+    char *end = nullptr;
+    errno = 0;
+    auto &&number = std::strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || errno != 0 || number > max) {
+        fprintf(stderr, "%s: invalid number '%s'\n", arg0, value);
+        exit(EX_USAGE);
+    }
+    return number;
+}
+
+/**
+ * Parses a non-negative real number option.
+ */
+static double parse_real(const char *arg0, const char *value)
+{
+    char *end = nullptr;
+    auto &&number = std::strtod(value, &end);
+    if (*value == '\0' || *end != '\0' || !(number >= 0)) {
+        fprintf(stderr, "%s: invalid number '%s'\n", arg0, value);
+        exit(EX_USAGE);
+    }
+    return number;
+}
+
+/**
+ * Runs the program.
+ */
+int main(const int argc, char **const argv)
+{
+    enum
+    {
+        VERSION = -128,
+        HELP,
+    };
+    static const option options[] {
+        {"rate", required_argument, nullptr, 'r'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"batch", required_argument, nullptr, 'b'},
+        {"name", required_argument, nullptr, 'n'},
+        {"mix", required_argument, nullptr, 'm'},
+        {"wait", required_argument, nullptr, 'w'},
+        {"port", required_argument, nullptr, 'p'},
+        {"help", no_argument, nullptr, HELP},
+        {"version", no_argument, nullptr, VERSION},
+        {}
+    };
+
+    auto &&load = load_options();
+    int opt = -1;
+    do {
+        opt = getopt_long(argc, argv, "r:d:b:n:m:w:p:", options, nullptr);
+        switch (opt) {
+        case 'r':
+            load.rate = parse_real(argv[0], optarg);
+            break;
+        case 'd':
+            load.duration = parse_real(argv[0], optarg);
+            break;
+        case 'b':
+            load.batch = parse_number(argv[0], optarg, MAX_BATCH);
+            if (load.batch == 0) {
+                load.batch = 1;
+            }
+            break;
+        case 'n':
+            load.name = optarg;
+            break;
+        case 'm':
+            if (!parse_mix(optarg, load.mix)) {
+                fprintf(stderr, "%s: invalid mix '%s'\n", argv[0], optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case 'w':
+            load.wait = parse_number(argv[0], optarg, 3600000);
+            break;
+        case 'p':
+            load.port = htons(parse_number(argv[0], optarg, 65535));
+            break;
+        case HELP:
+            print_usage(argv[0]);
+            exit(0);
+        case VERSION:
+            print_version();
+            exit(0);
+        case '?':
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            exit(EX_USAGE);
+        case -1:
+            break;
+        default:
+            abort();
+        }
+    }
+    while (opt != -1);
+
+    if (argc - optind > 1) {
+        fprintf(stderr, "%s: too many arguments\n", argv[0]);
+        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+        exit(EX_USAGE);
+    }
+    auto &&address = optind < argc ? argv[optind] : "::1";
+
+    // A response is credited to the latest query with its ID, so IDs must
+    // not be reused while responses to them may still arrive.
+    if (load.rate > 0 && load.rate * load.wait / 1000 >= ID_COUNT) {
+        fprintf(stderr,
+            "%s: %g queries per second with a wait of %u ms reuse query IDs"
+            " in flight\n", argv[0], load.rate, load.wait);
+        fprintf(stderr, "%s: use a wait of at most %.0f ms\n", argv[0],
+            std::floor((ID_COUNT - 1) * 1000 / load.rate));
+        exit(EX_USAGE);
+    }
+    if (load.rate == 0 && load.wait != 0) {
+        fprintf(stderr,
+            "%s: warning: without a rate limit, responses later than %.0f"
+            " queries are credited to wrong ones\n", argv[0], ID_COUNT);
+    }
+
+    if (load.name.empty()) {
+        array<char, LLMNR_LABEL_MAX + 1> host_name {};
+        gethostname(host_name.data(), host_name.size() - 1);
+        load.name.assign(host_name.data(), strcspn(host_name.data(), "."));
+    }
+    if (load.name.empty() || load.name.size() > LLMNR_LABEL_MAX) {
+        fprintf(stderr, "%s: invalid name '%s'\n", argv[0],
+            load.name.c_str());
+        exit(EX_USAGE);
+    }
+
+    sockaddr_in6 target {};
+    auto &&error = parse_target(address, load.port, target);
+    if (error != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], address,
+            gai_strerror(error));
+        exit(EX_NOHOST);
+    }
+
+    auto &&generator = load_generator(load, target);
+    auto &&open_error = generator.open();
+    if (open_error != 0) {
+        fprintf(stderr, "%s: could not open a socket: %s\n", argv[0],
+            strerror(open_error));
+        exit(EX_OSERR);
+    }
+
+    auto &&elapsed = generator.run();
+    generator.report(elapsed);
+    return 0;
+}
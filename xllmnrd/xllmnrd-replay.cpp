@@ -0,0 +1,734 @@
+// xllmnrd-replay.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program replays LLMNR queries captured in a pcap file into a
+// responder, either in this process through the operating system interface
+// or over the network, and records the responses and the handling cost of
+// each query.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "responder.h"
+#include "pcap.h"
+#include "wire_name.h"
+#include "llmnr_packet.h"
+#include "llmnr.h"
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netdb.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sysexits.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+
+using std::exception;
+using std::fprintf;
+using std::ifstream;
+using std::make_shared;
+using std::move;
+using std::ofstream;
+using std::printf;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::strerror;
+using std::uint8_t;
+using std::unique_ptr;
+using std::vector;
+using xllmnrd::captured_datagram;
+using xllmnrd::default_posix;
+using xllmnrd::pcap_reader;
+using xllmnrd::pcap_writer;
+using xllmnrd::rtnetlink_interface_manager;
+using namespace std::chrono;
+
+/// Options of the program.
+struct replay_options
+{
+    /// Speed factor of the replay, or zero for no delay.
+    double speed = 1;
+
+    /// Port of the queries to replay, in network byte order.
+    in_port_t port = htons(LLMNR_PORT);
+
+    /// Interface on which queries are received in this process.
+    string interface;
+
+    /// Names to respond for in this process.
+    vector<scoped_name> names;
+
+    /// Binary zone file for the responder in this process.
+    string zone;
+
+    /// Address to which queries are sent over the network, or empty.
+    string target;
+
+    /// Milliseconds to wait for late responses over the network.
+    unsigned int wait = 1000;
+
+    /// Pcap file to which responses are written, or empty.
+    string output;
+
+    /// File to which the handling cost of each query is written, or empty.
+    string costs;
+};
+
+/// Result of a query replayed.
+struct replay_result
+{
+    /// Time taken to handle the query, or to get the first response over
+    /// the network.
+    nanoseconds cost {0};
+
+    /// Number of responses.
+    unsigned int responses = 0;
+
+    /// Number of answers in the first response.
+    unsigned int answers = 0;
+};
+
+/**
+ * Operating system interface that feeds captured queries to a responder
+ * and records its responses.
+ *
+ * All the sockets opened through it are simulated, and a receive returns
+ * the query set by 'set_query' only once.
+ */
+class replay_posix: public default_posix
+{
+private:
+
+    int _next_fd = 1000;
+
+    const captured_datagram *_query = nullptr;
+
+    unsigned int _interface_index = 0;
+
+    /// True if the query has been received.
+    bool _received = false;
+
+    vector<captured_datagram> _responses;
+
+public:
+
+    /// Sets the query to be received next on an interface.
+    void set_query(const captured_datagram &query,
+        const unsigned int interface_index)
+    {
+        _query = &query;
+        _interface_index = interface_index;
+        _received = false;
+        _responses.clear();
+    }
+
+    /// Returns the responses to the last query.
+    const vector<captured_datagram> &responses() const
+    {
+        return _responses;
+    }
+
+    int socket(int, int, int) override
+    {
+        return _next_fd++;
+    }
+
+    int bind(int, const sockaddr *, socklen_t) override
+    {
+        return 0;
+    }
+
+    int setsockopt(int, int, int, const void *, socklen_t) override
+    {
+        return 0;
+    }
+
+    int close(int) override
+    {
+        return 0;
+    }
+
+    int recvmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+        int flags, timespec *timeout) override;
+
+    int sendmmsg(int socket, mmsghdr *messages, unsigned int vlen,
+        int flags) override;
+};
+
+int replay_posix::recvmmsg(int, mmsghdr *const messages,
+    const unsigned int vlen, int, timespec *)
+{
+    if (_query == nullptr || _received || vlen == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    auto &&msg = messages[0].msg_hdr;
+    auto &&payload = _query->payload;
+    auto size = std::min(payload.size(), msg.msg_iov[0].iov_len);
+    std::memcpy(msg.msg_iov[0].iov_base, payload.data(), size);
+
+    auto sender = _query->source;
+    sender.sin6_scope_id = _interface_index;
+    std::memcpy(msg.msg_name, &sender,
+        std::min<size_t>(msg.msg_namelen, sizeof sender));
+    msg.msg_namelen = sizeof sender;
+
+    auto &&cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof (in6_pktinfo));
+    const in6_pktinfo pktinfo {_query->destination.sin6_addr,
+        _interface_index};
+    std::memcpy(CMSG_DATA(cmsg), &pktinfo, sizeof pktinfo);
+    msg.msg_controllen = CMSG_SPACE(sizeof (in6_pktinfo));
+    msg.msg_flags = 0;
+    messages[0].msg_len = size;
+
+    _received = true;
+    return 1;
+}
+
+int replay_posix::sendmmsg(int, mmsghdr *const messages,
+    const unsigned int vlen, int)
+{
+    for (unsigned int i = 0; i != vlen; ++i) {
+        auto &&msg = messages[i].msg_hdr;
+        auto &&response = captured_datagram {};
+        std::memcpy(&response.destination, msg.msg_name,
+            sizeof response.destination);
+        response.destination.sin6_scope_id = 0;
+
+        // Responses to multicast queries are sent from unicast addresses
+        // chosen by the kernel, which are left unspecified.
+        response.source = _query->destination;
+        if (IN6_IS_ADDR_MULTICAST(&response.source.sin6_addr)) {
+            response.source.sin6_addr = in6addr_any;
+        }
+        auto &&iov = msg.msg_iov[0];
+        auto &&data = static_cast<const uint8_t *>(iov.iov_base);
+        response.payload.assign(data, data + iov.iov_len);
+        messages[i].msg_len = iov.iov_len;
+        _responses.push_back(response);
+    }
+    return vlen;
+}
+
+/**
+ * Prints the version information.
+ */
+inline void print_version()
+{
+    printf("xllmnrd-replay (%s) %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+    printf("Copyright (C) 2013-2021 Kaz Nishimura\n");
+    printf("\
+This is free software: you are free to change and redistribute it.\n\
+There is NO WARRANTY, to the extent permitted by law.\n");
+}
+
+/**
+ * Prints the command usage.
+ *
+ * @param arg0 the command name
+ */
+inline void print_usage(const char *const arg0)
+{
+    printf("Usage: %s [OPTION]... INPUT\n", arg0);
+    printf("Replay LLMNR queries captured in pcap file INPUT into a "
+        "responder.\n");
+    printf("\n");
+    printf("  -i, --interface=NAME  receive the queries on interface NAME "
+        "in this process\n");
+    printf("  -n, --name=NAME       respond for NAME in this process "
+        "(repeatable)\n");
+    printf("  -z, --zone=FILE       respond from binary zone FILE in this "
+        "process\n");
+    printf("  -t, --target=ADDRESS  send the queries to ADDRESS instead\n");
+    printf("  -s, --speed=FACTOR    replay FACTOR times as fast as captured "
+        "(0 for no delay)\n");
+    printf("  -p, --port=PORT       replay the queries to PORT\n");
+    printf("  -w, --wait=MSEC       wait MSEC milliseconds for late "
+        "responses\n");
+    printf("  -o, --output=FILE     write the responses to pcap FILE\n");
+    printf("  -c, --costs=FILE      write the handling cost of each query "
+        "to FILE\n");
+    printf("      --help            display this help and exit\n");
+    printf("      --version         output version information and exit\n");
+    printf("\n");
+    printf("Queries are handled in this process by the responder code "
+        "with the addresses\nof the local interface NAME, unless a target "
+        "is given.\n");
+    printf("\n");
+    printf("Report bugs to <%s>.\n", PACKAGE_BUGREPORT);
+}
+
+/**
+ * Returns the number of answers in a response.
+ */
+inline unsigned int answer_count(const vector<uint8_t> &response)
+{
+    if (response.size() < LLMNR_HEADER_SIZE) {
+        return 0;
+    }
+    return llmnr_get_uint16(&response[6]);
+}
+
+/**
+ * Returns the question of a query for the cost file.
+ */
+static string describe_question(const vector<uint8_t> &query)
+{
+    if (query.size() < LLMNR_HEADER_SIZE) {
+        return "-\t-";
+    }
+
+    size_t remains = query.size() - LLMNR_HEADER_SIZE;
+    auto &&qname = &query[LLMNR_HEADER_SIZE];
+    auto &&qname_end = llmnr_skip_name(qname, &remains);
+    if (qname_end == nullptr || remains < 4) {
+        return "-\t-";
+    }
+
+    auto &&result = string();
+    auto i = qname;
+    while (*i != 0 && (*i >> 6) == 0) {
+        if (!result.empty()) {
+            result.push_back('.');
+        }
+        for (size_t j = 1; j <= *i; ++j) {
+            auto &&c = char(i[j]);
+            result.push_back(c > ' ' && c < 0x7f ? c : '?');
+        }
+        i += *i + 1;
+    }
+    if (result.empty()) {
+        result = ".";
+    }
+    return result + "\t" + std::to_string(llmnr_get_uint16(qname_end));
+}
+
+/**
+ * Replays queries into a responder in this process.
+ */
+static vector<replay_result> replay_in_process(
+    const vector<captured_datagram> &queries, const replay_options &options,
+    vector<captured_datagram> &responses)
+{
+    auto &&interface_index = if_nametoindex(options.interface.c_str());
+    if (interface_index == 0) {
+        throw std::invalid_argument("unknown interface '"
+            + options.interface + "'");
+    }
+
+    auto &&os = make_shared<replay_posix>();
+    auto &&manager = make_shared<rtnetlink_interface_manager>();
+    manager->set_debug_level(-1);
+    auto &&r = responder(options.port, manager,
+        options.names.empty() ? vector<scoped_name> {scoped_name {}}
+            : options.names,
+        os);
+    if (!options.zone.empty()) {
+        r.set_zone_file(zone_file::open(options.zone.c_str()));
+    }
+    r.start();
+
+    auto &&results = vector<replay_result>(queries.size());
+    auto &&start = steady_clock::now();
+    for (size_t i = 0; i != queries.size(); ++i) {
+        auto &&query = queries[i];
+        if (options.speed > 0) {
+            std::this_thread::sleep_until(start
+                + duration_cast<nanoseconds>(
+                    (query.time - queries[0].time) / options.speed));
+        }
+
+        os->set_query(query, interface_index);
+        auto &&handling_start = steady_clock::now();
+        r.process_udp6();
+        auto &&cost = steady_clock::now() - handling_start;
+
+        auto &&result = results[i];
+        result.cost = cost;
+        result.responses = os->responses().size();
+        for (auto &&j : os->responses()) {
+            if (result.answers == 0) {
+                result.answers = answer_count(j.payload);
+            }
+            responses.push_back(j);
+            responses.back().time = query.time + cost;
+        }
+    }
+    return results;
+}
+
+/**
+ * Replays queries to a responder over the network.
+ */
+static vector<replay_result> replay_to_target(
+    const vector<captured_datagram> &queries, const replay_options &options,
+    vector<captured_datagram> &responses)
+{
+    addrinfo hints {};
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    addrinfo *info = nullptr;
+    auto &&error = getaddrinfo(options.target.c_str(), nullptr, &hints,
+        &info);
+    if (error != 0) {
+        throw std::invalid_argument(options.target + ": "
+            + gai_strerror(error));
+    }
+    auto &&target = sockaddr_in6 {};
+    std::memcpy(&target, info->ai_addr, sizeof target);
+    target.sin6_port = options.port;
+    freeaddrinfo(info);
+
+    auto &&udp6 = socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp6 == -1) {
+        throw std::system_error(errno, std::generic_category(),
+            "could not open a socket");
+    }
+    static const int HOP_1 = 1;
+    setsockopt(udp6, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &HOP_1,
+        sizeof HOP_1);
+
+    auto &&results = vector<replay_result>(queries.size());
+    auto &&send_times = vector<steady_clock::time_point>(queries.size());
+
+    // Index of the last query sent with each ID.
+    auto &&last_query = vector<long>(0x10000, -1);
+
+    auto &&receive = [&](const nanoseconds timeout) {
+        pollfd fd {udp6, POLLIN, 0};
+        auto &&milliseconds = int(ceil<std::chrono::milliseconds>(timeout)
+            .count());
+        while (poll(&fd, 1, milliseconds) > 0) {
+            auto &&buffer = vector<uint8_t>(65536);
+            auto &&sender = sockaddr_in6 {};
+            socklen_t sender_size = sizeof sender;
+            auto &&size = recvfrom(udp6, buffer.data(), buffer.size(),
+                MSG_DONTWAIT, reinterpret_cast<sockaddr *>(&sender),
+                &sender_size);
+            if (size < ssize_t(LLMNR_HEADER_SIZE)) {
+                continue;
+            }
+            buffer.resize(size);
+
+            auto &&index = last_query[llmnr_get_uint16(&buffer[0])];
+            if (index < 0) {
+                continue;
+            }
+            auto &&query = queries[index];
+            auto &&result = results[index];
+            if (result.responses++ == 0) {
+                result.cost = steady_clock::now() - send_times[index];
+                result.answers = answer_count(buffer);
+            }
+
+            auto &&response = captured_datagram {};
+            response.time = query.time + result.cost;
+            response.source = sender;
+            response.source.sin6_scope_id = 0;
+            response.destination = query.source;
+            response.payload = move(buffer);
+            responses.push_back(move(response));
+            milliseconds = 0;
+        }
+    };
+
+    auto &&start = steady_clock::now();
+    for (size_t i = 0; i != queries.size(); ++i) {
+        auto &&query = queries[i];
+        if (options.speed > 0) {
+            auto &&due = start + duration_cast<nanoseconds>(
+                (query.time - queries[0].time) / options.speed);
+            auto now = steady_clock::now();
+            while (now < due) {
+                receive(due - now);
+                now = steady_clock::now();
+            }
+        }
+
+        auto &&payload = query.payload;
+        if (payload.size() >= 2) {
+            last_query[llmnr_get_uint16(&payload[0])] = i;
+        }
+        send_times[i] = steady_clock::now();
+        if (sendto(udp6, payload.data(), payload.size(), 0,
+            reinterpret_cast<const sockaddr *>(&target), sizeof target)
+            == -1) {
+            fprintf(stderr, "could not send query %zu: %s\n", i,
+                strerror(errno));
+        }
+        receive(nanoseconds(0));
+    }
+
+    auto &&wait_end = steady_clock::now() + milliseconds(options.wait);
+    auto now = steady_clock::now();
+    while (now < wait_end) {
+        receive(wait_end - now);
+        now = steady_clock::now();
+    }
+    close(udp6);
+    return results;
+}
+
+/**
+ * Returns a percentile of sorted costs in microseconds by the nearest rank.
+ */
+inline double percentile(const vector<nanoseconds> &costs, const double p)
+{
+    auto &&rank = size_t(std::ceil(p / 100 * costs.size()));
+    return costs[rank != 0 ? rank - 1 : 0].count() / 1000.0;
+}
+
+/**
+ * Runs the program.
+ */
+int main(const int argc, char **const argv)
+{
+    enum
+    {
+        VERSION = -128,
+        HELP,
+    };
+    static const option options[] {
+        {"interface", required_argument, nullptr, 'i'},
+        {"name", required_argument, nullptr, 'n'},
+        {"zone", required_argument, nullptr, 'z'},
+        {"target", required_argument, nullptr, 't'},
+        {"speed", required_argument, nullptr, 's'},
+        {"port", required_argument, nullptr, 'p'},
+        {"wait", required_argument, nullptr, 'w'},
+        {"output", required_argument, nullptr, 'o'},
+        {"costs", required_argument, nullptr, 'c'},
+        {"help", no_argument, nullptr, HELP},
+        {"version", no_argument, nullptr, VERSION},
+        {}
+    };
+
+    auto &&replay = replay_options();
+    int opt = -1;
+    do {
+        opt = getopt_long(argc, argv, "i:n:z:t:s:p:w:o:c:", options,
+            nullptr);
+        char *end = nullptr;
+        switch (opt) {
+        case 'i':
+            replay.interface = optarg;
+            break;
+        case 'n':
+            {
+                auto &&name = scoped_name {};
+                if (!xllmnrd::to_wire_name(optarg,
+                    optarg + std::strlen(optarg), name.name)) {
+                    fprintf(stderr, "%s: invalid name '%s'\n", argv[0],
+                        optarg);
+                    exit(EX_USAGE);
+                }
+                replay.names.push_back(name);
+            }
+            break;
+        case 'z':
+            replay.zone = optarg;
+            break;
+        case 't':
+            replay.target = optarg;
+            break;
+        case 's':
+            replay.speed = std::strtod(optarg, &end);
+            if (*end != '\0' || !(replay.speed >= 0)) {
+                fprintf(stderr, "%s: invalid speed '%s'\n", argv[0],
+                    optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case 'p':
+            {
+                auto &&port = std::strtoul(optarg, &end, 10);
+                if (*end != '\0' || port == 0 || port > 65535) {
+                    fprintf(stderr, "%s: invalid port '%s'\n", argv[0],
+                        optarg);
+                    exit(EX_USAGE);
+                }
+                replay.port = htons(port);
+            }
+            break;
+        case 'w':
+            replay.wait = std::strtoul(optarg, &end, 10);
+            if (*end != '\0') {
+                fprintf(stderr, "%s: invalid time '%s'\n", argv[0],
+                    optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case 'o':
+            replay.output = optarg;
+            break;
+        case 'c':
+            replay.costs = optarg;
+            break;
+        case HELP:
+            print_usage(argv[0]);
+            exit(0);
+        case VERSION:
+            print_version();
+            exit(0);
+        case '?':
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            exit(EX_USAGE);
+        case -1:
+            break;
+        default:
+            abort();
+        }
+    }
+    while (opt != -1);
+
+    if (argc - optind != 1) {
+        fprintf(stderr, "%s: wrong number of arguments\n", argv[0]);
+        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+        exit(EX_USAGE);
+    }
+    if (replay.target.empty() && replay.interface.empty()) {
+        fprintf(stderr, "%s: either an interface or a target is required\n",
+            argv[0]);
+        exit(EX_USAGE);
+    }
+    auto &&input = argv[optind];
+
+    // Only the queries to the port are replayed.
+    auto &&queries = vector<captured_datagram>();
+    size_t skipped = 0;
+    try {
+        ifstream in(input, ifstream::binary);
+        if (!in) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], input, strerror(errno));
+            exit(EX_NOINPUT);
+        }
+
+        auto &&reader = pcap_reader(in);
+        auto &&datagram = captured_datagram {};
+        while (reader.read(datagram)) {
+            if (datagram.destination.sin6_port == replay.port) {
+                queries.push_back(datagram);
+            }
+            else {
+                skipped += 1;
+            }
+        }
+        skipped += reader.skipped();
+    }
+    catch (const exception &e) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], input, e.what());
+        exit(EX_DATAERR);
+    }
+
+    // Changes of the interfaces are not of interest.
+    setlogmask(LOG_UPTO(LOG_WARNING));
+    openlog(nullptr, LOG_PERROR, LOG_USER);
+
+    auto &&responses = vector<captured_datagram>();
+    auto &&results = vector<replay_result>();
+    try {
+        if (!replay.target.empty()) {
+            results = replay_to_target(queries, replay, responses);
+        }
+        else {
+            results = replay_in_process(queries, replay, responses);
+        }
+    }
+    catch (const exception &e) {
+        fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        exit(EX_UNAVAILABLE);
+    }
+
+    if (!replay.output.empty()) {
+        ofstream out(replay.output, ofstream::binary);
+        auto &&writer = pcap_writer(out);
+        for (auto &&i : responses) {
+            writer.write(i);
+        }
+        out.close();
+        if (!out) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], replay.output.c_str(),
+                strerror(errno));
+            exit(EX_CANTCREAT);
+        }
+    }
+
+    if (!replay.costs.empty()) {
+        ofstream out(replay.costs);
+        out << "# index\ttime\tqname\tqtype\tresponses\tanswers"
+            "\tcost_ns\n";
+        for (size_t i = 0; i != queries.size(); ++i) {
+            auto &&time = duration<double>(queries[i].time
+                - queries[0].time).count();
+            out << i << '\t' << time << '\t'
+                << describe_question(queries[i].payload) << '\t'
+                << results[i].responses << '\t' << results[i].answers << '\t'
+                << results[i].cost.count() << '\n';
+        }
+        out.close();
+        if (!out) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], replay.costs.c_str(),
+                strerror(errno));
+            exit(EX_CANTCREAT);
+        }
+    }
+
+    auto &&costs = vector<nanoseconds>();
+    size_t answered = 0;
+    for (auto &&i : results) {
+        if (i.responses != 0 || replay.target.empty()) {
+            costs.push_back(i.cost);
+        }
+        if (i.responses != 0) {
+            answered += 1;
+        }
+    }
+    sort(costs.begin(), costs.end());
+
+    printf("queries     %zu replayed, %zu other packets skipped\n",
+        queries.size(), skipped);
+    printf("responses   %zu to %zu queries\n", responses.size(), answered);
+    if (!costs.empty()) {
+        printf("%-11s p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+            replay.target.empty() ? "cost" : "latency",
+            percentile(costs, 50), percentile(costs, 90),
+            percentile(costs, 99), costs.back().count() / 1000.0);
+    }
+    return 0;
+}
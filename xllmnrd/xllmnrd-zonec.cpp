@@ -0,0 +1,165 @@
+// xllmnrd-zonec.cpp
+// Copyright (C) 2013-2021 Kaz Nishimura
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// This program compiles zone text into a binary zone file for xllmnrd.
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "zone.h"
+#include <getopt.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+using std::exception;
+using std::fprintf;
+using std::ifstream;
+using std::ofstream;
+using std::printf;
+using std::string;
+using std::strerror;
+using xllmnrd::zone_compiler;
+
+/**
+ * Prints the version information.
+ */
+inline void print_version()
+{
+    printf("xllmnrd-zonec (%s) %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+    printf("Copyright (C) 2013-2021 Kaz Nishimura\n");
+    printf("\
+This is free software: you are free to change and redistribute it.\n\
+There is NO WARRANTY, to the extent permitted by law.\n");
+}
+
+/**
+ * Prints the command usage.
+ *
+ * @param arg0 the command name
+ */
+inline void print_usage(const char *const arg0)
+{
+    printf("Usage: %s [OPTION]... INPUT OUTPUT\n", arg0);
+    printf("Compile zone text INPUT into a binary zone file OUTPUT.\n");
+    printf("\n");
+    printf("      --help            display this help and exit\n");
+    printf("      --version         output version information and exit\n");
+    printf("\n");
+    printf("Each line of INPUT has the form 'NAME [TTL] [IN] TYPE RDATA...'\n");
+    printf("where TYPE is one of A, AAAA, PTR, SRV and TXT.\n");
+    printf("\n");
+    printf("Report bugs to <%s>.\n", PACKAGE_BUGREPORT);
+}
+
+/**
+ * Runs the program.
+ */
+int main(const int argc, char **const argv)
+{
+    enum
+    {
+        VERSION = -128,
+        HELP,
+    };
+    static const option options[] {
+        {"help", no_argument, nullptr, HELP},
+        {"version", no_argument, nullptr, VERSION},
+        {}
+    };
+
+    int opt = -1;
+    do {
+        opt = getopt_long(argc, argv, "", options, nullptr);
+        switch (opt) {
+        case HELP:
+            print_usage(argv[0]);
+            exit(0);
+        case VERSION:
+            print_version();
+            exit(0);
+        case '?':
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            exit(EX_USAGE);
+        case -1:
+            break;
+        default:
+            abort();
+        }
+    }
+    while (opt != -1);
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "%s: wrong number of arguments\n", argv[0]);
+        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+        exit(EX_USAGE);
+    }
+    auto &&input = argv[optind];
+    auto &&output = argv[optind + 1];
+
+    auto &&compiler = zone_compiler();
+    ifstream in(input);
+    if (!in) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], input, strerror(errno));
+        exit(EX_NOINPUT);
+    }
+
+    unsigned long line_number = 0;
+    auto &&line = string();
+    while (getline(in, line)) {
+        ++line_number;
+        try {
+            compiler.add_line(line);
+        }
+        catch (const exception &e) {
+            fprintf(stderr, "%s:%lu: %s\n", input, line_number, e.what());
+            exit(EX_DATAERR);
+        }
+    }
+
+    auto &&image = compiler.compile();
+
+    // Writes to a temporary file first so that the output is replaced
+    // atomically.
+    auto &&temporary = string(output) + ".tmp";
+    {
+        ofstream out(temporary, ofstream::binary);
+        out.write(reinterpret_cast<const char *>(image.data()), image.size());
+        out.close();
+        if (!out) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], temporary.c_str(),
+                strerror(errno));
+            unlink(temporary.c_str());
+            exit(EX_CANTCREAT);
+        }
+    }
+    if (rename(temporary.c_str(), output) == -1) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], output, strerror(errno));
+        unlink(temporary.c_str());
+        exit(EX_CANTCREAT);
+    }
+
+    return 0;
+}
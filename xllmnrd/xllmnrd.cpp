@@ -21,6 +21,10 @@
 #endif
 
 #include "responder.h"
+#include "responder_group.h"
+#include "rtnetlink.h"
+#include "netns_posix.h"
+#include "llmnr.h"
 #include <gettext.h>
 #include <getopt.h>
 #include <sysexits.h>
@@ -29,7 +33,9 @@
 #include <syslog.h>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
 #include <vector>
+#include <string>
 #include <locale>
 #include <system_error>
 #include <limits>
@@ -46,12 +52,20 @@ using std::fopen;
 using std::fprintf;
 using std::generic_category;
 using std::locale;
+using std::make_shared;
 using std::make_unique;
+using std::move;
 using std::putchar;
 using std::printf;
+using std::shared_ptr;
 using std::system_error;
 using std::runtime_error;
+using std::string;
+using std::strcspn;
+using std::strtoul;
 using std::unique_ptr;
+using std::vector;
+using xllmnrd::rtnetlink_interface_manager;
 
 // We just ignore 'LOG_PERROR' if it is not defined.
 #ifndef LOG_PERROR
@@ -67,6 +81,75 @@ struct responder_builder
 {
     bool foreground = false;
     const char *pid_file = nullptr;
+    const char *hosts_file = nullptr;
+    const char *zone_file = nullptr;
+    vector<scoped_name> names;
+    xllmnrd::interface_policy interface_policy;
+    std::chrono::milliseconds coalescing_window
+        {rtnetlink_interface_manager::DEFAULT_COALESCING_WINDOW};
+    bool asynchronous_startup = false;
+    vector<const char *> netns;
+
+    /**
+     * Sets the coalescing window for interface changes.
+     *
+     * @param arg a number of milliseconds
+     * @return true if the number is valid, or false.
+     */
+    bool set_coalescing_window(const char *const arg)
+    {
+        char *end = nullptr;
+        errno = 0;
+        auto &&value = strtoul(arg, &end, 10);
+        if (*arg == '\0' || *end != '\0' || errno != 0
+            || value > 60 * 1000UL) {
+            return false;
+        }
+
+        coalescing_window = std::chrono::milliseconds(value);
+        return true;
+    }
+
+    /**
+     * Adds a name to respond for.
+     *
+     * @param arg a name optionally followed by a colon and a comma-separated
+     * list of interface name patterns
+     * @return true if the name is valid, or false.
+     */
+    bool add_name(const char *const arg)
+    {
+        auto &&length = strcspn(arg, ".:");
+        if (length == 0 || length > LLMNR_LABEL_MAX) {
+            return false;
+        }
+
+        auto name = scoped_name {};
+        name.name.push_back(static_cast<uint8_t>(length));
+        name.name.insert(name.name.end(), arg, arg + length);
+        name.name.push_back(0U);
+
+        auto &&interfaces = arg + length + strcspn(arg + length, ":");
+        if (*interfaces == ':') {
+            auto &&i = interfaces + 1;
+            while (*i != '\0') {
+                auto &&n = strcspn(i, ",");
+                if (n != 0) {
+                    name.interfaces.push_back(string(i, n));
+                }
+                i += n;
+                if (*i == ',') {
+                    ++i;
+                }
+            }
+            if (name.interfaces.empty()) {
+                return false;
+            }
+        }
+
+        names.push_back(name);
+        return true;
+    }
 
     /**
      * Makes a pid file.
@@ -119,18 +202,94 @@ struct responder_builder
     /**
      * Builds a responder object.
      */
-    auto build() -> unique_ptr<class responder>
+    auto build() -> unique_ptr<native_responder>
     {
-        return make_unique<class responder>();
+        auto &&interface_manager = make_shared<rtnetlink_interface_manager>();
+        interface_manager->set_interface_policy(interface_policy);
+        interface_manager->set_coalescing_window(coalescing_window);
+
+        auto responder = unique_ptr<native_responder>();
+        if (names.empty()) {
+            responder = make_unique<native_responder>(htons(LLMNR_PORT),
+                interface_manager);
+        }
+        else {
+            responder = make_unique<native_responder>(htons(LLMNR_PORT),
+                interface_manager, names);
+        }
+
+        configure(*responder);
+        return responder;
     }
+
+#if XLLMNRD_NETNS
+
+    /**
+     * Builds a group of responders for the network namespaces.
+     */
+    auto build_group() -> unique_ptr<responder_group>
+    {
+        auto group = make_unique<responder_group>();
+        for (auto &&i : netns) {
+            auto &&os = make_shared<xllmnrd::netns_posix>(i);
+            auto &&interface_manager =
+                make_shared<rtnetlink_interface_manager>(os);
+            interface_manager->set_externally_driven(true);
+            interface_manager->set_interface_policy(interface_policy);
+            interface_manager->set_coalescing_window(coalescing_window);
+
+            auto &&responder = make_unique<responder_group::responder_type>(
+                htons(LLMNR_PORT), interface_manager,
+                names.empty() ? vector<scoped_name> {scoped_name {}} : names,
+                os);
+            responder->set_externally_driven(true);
+            configure(*responder);
+            group->add(i, interface_manager, move(responder));
+        }
+        return group;
+    }
+
+#endif
+
+    /**
+     * Applies the settings to a responder.
+     *
+     * The hosts and zone files are shared by all the responders.
+     */
+    template<class Responder>
+    void configure(Responder &responder)
+    {
+        responder.set_asynchronous_startup(asynchronous_startup);
+        if (hosts_file != nullptr) {
+            if (hosts == nullptr) {
+                hosts = make_shared<class hosts_file>(hosts_file);
+            }
+            responder.set_hosts_file(hosts);
+        }
+        if (zone_file != nullptr) {
+            if (zone == nullptr) {
+                zone = xllmnrd::zone_file::open(zone_file);
+            }
+            responder.set_zone_file(zone);
+        }
+    }
+
+private:
+
+    shared_ptr<class hosts_file> hosts;
+
+    shared_ptr<const xllmnrd::zone_file> zone;
 };
 
-static unique_ptr<class responder> responder;
+static unique_ptr<native_responder> main_responder;
+
+static unique_ptr<responder_group> group;
 
 static atomic<int> caught_signal;
 
 // A signal handler should have "C" linkage.
 extern "C" void handle_signal_to_terminate(int __sig);
+extern "C" void handle_signal_to_report(int __sig);
 
 /**
  * Prints the version information.
@@ -156,6 +315,18 @@ inline void print_usage(const char *const arg0)
     putchar('\n');
     printf("  -f, --foreground      %s\n", _("run in foreground"));
     printf("  -p, --pid-file=FILE   %s\n", _("record the process ID in FILE"));
+    printf("  -H, --hosts-file=FILE %s\n", _("respond for names in FILE as well"));
+    printf("  -z, --zone-file=FILE  %s\n", _("respond with records in binary zone FILE"));
+    printf("  -i, --interface=PATTERN\n");
+    printf("                        %s\n", _("use interfaces matching PATTERN only"));
+    printf("  -x, --exclude-interface=PATTERN\n");
+    printf("                        %s\n", _("ignore interfaces matching PATTERN"));
+    printf("      --coalescing-window=MSEC\n");
+    printf("                        %s\n", _("delay link state changes by MSEC (default 0)"));
+    printf("      --async-startup   %s\n", _("answer before all interfaces are known"));
+    printf("      --netns=NAME      %s\n", _("serve network namespace NAME instead"));
+    printf("  -n, --name=NAME[:INTERFACE,...]\n");
+    printf("                        %s\n", _("respond for NAME (on INTERFACEs only)"));
     printf("      --help            %s\n", _("display this help and exit"));
     printf("      --version         %s\n", _("output version information and exit"));
     putchar('\n');
@@ -182,10 +353,26 @@ inline int parse_options(const int argc, char **const argv,
         HELP,
         FOREGROUND,
         PID_FILE,
+        NAME,
+        HOSTS_FILE,
+        ZONE_FILE,
+        INTERFACE,
+        EXCLUDE_INTERFACE,
+        COALESCING_WINDOW,
+        ASYNC_STARTUP,
+        NETNS,
     };
     static const option options[] {
         {"foreground", no_argument, nullptr, FOREGROUND},
         {"pid-file", required_argument, nullptr, PID_FILE},
+        {"name", required_argument, nullptr, NAME},
+        {"hosts-file", required_argument, nullptr, HOSTS_FILE},
+        {"zone-file", required_argument, nullptr, ZONE_FILE},
+        {"interface", required_argument, nullptr, INTERFACE},
+        {"exclude-interface", required_argument, nullptr, EXCLUDE_INTERFACE},
+        {"coalescing-window", required_argument, nullptr, COALESCING_WINDOW},
+        {"async-startup", no_argument, nullptr, ASYNC_STARTUP},
+        {"netns", required_argument, nullptr, NETNS},
         {"help", no_argument, nullptr, HELP},
         {"version", no_argument, nullptr, VERSION},
         {}
@@ -193,7 +380,7 @@ inline int parse_options(const int argc, char **const argv,
 
     int opt = -1;
     do {
-        opt = getopt_long(argc, argv, "fp:", options, nullptr);
+        opt = getopt_long(argc, argv, "fp:n:H:z:i:x:", options, nullptr);
         switch (opt) {
         case 'f':
         case FOREGROUND:
@@ -203,6 +390,48 @@ inline int parse_options(const int argc, char **const argv,
         case PID_FILE:
             builder.pid_file = optarg;
             break;
+        case 'H':
+        case HOSTS_FILE:
+            builder.hosts_file = optarg;
+            break;
+        case 'z':
+        case ZONE_FILE:
+            builder.zone_file = optarg;
+            break;
+        case 'i':
+        case INTERFACE:
+            builder.interface_policy.include(optarg);
+            break;
+        case 'x':
+        case EXCLUDE_INTERFACE:
+            builder.interface_policy.exclude(optarg);
+            break;
+        case COALESCING_WINDOW:
+            if (!builder.set_coalescing_window(optarg)) {
+                fprintf(stderr, _("%s: invalid coalescing window '%s'\n"),
+                    argv[0], optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case ASYNC_STARTUP:
+            builder.asynchronous_startup = true;
+            break;
+        case NETNS:
+#if XLLMNRD_NETNS
+            builder.netns.push_back(optarg);
+            break;
+#else
+            fprintf(stderr, _("%s: network namespaces not supported\n"),
+                argv[0]);
+            exit(EX_USAGE);
+#endif
+        case 'n':
+        case NAME:
+            if (!builder.add_name(optarg)) {
+                fprintf(stderr, _("%s: invalid name '%s'\n"), argv[0], optarg);
+                exit(EX_USAGE);
+            }
+            break;
         case HELP:
             print_usage(argv[0]);
             exit(0);
@@ -270,7 +499,15 @@ int main(const int argc, char **const argv)
         builder.init();
         syslog(LOG_INFO, "%s %s started", PACKAGE_NAME, PACKAGE_VERSION);
 
-        responder = builder.build();
+#if XLLMNRD_NETNS
+        if (!builder.netns.empty()) {
+            group = builder.build_group();
+        }
+        else
+#endif
+        {
+            main_responder = builder.build();
+        }
 
         int exit_status = EXIT_SUCCESS;
 
@@ -281,9 +518,15 @@ int main(const int argc, char **const argv)
 
         set_signal_handler(SIGINT, handle_signal_to_terminate, &mask);
         set_signal_handler(SIGTERM, handle_signal_to_terminate, &mask);
+        set_signal_handler(SIGUSR1, handle_signal_to_report, nullptr);
 
         if (exit_status == EXIT_SUCCESS) {
-            responder->run();
+            if (group != nullptr) {
+                group->run();
+            }
+            else {
+                main_responder->run();
+            }
 
             if (builder.pid_file) {
                 auto &&result = unlink(builder.pid_file);
@@ -294,7 +537,13 @@ int main(const int argc, char **const argv)
             }
         }
 
-        responder.reset();
+        // No more reports can be requested once the responders are gone.
+        struct sigaction ignore_action {};
+        ignore_action.sa_handler = SIG_IGN;
+        sigaction(SIGUSR1, &ignore_action, nullptr);
+
+        group.reset();
+        main_responder.reset();
 
         if (caught_signal != 0) {
             // Resets the handler to default and reraise the same signal.
@@ -321,6 +570,24 @@ void handle_signal_to_terminate(int sig)
 {
     int expected = 0;
     if (caught_signal.compare_exchange_weak(expected, sig)) {
-        responder->terminate();
+        if (group != nullptr) {
+            group->terminate();
+        }
+        else if (main_responder != nullptr) {
+            main_responder->terminate();
+        }
+    }
+}
+
+/*
+ * Handles a signal by requesting a statistics report.
+ */
+void handle_signal_to_report(int)
+{
+    if (group != nullptr) {
+        group->request_statistics();
+    }
+    else if (main_responder != nullptr) {
+        main_responder->request_statistics();
     }
 }